@@ -0,0 +1,157 @@
+"""
+This is a simple stand-alone script to benchmark the memory policy in
+cpp/MemoryPolicy.h against immer's default memory policy.
+
+It times the operations behind ImmutableDict.set and ImmutableList.append,
+each of which copies a path of nodes, and copying and dropping a container,
+which changes reference counts only. The items have the sizes of DictItem and
+ListItem, but hold plain pointers, so that no Python objects are involved.
+Results are reported in operations per second.
+"""
+
+import subprocess
+import sysconfig
+
+
+def main():
+    with open("MemoryPolicyBenchmark.cpp", "w") as f:
+        f.write(source)
+
+    subprocess.check_call(
+        [
+            "g++",
+            "-O2",
+            "MemoryPolicyBenchmark.cpp",
+            "-o",
+            "MemoryPolicyBenchmark",
+            "-Wall",
+            "-Wextra",
+            "-std=c++17",
+            "-Ilib/immer",
+            "-I" + sysconfig.get_paths()["include"],
+        ]
+    )
+    subprocess.check_call(["./MemoryPolicyBenchmark"])
+
+
+source = """\
+#include "cpp/MemoryPolicy.h"
+#include "cpp/Sha1Hash.h"
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include <immer/flex_vector.hpp>
+#include <immer/map.hpp>
+
+using namespace pyimmutable;
+
+struct DictItem {
+    void* key;
+    void* value;
+    Sha1Hash valueHash;
+    bool isImmutableJson;
+};
+
+struct ListItem {
+    void* value;
+    Sha1Hash valueHash;
+    bool isImmutableJson;
+};
+
+template <typename MP>
+using Map = immer::map<
+    Sha1Hash, DictItem, Sha1HashHasher, std::equal_to<Sha1Hash>, MP>;
+
+template <typename MP>
+using Vector = immer::flex_vector<ListItem, MP>;
+
+static volatile std::size_t sink;
+
+static Sha1Hash makeHash(std::size_t i)
+{
+    Sha1Hash h{};
+    uint64_t const x = (i + 1) * 0x9E3779B97F4A7C15ull;
+    std::memcpy(h.data(), &x, sizeof(x));
+    return h;
+}
+
+template <typename F>
+static double opsPerSecond(int repeat, F&& f)
+{
+    auto const start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeat; ++i) {
+        f(i);
+    }
+    std::chrono::duration<double> const elapsed =
+        std::chrono::steady_clock::now() - start;
+    return repeat / elapsed.count();
+}
+
+// Every new version is dropped right away, like most intermediate
+// ImmutableDict and ImmutableList objects.
+template <typename MP>
+static double benchmarkSet(std::size_t size, int repeat)
+{
+    Map<MP> map;
+    for (std::size_t i = 0; i < size; ++i) {
+        map = std::move(map).set(makeHash(i), DictItem{});
+    }
+    return opsPerSecond(repeat, [&](int i) {
+        sink = map.set(makeHash(i % size), DictItem{}).size();
+    });
+}
+
+template <typename MP>
+static double benchmarkAppend(std::size_t size, int repeat)
+{
+    Vector<MP> vec;
+    for (std::size_t i = 0; i < size; ++i) {
+        vec = std::move(vec).push_back(ListItem{});
+    }
+    return opsPerSecond(repeat, [&](int) {
+        sink = vec.push_back(ListItem{}).size();
+    });
+}
+
+template <typename MP>
+static double benchmarkCopy(int repeat)
+{
+    Vector<MP> const vec{ListItem{}, ListItem{}, ListItem{}};
+    std::vector<Vector<MP>> copies(100);
+    return opsPerSecond(repeat, [&](int i) {
+        copies[i % 100] = vec;
+        sink = copies[(i + 50) % 100].size();
+    });
+}
+
+template <typename MP>
+static void report(char const* name)
+{
+    std::cerr << name << ":" << std::endl
+              << "  map set:   "
+              << benchmarkSet<MP>(10, 2000000) << " ops/s (10 items), "
+              << benchmarkSet<MP>(100000, 2000000) << " ops/s (100000 items)"
+              << std::endl
+              << "  push_back: "
+              << benchmarkAppend<MP>(10, 2000000) << " ops/s (10 items), "
+              << benchmarkAppend<MP>(100000, 2000000)
+              << " ops/s (100000 items)" << std::endl
+              << "  copy:      " << benchmarkCopy<MP>(20000000) << " ops/s"
+              << std::endl;
+}
+
+int main()
+{
+    report<immer::default_memory_policy>("immer::default_memory_policy");
+    report<MemoryPolicy>("pyimmutable::MemoryPolicy");
+    return 0;
+}
+"""
+
+
+if __name__ == "__main__":
+    main()
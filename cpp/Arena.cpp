@@ -0,0 +1,121 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Arena.h"
+
+#include "ClassWrapper.h"
+#include "PyObjectRef.h"
+#include "docstrings.autogen.h"
+#include "util.h"
+
+namespace pyimmutable {
+
+namespace {
+
+struct ArenaObject {
+  using Wrapper = ClassWrapper<ArenaObject>;
+
+  Arena* const arena{new Arena};
+
+  ArenaObject() = default;
+  ArenaObject(ArenaObject const&) = delete;
+  ArenaObject& operator=(ArenaObject const&) = delete;
+
+  ~ArenaObject() {
+    arena->disown();
+  }
+
+  static PyObjectRef new_(PyTypeObject*, PyObject* args, PyObject* kwds) {
+    if (!noKeywords("Arena", kwds) ||
+        !PyArg_UnpackTuple(args, "Arena", 0, 0)) {
+      return nullptr;
+    }
+    return Wrapper::create();
+  }
+
+  PyObjectRef enter(PyObject* /* unused */) {
+    if (!arena->enter()) {
+      PyErr_SetString(PyExc_RuntimeError, "Arena is active already");
+      return nullptr;
+    }
+    return PyObjectRef{Wrapper::pyObject(this)};
+  }
+
+  PyObjectRef exit(PyObject* /* args */) {
+    if (!arena->exit()) {
+      PyErr_SetString(
+          PyExc_RuntimeError,
+          "Arena is not the active arena of this thread");
+      return nullptr;
+    }
+    return PyObjectRef{Py_None};
+  }
+
+  PyObjectRef info(PyObject* /* unused */) {
+    return buildValue(
+        "{snsnsn}",
+        "chunks",
+        static_cast<Py_ssize_t>(arena->chunkCount()),
+        "used",
+        static_cast<Py_ssize_t>(arena->usedBytes()),
+        "live",
+        static_cast<Py_ssize_t>(arena->liveAllocations()));
+  }
+};
+
+// clang-format off
+PyMethodDef Arena_methods[] = {
+    {"__enter__",
+     ArenaObject::Wrapper::method<&ArenaObject::enter>(),
+     METH_NOARGS,
+     nullptr
+   },
+    {"__exit__",
+     ArenaObject::Wrapper::method<&ArenaObject::exit>(),
+     METH_VARARGS,
+     nullptr
+   },
+    {"info",
+     ArenaObject::Wrapper::method<&ArenaObject::info>(),
+     METH_NOARGS,
+     docstring_Arena_info
+   },
+    {nullptr}};
+// clang-format on
+
+} // namespace
+
+template <>
+PyTypeObject ArenaObject::Wrapper::typeObject = {
+    PyVarObject_HEAD_INIT(nullptr, 0) //
+        .tp_name = "Arena",
+    .tp_doc = docstring_Arena,
+    .tp_methods = Arena_methods,
+    .tp_new = mangleReturnValue<&ArenaObject::new_>(),
+};
+PyTypeObject* getArenaTypeObject() {
+  return ArenaObject::Wrapper::initType();
+}
+
+} // namespace pyimmutable
@@ -0,0 +1,191 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Python.h>
+
+#include "util.h"
+
+namespace pyimmutable {
+
+// A region of memory for the nodes of trees that are built in one go, e.g. by
+// json_loads or make_immutable.
+//
+// While an arena is active in a thread, the immer nodes and the ImmutableDict
+// and ImmutableList objects allocated by that thread are carved out of large
+// chunks, one after the other. Memory released to an arena is not reused.
+// The arena only counts its live allocations, and frees all its chunks at
+// once when there are none left and it is neither active nor owned by its
+// Python object anymore.
+class Arena {
+ public:
+  static constexpr std::size_t kChunkSize = std::size_t{1} << 18;
+  static constexpr std::size_t kAlignment = alignof(std::max_align_t);
+  // Larger allocations are left to the regular heap.
+  static constexpr std::size_t kMaxAllocation = kChunkSize / 16;
+
+  Arena() = default;
+  Arena(Arena const&) = delete;
+  Arena& operator=(Arena const&) = delete;
+
+  // Returns `size` bytes from the arena that is active in this thread, or
+  // null if there is none, or the request is too large.
+  static void* allocate(std::size_t size) {
+    if (!entered_ || !current_ || size > kMaxAllocation) {
+      return nullptr;
+    }
+    return current_->allocateHere(size);
+  }
+
+  // Releases memory from `allocate`. Returns false if `ptr` was not
+  // allocated from an arena.
+  static bool deallocate(void* ptr) {
+    if (!owners_ || owners_->empty()) {
+      return false;
+    }
+    auto const it = owners_->find(
+        reinterpret_cast<std::uintptr_t>(ptr) & ~(kChunkSize - 1));
+    if (it == owners_->end()) {
+      return false;
+    }
+    Arena* const arena = it->second;
+    --arena->live_;
+    arena->maybeDelete();
+    return true;
+  }
+
+  // Makes this the active arena of the current thread, until `exit`. Returns
+  // false if it is active already.
+  bool enter() {
+    if (active_) {
+      return false;
+    }
+    active_ = true;
+    previous_ = std::exchange(current_, this);
+    ++entered_;
+    return true;
+  }
+
+  // Returns false if this is not the active arena of the current thread.
+  bool exit() {
+    if (current_ != this) {
+      return false;
+    }
+    current_ = std::exchange(previous_, nullptr);
+    --entered_;
+    active_ = false;
+    maybeDelete();
+    return true;
+  }
+
+  // Called by the owner instead of deleting the arena.
+  void disown() {
+    owned_ = false;
+    maybeDelete();
+  }
+
+  std::size_t chunkCount() const {
+    return chunks_.size();
+  }
+
+  std::size_t usedBytes() const {
+    return used_;
+  }
+
+  std::size_t liveAllocations() const {
+    return live_;
+  }
+
+ private:
+  ~Arena() {
+    for (char* chunk : chunks_) {
+      owners_->erase(reinterpret_cast<std::uintptr_t>(chunk));
+      std::free(chunk);
+    }
+  }
+
+  void* allocateHere(std::size_t size) {
+    size = (size + kAlignment - 1) & ~(kAlignment - 1);
+    if (static_cast<std::size_t>(end_ - pos_) < size && !addChunk()) {
+      return nullptr;
+    }
+    void* const ptr = pos_;
+    pos_ += size;
+    used_ += size;
+    ++live_;
+    return ptr;
+  }
+
+  // Chunks are aligned to their size, so that the chunk of any allocation,
+  // and thereby its arena, can be found from its address.
+  bool addChunk() {
+    char* const chunk =
+        static_cast<char*>(std::aligned_alloc(kChunkSize, kChunkSize));
+    if (!chunk) {
+      return false;
+    }
+    if (!owners_) {
+      owners_ = new std::unordered_map<std::uintptr_t, Arena*>;
+    }
+    owners_->emplace(reinterpret_cast<std::uintptr_t>(chunk), this);
+    chunks_.push_back(chunk);
+    pos_ = chunk;
+    end_ = chunk + kChunkSize;
+    return true;
+  }
+
+  void maybeDelete() {
+    if (!live_ && !active_ && !owned_) {
+      delete this;
+    }
+  }
+
+  std::vector<char*> chunks_;
+  char* pos_{nullptr};
+  char* end_{nullptr};
+  std::size_t used_{0};
+  std::size_t live_{0};
+  bool active_{false};
+  bool owned_{true};
+  Arena* previous_{nullptr};
+
+  // number of arenas active in any thread, which saves looking at `current_`
+  // in the common case
+  inline static std::size_t entered_{0};
+  inline static thread_local Arena* current_{nullptr};
+  // the arenas of all chunks, by the addresses of the chunks
+  inline static std::unordered_map<std::uintptr_t, Arena*>* owners_{nullptr};
+};
+
+PyTypeObject* getArenaTypeObject();
+
+} // namespace pyimmutable
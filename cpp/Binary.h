@@ -0,0 +1,194 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <endian.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <Python.h>
+
+#include "PyObjectRef.h"
+
+namespace pyimmutable {
+
+// A compact binary encoding of (nested) ImmutableDict and ImmutableList
+// trees, in which every distinct container is written only once.
+//
+// An encoding consists of kBinaryMagic, followed by a single value. Every
+// value starts with a tag byte:
+//
+//   'N', 'T', 'F'              None, True, False
+//   'i' <varint>               int in the range of int64, zigzag encoded
+//   'I' <size> <digits>        any other int, in decimal
+//   'f' <8 bytes>              float, IEEE 754 binary64, little-endian
+//   's' <size> <bytes>         str, UTF-8 encoded
+//   'b' <size> <bytes>         bytes
+//   't' <size> <values>        tuple
+//   'l' <size> <values>        ImmutableList
+//   'd' <size> <keys/values>   ImmutableDict, keys and values alternating
+//   'r' <varint>               reference to an earlier container
+//
+// Sizes are unsigned LEB128 varints. Containers are numbered in the order in
+// which their encoding ends, so that nested containers come before the ones
+// containing them. A reference gives the number of a container that has been
+// encoded before.
+//
+// Snapshots (see Snapshot.h) use the same encoding for all values but
+// containers, which they store in a random-access layout of their own.
+
+inline constexpr char kBinaryMagic[] = {'P', 'Y', 'I', 'M', '\x01'};
+
+namespace binary_tag {
+inline constexpr char kNone = 'N';
+inline constexpr char kTrue = 'T';
+inline constexpr char kFalse = 'F';
+inline constexpr char kInt = 'i';
+inline constexpr char kBigInt = 'I';
+inline constexpr char kFloat = 'f';
+inline constexpr char kStr = 's';
+inline constexpr char kBytes = 'b';
+inline constexpr char kTuple = 't';
+inline constexpr char kList = 'l';
+inline constexpr char kDict = 'd';
+inline constexpr char kReference = 'r';
+} // namespace binary_tag
+
+class BinaryWriter {
+ public:
+  BinaryWriter()
+      : BinaryWriter(std::string(kBinaryMagic, sizeof(kBinaryMagic))) {}
+  virtual ~BinaryWriter() = default;
+
+  // Appends the encoding of `obj`. Raises TypeError for objects that cannot
+  // be encoded.
+  bool write(PyObject* obj);
+
+  void writeTag(char tag) {
+    out_ += tag;
+  }
+
+  void writeSize(std::size_t size) {
+    for (; size >= 0x80; size >>= 7) {
+      out_ += static_cast<char>(size | 0x80);
+    }
+    out_ += static_cast<char>(size);
+  }
+
+  void writeFixed(uint64_t value) {
+    value = ::htole64(value);
+    writeBytes(&value, sizeof(value));
+  }
+
+  void writeBytes(void const* data, std::size_t len) {
+    out_.append(static_cast<char const*>(data), len);
+  }
+
+  std::string const& out() const {
+    return out_;
+  }
+
+ protected:
+  explicit BinaryWriter(std::string header) : out_(std::move(header)) {}
+
+  // Appends the encoding of an ImmutableDict or ImmutableList.
+  virtual bool writeContainer(PyObject* obj);
+
+  std::string out_;
+
+ private:
+  // The numbers of all containers written so far. They are kept alive by the
+  // object being serialized.
+  std::unordered_map<PyObject*, std::size_t> containers_;
+};
+
+// Decodes values written by BinaryWriter from [begin, end). All methods
+// returning bool raise ValueError when returning false.
+class BinaryReader {
+ public:
+  BinaryReader(char const* begin, char const* end)
+      : begin_(begin), pos_(begin), end_(end) {}
+  virtual ~BinaryReader() = default;
+
+ protected:
+  // Decodes the value at the current position, leaving containers to
+  // readContainer.
+  PyObjectRef readValue();
+
+  // Decodes the container whose tag at `start` has just been read.
+  virtual PyObjectRef readContainer(char tag, char const* start) = 0;
+
+  bool consume(std::size_t len) {
+    if (static_cast<std::size_t>(end_ - pos_) < len) {
+      return false;
+    }
+    pos_ += len;
+    return true;
+  }
+
+  bool readVarint(uint64_t& value);
+
+  // Reads the number of elements of a container, each of which takes at least
+  // `min_size` bytes.
+  bool readCount(std::size_t& count, std::size_t min_size);
+
+  bool readFixed(uint64_t& value) {
+    char const* const data = pos_;
+    if (!consume(sizeof(value))) {
+      error("Unexpected end of data", data);
+      return false;
+    }
+    std::memcpy(&value, data, sizeof(value));
+    value = ::le64toh(value);
+    return true;
+  }
+
+  PyObjectRef error(char const* msg, char const* where);
+
+  char const* const begin_;
+  char const* pos_;
+  char const* const end_;
+
+ private:
+  PyObjectRef readInt();
+  PyObjectRef readBigInt();
+  PyObjectRef readFloat();
+  PyObjectRef readStr();
+  PyObjectRef readBytes();
+  PyObjectRef readTuple();
+  bool readSized(char const*& data, std::size_t& len);
+};
+
+PyObjectRef dumpsBinary(PyObject* obj);
+
+// Decodes the bytes-like object `data`, raising ValueError if it is not a
+// valid encoding. All containers are interned as they are created.
+PyObjectRef loadsBinary(PyObject* data);
+
+} // namespace pyimmutable
@@ -0,0 +1,324 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Binary.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ImmutableDict.h"
+#include "ImmutableList.h"
+#include "util.h"
+
+namespace pyimmutable {
+
+PyObjectRef BinaryReader::readValue() {
+  if (pos_ == end_) {
+    return error("Expecting value", pos_);
+  }
+
+  char const* const start = pos_;
+  switch (char const tag = *pos_++) {
+    case binary_tag::kNone:
+      return PyObjectRef{Py_None};
+    case binary_tag::kTrue:
+      return PyObjectRef{Py_True};
+    case binary_tag::kFalse:
+      return PyObjectRef{Py_False};
+    case binary_tag::kInt:
+      return readInt();
+    case binary_tag::kBigInt:
+      return readBigInt();
+    case binary_tag::kFloat:
+      return readFloat();
+    case binary_tag::kStr:
+      return readStr();
+    case binary_tag::kBytes:
+      return readBytes();
+    case binary_tag::kTuple:
+      return readTuple();
+    default:
+      return readContainer(tag, start);
+  }
+}
+
+PyObjectRef BinaryReader::readInt() {
+  uint64_t u;
+  if (!readVarint(u)) {
+    return nullptr;
+  }
+  auto const value =
+      static_cast<long long>(u >> 1) ^ -static_cast<long long>(u & 1);
+  return PyObjectRef{PyLong_FromLongLong(value), false};
+}
+
+PyObjectRef BinaryReader::readBigInt() {
+  char const* data;
+  std::size_t len;
+  if (!readSized(data, len)) {
+    return nullptr;
+  }
+  std::string const digits(data, len);
+  char* end;
+  PyObjectRef value{PyLong_FromString(digits.c_str(), &end, 10), false};
+  if (value && end != digits.c_str() + len) {
+    return error("Invalid integer", data);
+  }
+  return value;
+}
+
+PyObjectRef BinaryReader::readFloat() {
+  uint64_t bits;
+  if (!readFixed(bits)) {
+    return nullptr;
+  }
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return PyObjectRef{PyFloat_FromDouble(value), false};
+}
+
+PyObjectRef BinaryReader::readStr() {
+  char const* data;
+  std::size_t len;
+  if (!readSized(data, len)) {
+    return nullptr;
+  }
+  return PyObjectRef{PyUnicode_DecodeUTF8(data, len, nullptr), false};
+}
+
+PyObjectRef BinaryReader::readBytes() {
+  char const* data;
+  std::size_t len;
+  if (!readSized(data, len)) {
+    return nullptr;
+  }
+  return PyObjectRef{PyBytes_FromStringAndSize(data, len), false};
+}
+
+PyObjectRef BinaryReader::readTuple() {
+  std::size_t size;
+  if (!readCount(size, 1)) {
+    return nullptr;
+  }
+  if (Py_EnterRecursiveCall(" while decoding a tuple")) {
+    return nullptr;
+  }
+  OnDestroy leave{[]() { Py_LeaveRecursiveCall(); }};
+
+  PyObjectRef tuple{PyTuple_New(size), false};
+  if (!tuple) {
+    return nullptr;
+  }
+  for (std::size_t i = 0; i < size; ++i) {
+    PyObjectRef value = readValue();
+    if (!value) {
+      return nullptr;
+    }
+    PyTuple_SET_ITEM(tuple.get(), i, value.release());
+  }
+  return tuple;
+}
+
+bool BinaryReader::readVarint(uint64_t& value) {
+  char const* const start = pos_;
+  value = 0;
+  for (unsigned int shift = 0; shift < 64; shift += 7) {
+    if (pos_ == end_) {
+      error("Unexpected end of data", start);
+      return false;
+    }
+    auto const byte = static_cast<unsigned char>(*pos_++);
+    value |= uint64_t{byte & 0x7fu} << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  error("Invalid varint", start);
+  return false;
+}
+
+bool BinaryReader::readCount(std::size_t& count, std::size_t min_size) {
+  char const* const start = pos_;
+  uint64_t value;
+  if (!readVarint(value)) {
+    return false;
+  }
+  if (value > static_cast<std::size_t>(end_ - pos_) / min_size) {
+    error("Unexpected end of data", start);
+    return false;
+  }
+  count = value;
+  return true;
+}
+
+bool BinaryReader::readSized(char const*& data, std::size_t& len) {
+  if (!readCount(len, 1)) {
+    return false;
+  }
+  data = pos_;
+  pos_ += len;
+  return true;
+}
+
+PyObjectRef BinaryReader::error(char const* msg, char const* where) {
+  PyErr_Format(
+      PyExc_ValueError,
+      "%s: offset %zd",
+      msg,
+      static_cast<Py_ssize_t>(where - begin_));
+  return nullptr;
+}
+
+namespace {
+
+class BinaryParser : public BinaryReader {
+ public:
+  BinaryParser(char const* data, std::size_t size)
+      : BinaryReader(data, data + size) {}
+
+  PyObjectRef parse() {
+    if (!consume(sizeof(kBinaryMagic)) ||
+        std::memcmp(begin_, kBinaryMagic, sizeof(kBinaryMagic)) != 0) {
+      return error("Unknown format", begin_);
+    }
+
+    PyObjectRef value = readValue();
+    if (value && pos_ != end_) {
+      return error("Extra data", pos_);
+    }
+    return value;
+  }
+
+ protected:
+  PyObjectRef readContainer(char tag, char const* start) override {
+    switch (tag) {
+      case binary_tag::kList:
+        return parseList();
+      case binary_tag::kDict:
+        return parseDict();
+      case binary_tag::kReference:
+        return parseReference();
+    }
+    return error("Unknown tag", start);
+  }
+
+ private:
+  PyObjectRef parseList() {
+    std::size_t size;
+    if (!readCount(size, 1)) {
+      return nullptr;
+    }
+    if (Py_EnterRecursiveCall(" while decoding an ImmutableList")) {
+      return nullptr;
+    }
+    OnDestroy leave{[]() { Py_LeaveRecursiveCall(); }};
+
+    // the values of all open lists share one stack
+    std::size_t const base = values_.size();
+    for (std::size_t i = 0; i < size; ++i) {
+      PyObjectRef value = readValue();
+      if (!value) {
+        return nullptr;
+      }
+      values_.push_back(std::move(value));
+    }
+
+    auto result = makeImmutableList(values_.data() + base, size);
+    values_.resize(base);
+    return addContainer(std::move(result));
+  }
+
+  PyObjectRef parseDict() {
+    std::size_t size;
+    if (!readCount(size, 2)) {
+      return nullptr;
+    }
+    if (Py_EnterRecursiveCall(" while decoding an ImmutableDict")) {
+      return nullptr;
+    }
+    OnDestroy leave{[]() { Py_LeaveRecursiveCall(); }};
+
+    // the items of all open dicts share one stack
+    std::size_t const base = items_.size();
+    for (std::size_t i = 0; i < size; ++i) {
+      PyObjectRef key = readValue();
+      if (!key) {
+        return nullptr;
+      }
+      PyObjectRef value = readValue();
+      if (!value) {
+        return nullptr;
+      }
+      items_.emplace_back(std::move(key), std::move(value));
+    }
+
+    auto result = makeImmutableDict(items_.data() + base, size);
+    items_.resize(base);
+    return addContainer(std::move(result));
+  }
+
+  PyObjectRef parseReference() {
+    char const* const start = pos_;
+    uint64_t index;
+    if (!readVarint(index)) {
+      return nullptr;
+    }
+    if (index >= containers_.size()) {
+      return error("Invalid reference", start);
+    }
+    return containers_[index];
+  }
+
+  PyObjectRef addContainer(PyObjectRef container) {
+    if (container) {
+      containers_.push_back(container);
+    }
+    return container;
+  }
+
+  std::vector<PyObjectRef> values_;
+  std::vector<std::pair<PyObjectRef, PyObjectRef>> items_;
+  // all containers decoded so far, in the order of their numbers
+  std::vector<PyObjectRef> containers_;
+};
+
+} // namespace
+
+PyObjectRef loadsBinary(PyObject* data) {
+  Py_buffer view;
+  if (PyObject_GetBuffer(data, &view, PyBUF_SIMPLE) < 0) {
+    return nullptr;
+  }
+  OnDestroy release{[&view]() { PyBuffer_Release(&view); }};
+
+  return BinaryParser{static_cast<char const*>(view.buf),
+                      static_cast<std::size_t>(view.len)}
+      .parse();
+}
+
+} // namespace pyimmutable
@@ -0,0 +1,169 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Binary.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include "ImmutableDict.h"
+#include "ImmutableList.h"
+#include "util.h"
+
+namespace pyimmutable {
+
+namespace {
+
+bool writeInt(BinaryWriter& writer, PyObject* obj) {
+  int overflow = 0;
+  long long const value = PyLong_AsLongLongAndOverflow(obj, &overflow);
+  if (!overflow) {
+    if (value == -1 && PyErr_Occurred()) {
+      return false;
+    }
+    writer.writeTag(binary_tag::kInt);
+    auto const u = static_cast<uint64_t>(value);
+    writer.writeSize((u << 1) ^ (value < 0 ? ~uint64_t{0} : 0));
+    return true;
+  }
+
+  PyObjectRef repr{PyLong_Type.tp_repr(obj), false};
+  if (!repr) {
+    return false;
+  }
+  Py_ssize_t len;
+  char const* const data = PyUnicode_AsUTF8AndSize(repr.get(), &len);
+  if (!data) {
+    return false;
+  }
+  writer.writeTag(binary_tag::kBigInt);
+  writer.writeSize(len);
+  writer.writeBytes(data, len);
+  return true;
+}
+
+bool writeFloat(BinaryWriter& writer, PyObject* obj) {
+  double const value = PyFloat_AS_DOUBLE(obj);
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  writer.writeTag(binary_tag::kFloat);
+  writer.writeFixed(bits);
+  return true;
+}
+
+bool writeStr(BinaryWriter& writer, PyObject* obj) {
+  Py_ssize_t len;
+  char const* const data = PyUnicode_AsUTF8AndSize(obj, &len);
+  if (!data) {
+    return false;
+  }
+  writer.writeTag(binary_tag::kStr);
+  writer.writeSize(len);
+  writer.writeBytes(data, len);
+  return true;
+}
+
+bool notSerializable(PyObject* obj) {
+  PyErr_Format(
+      PyExc_TypeError,
+      "Object of type %.200s is not serializable in binary format",
+      Py_TYPE(obj)->tp_name);
+  return false;
+}
+
+} // namespace
+
+bool BinaryWriter::write(PyObject* obj) {
+  if (obj == Py_None) {
+    writeTag(binary_tag::kNone);
+  } else if (obj == Py_True) {
+    writeTag(binary_tag::kTrue);
+  } else if (obj == Py_False) {
+    writeTag(binary_tag::kFalse);
+  } else if (PyLong_Check(obj)) {
+    return writeInt(*this, obj);
+  } else if (PyFloat_Check(obj)) {
+    return writeFloat(*this, obj);
+  } else if (PyUnicode_Check(obj)) {
+    return writeStr(*this, obj);
+  } else if (PyBytes_Check(obj)) {
+    writeTag(binary_tag::kBytes);
+    writeSize(PyBytes_GET_SIZE(obj));
+    writeBytes(PyBytes_AS_STRING(obj), PyBytes_GET_SIZE(obj));
+  } else if (
+      Py_TYPE(obj) == immutableDictTypeObject ||
+      Py_TYPE(obj) == immutableListTypeObject) {
+    return writeContainer(obj);
+  } else if (PyTuple_Check(obj)) {
+    if (Py_EnterRecursiveCall(" while encoding a tuple")) {
+      return false;
+    }
+    OnDestroy leave{[]() { Py_LeaveRecursiveCall(); }};
+
+    writeTag(binary_tag::kTuple);
+    writeSize(PyTuple_GET_SIZE(obj));
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(obj); ++i) {
+      if (!write(PyTuple_GET_ITEM(obj, i))) {
+        return false;
+      }
+    }
+  } else {
+    return notSerializable(obj);
+  }
+  return true;
+}
+
+bool BinaryWriter::writeContainer(PyObject* obj) {
+  auto const it = containers_.find(obj);
+  if (it != containers_.end()) {
+    writeTag(binary_tag::kReference);
+    writeSize(it->second);
+    return true;
+  }
+
+  if (Py_EnterRecursiveCall(" while encoding a container")) {
+    return false;
+  }
+  OnDestroy leave{[]() { Py_LeaveRecursiveCall(); }};
+
+  bool const ok = Py_TYPE(obj) == immutableDictTypeObject
+      ? writeImmutableDictBinary(*this, obj)
+      : writeImmutableListBinary(*this, obj);
+  if (ok) {
+    containers_.emplace(obj, containers_.size());
+  }
+  return ok;
+}
+
+PyObjectRef dumpsBinary(PyObject* obj) {
+  BinaryWriter writer;
+  if (!writer.write(obj)) {
+    return nullptr;
+  }
+  return PyObjectRef{
+      PyBytes_FromStringAndSize(writer.out().data(), writer.out().size()),
+      false};
+}
+
+} // namespace pyimmutable
@@ -0,0 +1,275 @@
+/*
+ * PUBLIC DOMAIN
+ *
+ * C++17 BLAKE3 implementation, following the structure of the BLAKE3
+ * reference implementation by Jack O'Connor, Jean-Philippe Aumasson,
+ * Samuel Neves and Zooko Wilcox-O'Hearn (CC0).
+ *
+ * Only the default hash mode is implemented (no keyed hashing or key
+ * derivation), and the output is truncated to the requested digest size.
+ *
+ * This is 100% public domain.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <endian.h>
+#include <utility>
+#include <vector>
+
+namespace blake3 {
+
+inline constexpr std::size_t kBlockSize = 64;
+inline constexpr std::size_t kChunkSize = 1024;
+
+namespace detail {
+
+using ChainingValue = std::array<uint32_t, 8>;
+
+inline constexpr ChainingValue kIV = {0x6A09E667,
+                                      0xBB67AE85,
+                                      0x3C6EF372,
+                                      0xA54FF53A,
+                                      0x510E527F,
+                                      0x9B05688C,
+                                      0x1F83D9AB,
+                                      0x5BE0CD19};
+
+inline constexpr uint32_t kChunkStart = 1;
+inline constexpr uint32_t kChunkEnd = 2;
+inline constexpr uint32_t kParent = 4;
+inline constexpr uint32_t kRoot = 8;
+
+inline constexpr std::size_t kMessagePermutation[16] =
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8};
+
+class Compression {
+ public:
+  static std::array<uint32_t, 16> compress(
+      ChainingValue const& cv,
+      uint32_t const* block_words,
+      uint64_t counter,
+      uint32_t block_len,
+      uint32_t flags) {
+    Compression c;
+    std::copy(cv.begin(), cv.end(), c.s.begin());
+    std::copy(kIV.begin(), kIV.begin() + 4, c.s.begin() + 8);
+    c.s[12] = static_cast<uint32_t>(counter);
+    c.s[13] = static_cast<uint32_t>(counter >> 32);
+    c.s[14] = block_len;
+    c.s[15] = flags;
+    std::copy(block_words, block_words + 16, c.m);
+
+    c.doRounds(std::make_index_sequence<7>());
+
+    for (std::size_t i = 0; i < 8; ++i) {
+      c.s[i] ^= c.s[i + 8];
+      c.s[i + 8] ^= cv[i];
+    }
+    return c.s;
+  }
+
+ private:
+  static uint32_t rightrotate(uint32_t value, unsigned int bits) {
+    return ((value >> bits) | (value << (32 - bits)));
+  }
+
+  void g(
+      std::size_t a,
+      std::size_t b,
+      std::size_t c,
+      std::size_t d,
+      uint32_t mx,
+      uint32_t my) {
+    s[a] = s[a] + s[b] + mx;
+    s[d] = rightrotate(s[d] ^ s[a], 16);
+    s[c] = s[c] + s[d];
+    s[b] = rightrotate(s[b] ^ s[c], 12);
+    s[a] = s[a] + s[b] + my;
+    s[d] = rightrotate(s[d] ^ s[a], 8);
+    s[c] = s[c] + s[d];
+    s[b] = rightrotate(s[b] ^ s[c], 7);
+  }
+
+  template <std::size_t R>
+  void doRound() {
+    if constexpr (R > 0) {
+      uint32_t permuted[16];
+      for (std::size_t i = 0; i < 16; ++i) {
+        permuted[i] = m[kMessagePermutation[i]];
+      }
+      std::copy(permuted, permuted + 16, m);
+    }
+
+    // mix the columns
+    g(0, 4, 8, 12, m[0], m[1]);
+    g(1, 5, 9, 13, m[2], m[3]);
+    g(2, 6, 10, 14, m[4], m[5]);
+    g(3, 7, 11, 15, m[6], m[7]);
+    // mix the diagonals
+    g(0, 5, 10, 15, m[8], m[9]);
+    g(1, 6, 11, 12, m[10], m[11]);
+    g(2, 7, 8, 13, m[12], m[13]);
+    g(3, 4, 9, 14, m[14], m[15]);
+  }
+
+  template <std::size_t... R>
+  void doRounds(std::index_sequence<R...>) {
+    (doRound<R>(), ...);
+  }
+
+  std::array<uint32_t, 16> s;
+  uint32_t m[16];
+};
+
+// The input of a compression that may still be either a chaining value or
+// the root of the tree.
+struct Output {
+  ChainingValue inputCv;
+  uint32_t blockWords[16];
+  uint64_t counter;
+  uint32_t blockLen;
+  uint32_t flags;
+
+  ChainingValue chainingValue() const {
+    auto const s = Compression::compress(
+        inputCv, blockWords, counter, blockLen, flags);
+    ChainingValue cv;
+    std::copy(s.begin(), s.begin() + 8, cv.begin());
+    return cv;
+  }
+
+  void rootOutputBytes(uint8_t* out, std::size_t len) const {
+    for (uint64_t block_counter = 0; len; ++block_counter) {
+      auto const s = Compression::compress(
+          inputCv, blockWords, block_counter, blockLen, flags | kRoot);
+      for (std::size_t i = 0; i < 16 && len; ++i) {
+        for (std::size_t j = 0; j < 4 && len; ++j, --len) {
+          *out++ = s[i] >> (8 * j);
+        }
+      }
+    }
+  }
+
+  static Output parent(ChainingValue const& left, ChainingValue const& right) {
+    Output o{kIV, {}, 0, kBlockSize, kParent};
+    std::copy(left.begin(), left.end(), o.blockWords);
+    std::copy(right.begin(), right.end(), o.blockWords + 8);
+    return o;
+  }
+};
+
+} // namespace detail
+
+template <std::size_t N = 32>
+class Context {
+ public:
+  using Hash = std::array<uint8_t, N>;
+
+  Context& operator()(void const* data, std::size_t len) {
+    uint8_t const* ptr = reinterpret_cast<uint8_t const*>(data);
+
+    while (len) {
+      if (chunkLength() == kChunkSize) {
+        // the current chunk is complete, and there is more input
+        addChunkChainingValue(chunkOutput().chainingValue());
+        startChunk(chunkCounter + 1);
+      }
+
+      if (blockLen == kBlockSize) {
+        // the current block is full, and there is more input
+        compressBlock();
+      }
+
+      std::size_t const copy_bytes =
+          std::min({len, kBlockSize - blockLen, kChunkSize - chunkLength()});
+      std::copy(ptr, ptr + copy_bytes, block + blockLen);
+      ptr += copy_bytes;
+      len -= copy_bytes;
+      blockLen += copy_bytes;
+    }
+    return *this;
+  }
+
+  Hash final() const {
+    detail::Output output = chunkOutput();
+    for (auto it = cvStack.rbegin(); it != cvStack.rend(); ++it) {
+      output = detail::Output::parent(*it, output.chainingValue());
+    }
+
+    Hash result;
+    output.rootOutputBytes(result.data(), result.size());
+    return result;
+  }
+
+ private:
+  std::size_t chunkLength() const {
+    return kBlockSize * blocksCompressed + blockLen;
+  }
+
+  uint32_t startFlag() const {
+    return blocksCompressed ? 0 : detail::kChunkStart;
+  }
+
+  void blockWords(uint32_t* words) const {
+    uint8_t padded[kBlockSize] = {};
+    std::copy(block, block + blockLen, padded);
+    for (std::size_t i = 0; i < 16; ++i) {
+      uint32_t w;
+      std::copy(
+          padded + 4 * i, padded + 4 * i + 4, reinterpret_cast<uint8_t*>(&w));
+      words[i] = ::le32toh(w);
+    }
+  }
+
+  void compressBlock() {
+    uint32_t words[16];
+    blockWords(words);
+    auto const s = detail::Compression::compress(
+        cv, words, chunkCounter, kBlockSize, startFlag());
+    std::copy(s.begin(), s.begin() + 8, cv.begin());
+    ++blocksCompressed;
+    blockLen = 0;
+  }
+
+  detail::Output chunkOutput() const {
+    detail::Output o{cv,
+                     {},
+                     chunkCounter,
+                     static_cast<uint32_t>(blockLen),
+                     startFlag() | detail::kChunkEnd};
+    blockWords(o.blockWords);
+    return o;
+  }
+
+  void startChunk(uint64_t counter) {
+    cv = detail::kIV;
+    chunkCounter = counter;
+    blocksCompressed = 0;
+    blockLen = 0;
+  }
+
+  // Merges completed subtrees: the number of trailing zero bits of the total
+  // number of chunks is the number of subtrees completed by this chunk.
+  void addChunkChainingValue(detail::ChainingValue new_cv) {
+    for (uint64_t total_chunks = chunkCounter + 1; !(total_chunks & 1);
+         total_chunks >>= 1) {
+      new_cv = detail::Output::parent(cvStack.back(), new_cv).chainingValue();
+      cvStack.pop_back();
+    }
+    cvStack.push_back(new_cv);
+  }
+
+  detail::ChainingValue cv = detail::kIV;
+  uint64_t chunkCounter = 0;
+  std::size_t blocksCompressed = 0;
+  std::size_t blockLen = 0;
+  uint8_t block[kBlockSize];
+  std::vector<detail::ChainingValue> cvStack;
+};
+
+} // namespace blake3
@@ -24,10 +24,14 @@
 
 #pragma once
 
+#include <cstddef>
 #include <exception>
 #include <functional>
 #include <type_traits>
+#include <utility>
 
+#include "Arena.h"
+#include "InternTable.h"
 #include "PyObjectRef.h"
 #include "Sha1Hash.h"
 #include "util.h"
@@ -36,6 +40,17 @@ namespace pyimmutable {
 template <typename T>
 class ClassWrapper;
 
+namespace detail {
+class FreeList;
+}
+
+// Makes the free list of a type's objects appear in freeListInfo.
+void registerFreeList(char const* name, detail::FreeList const* free_list);
+
+// Returns a dict with the statistics of the free lists of all types, by
+// type name.
+PyObjectRef freeListInfo();
+
 namespace detail {
 
 template <typename T>
@@ -75,8 +90,7 @@ class Sha1Lookup {
   static constexpr bool sha1_lookup_enabled = true;
 
  public:
-  using LookUpMapType =
-      std::unordered_map<Sha1Hash, ClassWrapper<T>*, Sha1HashHasher>;
+  using LookUpMapType = InternTable<ClassWrapper<T>>;
 
   template <typename Factory>
   static TypedPyObjectRef<ClassWrapper<T>> getOrCreate(
@@ -104,7 +118,7 @@ class Sha1Lookup {
   }
   static void destroy(ClassWrapper<T>* self) {
     if (lookUpMap_) {
-      lookUpMap_->erase(self->sha1);
+      lookUpMap_->erase(self);
     }
   }
 };
@@ -118,6 +132,51 @@ class Sha1Lookup<void> {
   }
 };
 
+// A bounded stack of the memory of deallocated objects of one type, which is
+// reused for new objects of that type, like CPython's free lists of tuples
+// and floats. Each block holds the link to the next one.
+class FreeList {
+ public:
+  static constexpr std::size_t kCapacity = 100;
+
+  // Returns a block, or null if the free list is empty.
+  void* pop() {
+    if (!head_) {
+      ++misses_;
+      return nullptr;
+    }
+    ++hits_;
+    --size_;
+    return std::exchange(head_, *static_cast<void**>(head_));
+  }
+
+  // Returns false if the free list is full.
+  bool push(void* block) {
+    if (size_ >= kCapacity) {
+      return false;
+    }
+    *static_cast<void**>(block) = std::exchange(head_, block);
+    ++size_;
+    return true;
+  }
+
+  std::size_t size() const {
+    return size_;
+  }
+  std::size_t hits() const {
+    return hits_;
+  }
+  std::size_t misses() const {
+    return misses_;
+  }
+
+ private:
+  void* head_{nullptr};
+  std::size_t size_{0};
+  std::size_t hits_{0};
+  std::size_t misses_{0};
+};
+
 struct PyObjectHead {
   PyObject_HEAD;
 
@@ -175,7 +234,9 @@ class ClassWrapper
   static void destroy(PyObject* pyself) {
     auto* self = cast(pyself);
     if constexpr (sha1_lookup_enabled) {
-      Sha1Lookup::destroy(self);
+      if (self->objectConstructed_) {
+        Sha1Lookup::destroy(self);
+      }
     }
 
     if constexpr (weakrefs_enabled) {
@@ -189,9 +250,35 @@ class ClassWrapper
       self->objectConstructed_ = false;
     }
 
-    PyObject_Del(pyself);
+    if constexpr (sha1_lookup_enabled) {
+      if (Arena::deallocate(pyself)) {
+        return;
+      }
+    }
+    if (!freeList_.push(pyself)) {
+      PyObject_Del(pyself);
+    }
   }
 
+  // Interned objects are the nodes of trees, so they come from the active
+  // Arena, if there is one. Otherwise, memory is taken from the free list of
+  // the type first.
+  static ClassWrapper* allocate() {
+    void* ptr = nullptr;
+    if constexpr (sha1_lookup_enabled) {
+      ptr = Arena::allocate(sizeof(ClassWrapper));
+    }
+    if (!ptr) {
+      ptr = freeList_.pop();
+    }
+    if (ptr) {
+      return cast(PyObject_Init(static_cast<PyObject*>(ptr), &typeObject));
+    }
+    return PyObject_New(ClassWrapper, &typeObject);
+  }
+
+  inline static detail::FreeList freeList_;
+
  public:
   using detail::PyObjectHead::ptr;
 
@@ -209,8 +296,7 @@ class ClassWrapper
 
   template <typename... Args>
   static TypedPyObjectRef<ClassWrapper> create(Args&&... args) {
-    TypedPyObjectRef<ClassWrapper> cw{PyObject_New(ClassWrapper, &typeObject),
-                                      false};
+    TypedPyObjectRef<ClassWrapper> cw{allocate(), false};
 
     if (cw) {
       cw->objectConstructed_ = false;
@@ -252,6 +338,7 @@ class ClassWrapper
     if (PyType_Ready(&typeObject) < 0) {
       return nullptr;
     }
+    registerFreeList(typeObject.tp_name, &freeList_);
 
     if constexpr (sha1_lookup_enabled) {
       Sha1Lookup::init();
@@ -284,15 +371,14 @@ TypedPyObjectRef<ClassWrapper<T>> Sha1Lookup<T>::getOrCreate(
     Sha1Hash const& hash,
     Factory&& f) {
   if (lookUpMap_) {
-    auto it = lookUpMap_->find(hash);
-    if (it != lookUpMap_->end()) {
-      return TypedPyObjectRef{it->second};
+    if (auto* const existing = lookUpMap_->find(hash)) {
+      return TypedPyObjectRef{existing};
     }
   }
 
   auto obj = ClassWrapper<T>::create(std::forward<Factory>(f)());
-  if (lookUpMap_) {
-    lookUpMap_->emplace(hash, obj.get());
+  if (lookUpMap_ && obj) {
+    lookUpMap_->insert(obj.get());
   }
 
   return obj;
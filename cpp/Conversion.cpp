@@ -0,0 +1,374 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Conversion.h"
+
+#include <cstddef>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "ImmutableDict.h"
+#include "ImmutableList.h"
+#include "util.h"
+
+// Immortal objects were added in Python 3.12, except for free-threaded builds,
+// where they work differently.
+#if PY_VERSION_HEX >= 0x030C0000 && !defined(Py_GIL_DISABLED)
+#ifdef _Py_IMMORTAL_INITIAL_REFCNT
+#define PYIMMUTABLE_IMMORTAL_REFCNT _Py_IMMORTAL_INITIAL_REFCNT
+#else
+#define PYIMMUTABLE_IMMORTAL_REFCNT _Py_IMMORTAL_REFCNT
+#endif
+#endif
+
+namespace pyimmutable {
+
+namespace {
+
+enum class Kind { Leaf, Mapping, Sequence };
+
+// Classifies objects that are not of one of the builtin types handled by the
+// fast paths, using the same checks as the Python implementation did.
+bool abcKind(PyObject* obj, Kind& kind) {
+  static PyObject* mapping_abc = nullptr;
+  static PyObject* sequence_abc = nullptr;
+  if (!mapping_abc) {
+    PyObjectRef abc{PyImport_ImportModule("collections.abc"), false};
+    if (!abc) {
+      return false;
+    }
+    mapping_abc = PyObject_GetAttrString(abc.get(), "Mapping");
+    if (!mapping_abc) {
+      return false;
+    }
+    sequence_abc = PyObject_GetAttrString(abc.get(), "Sequence");
+    if (!sequence_abc) {
+      Py_CLEAR(mapping_abc);
+      return false;
+    }
+  }
+
+  int const is_mapping = PyObject_IsInstance(obj, mapping_abc);
+  if (is_mapping < 0) {
+    return false;
+  } else if (is_mapping) {
+    kind = Kind::Mapping;
+    return true;
+  }
+
+  int const is_sequence = PyObject_IsInstance(obj, sequence_abc);
+  if (is_sequence < 0) {
+    return false;
+  }
+  kind = is_sequence && !PyUnicode_Check(obj) ? Kind::Sequence : Kind::Leaf;
+  return true;
+}
+
+bool isScalar(PyObject* obj) {
+  return obj == Py_None || PyUnicode_CheckExact(obj) || PyBool_Check(obj) ||
+      PyLong_CheckExact(obj) || PyFloat_CheckExact(obj);
+}
+
+struct ToImmutable {
+  static bool kind(PyObject* obj, Kind& kind) {
+    if (isScalar(obj)) {
+      kind = Kind::Leaf;
+    } else if (PyDict_CheckExact(obj)) {
+      kind = Kind::Mapping;
+    } else if (PyList_CheckExact(obj) || PyTuple_CheckExact(obj)) {
+      kind = Kind::Sequence;
+    } else if (Py_TYPE(obj) == immutableDictTypeObject) {
+      // if it only contains JSON data, there is nothing left to convert
+      kind = isImmutableJsonDict(obj) ? Kind::Leaf : Kind::Mapping;
+    } else if (Py_TYPE(obj) == immutableListTypeObject) {
+      kind = isImmutableJsonList(obj) ? Kind::Leaf : Kind::Sequence;
+    } else {
+      return abcKind(obj, kind);
+    }
+    return true;
+  }
+
+  static PyObjectRef mapping(std::vector<PyObjectRef>& items) {
+    std::vector<std::pair<PyObjectRef, PyObjectRef>> kvs;
+    kvs.reserve(items.size() / 2);
+    for (std::size_t i = 0; i < items.size(); i += 2) {
+      kvs.emplace_back(std::move(items[i]), std::move(items[i + 1]));
+    }
+    return makeImmutableDict(kvs.data(), kvs.size());
+  }
+
+  static PyObjectRef sequence(std::vector<PyObjectRef>& values) {
+    return makeImmutableList(values.data(), values.size());
+  }
+};
+
+struct ToMutable {
+  static bool kind(PyObject* obj, Kind& kind) {
+    if (isScalar(obj)) {
+      kind = Kind::Leaf;
+    } else if (PyDict_CheckExact(obj)) {
+      kind = Kind::Mapping;
+    } else if (PyList_CheckExact(obj) || PyTuple_CheckExact(obj)) {
+      kind = Kind::Sequence;
+    } else if (Py_TYPE(obj) == immutableDictTypeObject) {
+      kind = Kind::Mapping;
+    } else if (Py_TYPE(obj) == immutableListTypeObject) {
+      kind = Kind::Sequence;
+    } else {
+      return abcKind(obj, kind);
+    }
+    return true;
+  }
+
+  static PyObjectRef mapping(std::vector<PyObjectRef>& items) {
+    PyObjectRef dict{PyDict_New(), false};
+    if (!dict) {
+      return nullptr;
+    }
+    for (std::size_t i = 0; i < items.size(); i += 2) {
+      if (PyDict_SetItem(dict.get(), items[i].get(), items[i + 1].get())) {
+        return nullptr;
+      }
+    }
+    return dict;
+  }
+
+  static PyObjectRef sequence(std::vector<PyObjectRef>& values) {
+    PyObjectRef list{PyList_New(values.size()), false};
+    if (!list) {
+      return nullptr;
+    }
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      PyList_SET_ITEM(list.get(), i, values[i].release());
+    }
+    return list;
+  }
+};
+
+// A mapping or sequence that is being converted. The inputs of a mapping are
+// its keys and values, alternating.
+struct Frame {
+  PyObjectRef source;
+  Kind kind;
+  std::vector<PyObjectRef> inputs;
+  std::size_t next{0};
+  std::vector<PyObjectRef> outputs;
+};
+
+bool collectInputs(Frame& frame) {
+  PyObject* const obj = frame.source.get();
+
+  if (frame.kind == Kind::Mapping) {
+    if (PyDict_CheckExact(obj)) {
+      frame.inputs.reserve(2 * PyDict_GET_SIZE(obj));
+      Py_ssize_t pos = 0;
+      PyObject* key;
+      PyObject* value;
+      while (PyDict_Next(obj, &pos, &key, &value)) {
+        frame.inputs.emplace_back(key);
+        frame.inputs.emplace_back(value);
+      }
+      return true;
+    }
+
+    PyObjectRef items{PyMapping_Items(obj), false};
+    if (!items) {
+      return false;
+    }
+    Py_ssize_t const size = PyList_GET_SIZE(items.get());
+    frame.inputs.reserve(2 * size);
+    for (Py_ssize_t i = 0; i < size; ++i) {
+      PyObject* const item = PyList_GET_ITEM(items.get(), i);
+      if (!PyTuple_Check(item) || PyTuple_GET_SIZE(item) != 2) {
+        PyErr_SetString(
+            PyExc_TypeError, "mapping items must be (key, value) tuples");
+        return false;
+      }
+      frame.inputs.emplace_back(PyTuple_GET_ITEM(item, 0));
+      frame.inputs.emplace_back(PyTuple_GET_ITEM(item, 1));
+    }
+    return true;
+  }
+
+  PyObjectRef seq{PySequence_Fast(obj, "expected a sequence"), false};
+  if (!seq) {
+    return false;
+  }
+  Py_ssize_t const size = PySequence_Fast_GET_SIZE(seq.get());
+  PyObject** const items = PySequence_Fast_ITEMS(seq.get());
+  frame.inputs.reserve(size);
+  for (Py_ssize_t i = 0; i < size; ++i) {
+    frame.inputs.emplace_back(items[i]);
+  }
+  return true;
+}
+
+template <typename Target>
+PyObjectRef convert(PyObject* root) {
+  std::vector<Frame> stack;
+  // containers currently on the stack, to detect circular references
+  std::unordered_set<PyObject*> active;
+
+  PyObjectRef pending{root};
+  PyObjectRef result;
+
+  while (true) {
+    if (pending) {
+      Kind kind;
+      if (!Target::kind(pending.get(), kind)) {
+        return nullptr;
+      }
+
+      if (kind == Kind::Leaf) {
+        result = std::move(pending);
+      } else {
+        if (!active.insert(pending.get()).second) {
+          PyErr_SetString(PyExc_ValueError, "Circular reference detected");
+          return nullptr;
+        }
+        stack.push_back(Frame{std::move(pending), kind});
+        if (!collectInputs(stack.back())) {
+          return nullptr;
+        }
+      }
+      pending = nullptr;
+    }
+
+    if (stack.empty()) {
+      return result;
+    }
+
+    Frame& top = stack.back();
+    if (result) {
+      top.outputs.push_back(std::move(result));
+    }
+    if (top.next < top.inputs.size()) {
+      pending = std::move(top.inputs[top.next++]);
+    } else {
+      result = top.kind == Kind::Mapping ? Target::mapping(top.outputs)
+                                         : Target::sequence(top.outputs);
+      if (!result) {
+        return nullptr;
+      }
+      active.erase(top.source.get());
+      stack.pop_back();
+    }
+  }
+}
+
+void makeImmortal(PyObject* obj) {
+#ifdef PYIMMUTABLE_IMMORTAL_REFCNT
+  Py_SET_REFCNT(obj, PYIMMUTABLE_IMMORTAL_REFCNT);
+#else
+  static_cast<void>(obj);
+#endif
+}
+
+bool isTracked(PyObject* obj) {
+#if PY_VERSION_HEX >= 0x03090000
+  return PyObject_GC_IsTracked(obj);
+#else
+  return _PyObject_GC_IS_TRACKED(obj);
+#endif
+}
+
+// Untracks `tuple` if none of its items can be part of a reference cycle, like
+// the garbage collector does when it comes across such a tuple.
+void maybeUntrack(PyObject* tuple) {
+  if (!isTracked(tuple)) {
+    return;
+  }
+  for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(tuple); ++i) {
+    PyObject* const item = PyTuple_GET_ITEM(tuple, i);
+    if (PyObject_IS_GC(item) &&
+        (!PyTuple_CheckExact(item) || isTracked(item))) {
+      return;
+    }
+  }
+  PyObject_GC_UnTrack(tuple);
+}
+
+} // namespace
+
+PyObjectRef makeImmutable(PyObject* obj) {
+  return convert<ToImmutable>(obj);
+}
+
+PyObjectRef makeMutable(PyObject* obj) {
+  return convert<ToMutable>(obj);
+}
+
+PyObjectRef freeze(PyObject* obj) {
+  // depth-first, so that the items of a tuple are done before the tuple
+  // itself (the flag is set for objects whose items have been pushed)
+  std::vector<std::pair<PyObject*, bool>> stack{{obj, false}};
+  std::unordered_set<PyObject*> visited;
+  auto const push = [&stack](PyObject* item) {
+    stack.emplace_back(item, false);
+  };
+
+  while (!stack.empty()) {
+    auto const [item, expanded] = stack.back();
+    stack.pop_back();
+
+    if (expanded) {
+      if (PyTuple_CheckExact(item)) {
+        maybeUntrack(item);
+      }
+      makeImmortal(item);
+    } else if (Py_TYPE(item) == immutableDictTypeObject) {
+      if (visited.insert(item).second) {
+        stack.emplace_back(item, true);
+        forEachImmutableDictItem(
+            item, [&](Sha1Hash const&, PyObject* key, PyObject* value) {
+              push(key);
+              push(value);
+              return true;
+            });
+      }
+    } else if (Py_TYPE(item) == immutableListTypeObject) {
+      if (visited.insert(item).second) {
+        stack.emplace_back(item, true);
+        forEachImmutableListItem(item, [&](PyObject* value) {
+          push(value);
+          return true;
+        });
+      }
+    } else if (PyTuple_Check(item)) {
+      if (visited.insert(item).second) {
+        stack.emplace_back(item, true);
+        for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(item); ++i) {
+          push(PyTuple_GET_ITEM(item, i));
+        }
+      }
+    } else {
+      makeImmortal(item);
+    }
+  }
+
+  return PyObjectRef{obj};
+}
+
+} // namespace pyimmutable
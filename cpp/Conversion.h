@@ -0,0 +1,48 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <Python.h>
+
+#include "PyObjectRef.h"
+
+namespace pyimmutable {
+
+// Deep copies of nested mappings and sequences (except str), turning them into
+// ImmutableDict/ImmutableList or dict/list objects respectively. Both work
+// with an explicit stack, so that the depth of nesting is not limited by the
+// recursion limit, and raise ValueError for circular references.
+PyObjectRef makeImmutable(PyObject* obj);
+PyObjectRef makeMutable(PyObject* obj);
+
+// Prepares the tree `obj` for being shared with forked processes, so that
+// reading it does not write to the memory it occupies: stops the garbage
+// collector from tracking tuples within it that cannot be part of reference
+// cycles, and, with Python builds that have immortal objects, makes every
+// object within it immortal, so that reference counting leaves them alone.
+// Returns `obj`.
+PyObjectRef freeze(PyObject* obj);
+
+} // namespace pyimmutable
@@ -0,0 +1,125 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Diff.h"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "ImmutableDict.h"
+#include "ImmutableList.h"
+#include "util.h"
+
+namespace pyimmutable {
+
+namespace {
+
+bool isContainer(PyObject* obj) {
+  return Py_TYPE(obj) == immutableDictTypeObject ||
+      Py_TYPE(obj) == immutableListTypeObject;
+}
+
+class Differ {
+ public:
+  explicit Differ(bool deep) : result_{PyList_New(0), false}, deep_(deep) {}
+
+  PyObjectRef run(PyObject* a, PyObject* b) {
+    if (!result_ || (a != b && !compare(a, b))) {
+      return nullptr;
+    }
+    return std::move(result_);
+  }
+
+ private:
+  bool compare(PyObject* a, PyObject* b) {
+    DiffCallback const callback =
+        [this](PyObject* key, PyObject* old_value, PyObject* new_value) {
+          return visit(key, old_value, new_value);
+        };
+    if (Py_TYPE(a) == immutableDictTypeObject) {
+      return diffImmutableDicts(a, b, callback);
+    } else {
+      return diffImmutableLists(a, b, callback);
+    }
+  }
+
+  bool visit(PyObject* key, PyObject* old_value, PyObject* new_value) {
+    if (!old_value) {
+      return append(key, "add", new_value);
+    } else if (!new_value) {
+      return append(key, "remove", old_value);
+    } else if (
+        !deep_ || Py_TYPE(old_value) != Py_TYPE(new_value) ||
+        !isContainer(old_value)) {
+      return append(key, "change", new_value);
+    }
+
+    if (Py_EnterRecursiveCall(" while comparing nested containers")) {
+      return false;
+    }
+    OnDestroy leave{[]() { Py_LeaveRecursiveCall(); }};
+
+    path_.push_back(key);
+    bool const ok = compare(old_value, new_value);
+    path_.pop_back();
+    return ok;
+  }
+
+  bool append(PyObject* key, char const* op, PyObject* value) {
+    PyObjectRef path{PyTuple_New(path_.size() + 1), false};
+    if (!path) {
+      return false;
+    }
+    for (std::size_t i = 0; i < path_.size(); ++i) {
+      PyTuple_SET_ITEM(path.get(), i, PyObjectRef{path_[i]}.release());
+    }
+    PyTuple_SET_ITEM(path.get(), path_.size(), PyObjectRef{key}.release());
+
+    auto const entry = buildValue("(OsO)", path.get(), op, value);
+    return entry && PyList_Append(result_.get(), entry.get()) == 0;
+  }
+
+  PyObjectRef result_;
+  // The keys leading to the containers currently being compared, borrowed
+  // from the callbacks that descended into them.
+  std::vector<PyObject*> path_;
+  bool const deep_;
+};
+
+} // namespace
+
+PyObjectRef diff(PyObject* a, PyObject* b, bool deep) {
+  if (Py_TYPE(b) != Py_TYPE(a)) {
+    PyErr_Format(
+        PyExc_TypeError,
+        "cannot compute the difference between %.200s and %.200s objects",
+        Py_TYPE(a)->tp_name,
+        Py_TYPE(b)->tp_name);
+    return nullptr;
+  }
+  return Differ{deep}.run(a, b);
+}
+
+} // namespace pyimmutable
@@ -0,0 +1,51 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <functional>
+
+#include <Python.h>
+
+#include "PyObjectRef.h"
+
+namespace pyimmutable {
+
+// Receives one difference between two ImmutableDict or ImmutableList objects:
+// the key or index, and the old and the new value. `old_value` is nullptr for
+// added elements, `new_value` for removed ones. Returns false, with an
+// exception set, to stop the comparison.
+using DiffCallback = std::function<bool(
+    PyObject* key,
+    PyObject* old_value,
+    PyObject* new_value)>;
+
+// Returns the differences between `a` and `b`, which must be of the same type,
+// as a list of (path, op, value) tuples. `op` is "add", "remove" or "change",
+// and `value` the added, removed or new value. If `deep` is set, changed
+// values that are both ImmutableDict or both ImmutableList objects are
+// compared recursively instead of being reported as a whole.
+PyObjectRef diff(PyObject* a, PyObject* b, bool deep);
+
+} // namespace pyimmutable
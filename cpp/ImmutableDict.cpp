@@ -23,6 +23,12 @@
  */
 
 #include "ImmutableDictImpl.h"
+
+#include <immer/algorithm.hpp>
+
+#include "Binary.h"
+#include "Diff.h"
+#include "Path.h"
 #include "clinic/ImmutableDict.cpp.h"
 #include "docstrings.autogen.h"
 
@@ -54,6 +60,85 @@ _pyimmutable_ImmutableDict__get_instance_count_impl()
       pyimmutable::ImmutableDict::Wrapper::getInstanceCount());
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableDict.apply_patch
+
+  patch: object
+  /
+
+Return a copy with the changes of ``patch`` applied.
+
+``patch`` is an iterable of ``(path, op, value)`` tuples, as returned
+by ``diff`` and ``deep_diff``. ``"add"`` and ``"change"`` entries set
+the element at ``path`` to ``value``, like ``set_in``, with ``"add"``
+inserting into ``ImmutableList`` objects. ``"remove"`` entries discard
+the element at ``path``, like ``discard_in``.
+
+All entries are applied in one pass, creating only the final versions
+of the modified containers.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableDict_apply_patch(pyimmutable::ImmutableDict::Wrapper*self,
+                                       PyObject *patch)
+/*[clinic end generated code: output=f8ba86bea53eb945 input=ebb3b7747d28f4db]*/
+// clang-format on
+{
+  return pyimmutable::applyPatch(self->ptr(), patch).release();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableDict.deep_diff
+
+  other: object
+  /
+
+Return the differences to ``other``, comparing nested containers.
+
+Like ``diff``, but values that are both ``ImmutableDict`` or both
+``ImmutableList`` objects are compared recursively. Instead of such a
+value as a whole, the differences within it are reported, with paths
+leading through it.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableDict_deep_diff(pyimmutable::ImmutableDict::Wrapper*self,
+                                     PyObject *other)
+/*[clinic end generated code: output=b69f319c05256637 input=0a279e3428fa5977]*/
+// clang-format on
+{
+  return pyimmutable::diff(self->ptr(), other, true).release();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableDict.diff
+
+  other: object
+  /
+
+Return the differences to ``other`` as ``(path, op, value)`` tuples.
+
+Each ``path`` is a tuple holding a single key. ``op`` is ``"add"``,
+``"remove"`` or ``"change"``, and ``value`` is the added, removed or
+new value. Subtrees shared by both dictionaries are skipped without
+being visited.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableDict_diff(pyimmutable::ImmutableDict::Wrapper*self,
+                                PyObject *other)
+/*[clinic end generated code: output=71fa15c7e4625040 input=5c7ba8fa0e5351f8]*/
+// clang-format on
+{
+  return pyimmutable::diff(self->ptr(), other, false).release();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // clang-format off
 /*[clinic input]
@@ -76,6 +161,44 @@ _pyimmutable_ImmutableDict_discard(pyimmutable::ImmutableDict::Wrapper*self,
   return self->discard<false>(key).release();
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableDict.discard_in
+
+  path: object
+  /
+
+Return a copy without the element at ``path``.
+
+Returns ``self`` if there is no such element.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableDict_discard_in(pyimmutable::ImmutableDict::Wrapper*self,
+                                      PyObject *path)
+/*[clinic end generated code: output=4c417e5049eb713c input=f6148d06ae8aabd7]*/
+// clang-format on
+{
+  return pyimmutable::discardIn(self->ptr(), path).release();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableDict.evolver
+
+Return an ``ImmutableDictEvolver`` for applying a batch of changes to a copy.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableDict_evolver_impl(pyimmutable::ImmutableDict::Wrapper*self)
+/*[clinic end generated code: output=2ab14ba46f207e9d input=691ce3d1379e63f2]*/
+// clang-format on
+{
+  return self->evolver().release();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // clang-format off
 /*[clinic input]
@@ -97,6 +220,30 @@ _pyimmutable_ImmutableDict_get_impl(pyimmutable::ImmutableDict::Wrapper*self,
   return self->get(key, default_value).release();
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableDict.get_in
+
+  path: object
+  default: object = None
+  /
+
+Return the element at ``path``, or ``default`` if there is none.
+
+``path`` is a sequence of keys and indices, leading through nested
+``ImmutableDict`` and ``ImmutableList`` objects.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableDict_get_in_impl(pyimmutable::ImmutableDict::Wrapper*self,
+                                       PyObject *path, PyObject *default_value)
+/*[clinic end generated code: output=e5dc17d2ea92fc84 input=ef061223e213b422]*/
+// clang-format on
+{
+  return pyimmutable::getIn(self->ptr(), path, default_value).release();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // clang-format off
 /*[clinic input]
@@ -172,6 +319,53 @@ _pyimmutable_ImmutableDict_set_impl(pyimmutable::ImmutableDict::Wrapper*self,
   return self->set(key, value).release();
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableDict.set_in
+
+  path: object
+  value: object
+  /
+
+Return a copy with the element at ``path`` set to ``value``.
+
+Keys missing along ``path`` are added, with empty ``ImmutableDict`` values.
+Raises ``IndexError`` if an index along ``path`` is out of range.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableDict_set_in_impl(pyimmutable::ImmutableDict::Wrapper*self,
+                                       PyObject *path, PyObject *value)
+/*[clinic end generated code: output=71a978f08323fa17 input=0e60bc6741ffa259]*/
+// clang-format on
+{
+  return pyimmutable::setIn(self->ptr(), path, value).release();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableDict.update_in
+
+  path: object
+  function: object
+  /
+
+Return a copy with the element at ``path`` replaced by ``function(element)``.
+
+Raises ``KeyError`` or ``IndexError`` if there is no such element.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableDict_update_in_impl(pyimmutable::ImmutableDict::Wrapper*self,
+                                          PyObject *path, PyObject *function)
+/*[clinic end generated code: output=0b3861a196ab5751 input=65277def3e2bc6e5]*/
+// clang-format on
+{
+  return pyimmutable::updateIn(self->ptr(), path, function).release();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // clang-format off
 /*[clinic input]
@@ -197,13 +391,26 @@ namespace {
 // clang-format off
 PyMethodDef ImmutableDict_methods[] = {
     _PYIMMUTABLE_IMMUTABLEDICT__GET_INSTANCE_COUNT_METHODDEF
+    _PYIMMUTABLE_IMMUTABLEDICT_APPLY_PATCH_METHODDEF
+    _PYIMMUTABLE_IMMUTABLEDICT_DEEP_DIFF_METHODDEF
+    _PYIMMUTABLE_IMMUTABLEDICT_DIFF_METHODDEF
     _PYIMMUTABLE_IMMUTABLEDICT_DISCARD_METHODDEF
+    _PYIMMUTABLE_IMMUTABLEDICT_DISCARD_IN_METHODDEF
+    _PYIMMUTABLE_IMMUTABLEDICT_EVOLVER_METHODDEF
     _PYIMMUTABLE_IMMUTABLEDICT_GET_METHODDEF
+    _PYIMMUTABLE_IMMUTABLEDICT_GET_IN_METHODDEF
     _PYIMMUTABLE_IMMUTABLEDICT_ITEMS_METHODDEF
     _PYIMMUTABLE_IMMUTABLEDICT_KEYS_METHODDEF
     _PYIMMUTABLE_IMMUTABLEDICT_POP_METHODDEF
     _PYIMMUTABLE_IMMUTABLEDICT_SET_METHODDEF
+    _PYIMMUTABLE_IMMUTABLEDICT_SET_IN_METHODDEF
+    _PYIMMUTABLE_IMMUTABLEDICT_UPDATE_IN_METHODDEF
     _PYIMMUTABLE_IMMUTABLEDICT_VALUES_METHODDEF
+    {"__sizeof__",
+     ImmutableDict::Wrapper::method<&ImmutableDict::sizeOf>(),
+     METH_NOARGS,
+     docstring_ImmutableDict___sizeof__
+   },
     {"update",
      reinterpret_cast<PyCFunction>(static_cast<PyCFunctionWithKeywords>(
          ImmutableDict::Wrapper::method<&ImmutableDict::update>())),
@@ -220,6 +427,11 @@ PyMappingMethods ImmutableDict_mappingMethods = {
 };
 
 PyGetSetDef ImmutableDict_getset[] = {
+    {"digest",
+     ImmutableDict::Wrapper::method<&ImmutableDict::digestBytes>(),
+     nullptr,
+     docstring_ImmutableDict_digest,
+     nullptr},
     {"isImmutableJson",
      ImmutableDict::Wrapper::method<&ImmutableDict::isImmutableJsonDict>(),
      nullptr,
@@ -232,9 +444,168 @@ PyGetSetDef ImmutableDict_getset[] = {
      nullptr},
     {nullptr}};
 
+// clang-format off
+PyMethodDef ImmutableDictEvolver_methods[] = {
+    {"discard",
+     ImmutableDictEvolver::Wrapper::method<&ImmutableDictEvolver::discard>(),
+     METH_O,
+     docstring_ImmutableDictEvolver_discard
+   },
+    {"persistent",
+     ImmutableDictEvolver::Wrapper::method<&ImmutableDictEvolver::persistent>(),
+     METH_NOARGS,
+     docstring_ImmutableDictEvolver_persistent
+   },
+    {"set",
+     ImmutableDictEvolver::Wrapper::method<&ImmutableDictEvolver::set>(),
+     METH_VARARGS,
+     docstring_ImmutableDictEvolver_set
+   },
+    {"update",
+     reinterpret_cast<PyCFunction>(static_cast<PyCFunctionWithKeywords>(
+         ImmutableDictEvolver::Wrapper::method<
+             &ImmutableDictEvolver::update>())),
+     METH_VARARGS | METH_KEYWORDS,
+     docstring_ImmutableDictEvolver_update
+   },
+    {nullptr}};
+// clang-format on
+
+PyMappingMethods ImmutableDictEvolver_mappingMethods = {
+    .mp_length =
+        ImmutableDictEvolver::Wrapper::method<&ImmutableDictEvolver::len>(),
+    .mp_subscript =
+        ImmutableDictEvolver::Wrapper::method<&ImmutableDictEvolver::getItem>(),
+    .mp_ass_subscript = ImmutableDictEvolver::Wrapper::method<
+        &ImmutableDictEvolver::assSubscript>(),
+};
+
 } // namespace
 
 namespace pyimmutable {
+PyObjectRef makeImmutableDict(
+    std::pair<PyObjectRef, PyObjectRef> const* items,
+    std::size_t count) {
+  return ImmutableDict::fromItems(items, count);
+}
+
+bool writeImmutableDictJson(std::string& out, PyObject* obj, bool cache) {
+  return ImmutableDict::Wrapper::cast(obj)->writeJson(out, cache);
+}
+
+bool writeImmutableDictBinary(BinaryWriter& writer, PyObject* obj) {
+  auto const& map = ImmutableDict::Wrapper::cast(obj)->map_;
+  writer.writeTag(binary_tag::kDict);
+  writer.writeSize(map.size());
+  for (auto const& item : map) {
+    if (!writer.write(item.second.key.get()) ||
+        !writer.write(item.second.value.get())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+PyObject*
+immutableDictLookUp(PyObject* dict, PyObject* key, Sha1Hash& key_hash) {
+  key_hash = keyHash(key);
+  auto const* ptr = ImmutableDict::Wrapper::cast(dict)->map_.find(key_hash);
+  return ptr ? ptr->value.get() : nullptr;
+}
+
+PyObjectRef immutableDictSet(
+    PyObject* dict,
+    PyObject* key,
+    Sha1Hash const& key_hash,
+    PyObject* value) {
+  return ImmutableDict::Wrapper::cast(dict)->set(
+      key, value, key_hash, Sha1Hasher{}(key)(value).final());
+}
+
+PyObjectRef immutableDictDiscard(PyObject* dict, Sha1Hash const& key_hash) {
+  auto* const self = ImmutableDict::Wrapper::cast(dict);
+  auto const* ptr = self->map_.find(key_hash);
+  if (!ptr) {
+    return PyObjectRef{dict};
+  }
+  return self->erase(key_hash, *ptr);
+}
+
+PyObjectRef newImmutableDictEvolver(PyObject* dict) {
+  return ImmutableDict::Wrapper::cast(dict)->evolver();
+}
+
+PyObject*
+immutableDictEvolverLookUp(PyObject* evolver, Sha1Hash const& key_hash) {
+  auto const* ptr =
+      ImmutableDictEvolver::Wrapper::cast(evolver)->map_.find(key_hash);
+  return ptr ? ptr->value.get() : nullptr;
+}
+
+void immutableDictEvolverSet(
+    PyObject* evolver,
+    PyObject* key,
+    Sha1Hash const& key_hash,
+    PyObject* value) {
+  ImmutableDictEvolver::Wrapper::cast(evolver)->setItem(key, key_hash, value);
+}
+
+void immutableDictEvolverDiscard(PyObject* evolver, Sha1Hash const& key_hash) {
+  ImmutableDictEvolver::Wrapper::cast(evolver)->erase(key_hash);
+}
+
+PyObjectRef immutableDictEvolverPersistent(PyObject* evolver) {
+  return ImmutableDictEvolver::Wrapper::cast(evolver)->persistent(nullptr);
+}
+
+bool forEachImmutableDictItem(
+    PyObject* dict,
+    std::function<bool(Sha1Hash const&, PyObject*, PyObject*)> const&
+        callback) {
+  for (auto const& item : ImmutableDict::Wrapper::cast(dict)->map_) {
+    if (!callback(item.first, item.second.key.get(), item.second.value.get())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool diffImmutableDicts(
+    PyObject* a,
+    PyObject* b,
+    DiffCallback const& callback) {
+  // immer::diff cannot be interrupted, so once the callback fails, the
+  // remaining differences are skipped
+  bool ok = true;
+  immer::diff(
+      ImmutableDict::Wrapper::cast(a)->map_,
+      ImmutableDict::Wrapper::cast(b)->map_,
+      [&](auto const& added) {
+        ok = ok &&
+            callback(
+                 added.second.key.get(), nullptr, added.second.value.get());
+      },
+      [&](auto const& removed) {
+        ok = ok &&
+            callback(
+                 removed.second.key.get(),
+                 removed.second.value.get(),
+                 nullptr);
+      },
+      [&](auto const& old_item, auto const& new_item) {
+        ok = ok &&
+            callback(
+                 new_item.second.key.get(),
+                 old_item.second.value.get(),
+                 new_item.second.value.get());
+      });
+  return ok;
+}
+
+Sha1Hash const& immutableDictSha1(PyObject* dict) {
+  return ImmutableDict::Wrapper::cast(dict)->sha1;
+}
+
 bool isImmutableJsonDict(PyObject* obj) {
   return ImmutableDict::Wrapper::cast(obj)->isImmutableJson;
 }
@@ -271,4 +642,17 @@ PyTypeObject* getImmutableDictIterTypeObject() {
   return ImmutableDictIter::Wrapper::initType();
 }
 
+template <>
+PyTypeObject ImmutableDictEvolver::Wrapper::typeObject = {
+    PyVarObject_HEAD_INIT(nullptr, 0) //
+        .tp_name = "ImmutableDictEvolver",
+    .tp_as_mapping = &ImmutableDictEvolver_mappingMethods,
+    .tp_doc = docstring_ImmutableDictEvolver,
+    .tp_methods = ImmutableDictEvolver_methods,
+    .tp_new = &disallow_construction,
+};
+PyTypeObject* getImmutableDictEvolverTypeObject() {
+  return ImmutableDictEvolver::Wrapper::initType();
+}
+
 } // namespace pyimmutable
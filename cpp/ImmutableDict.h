@@ -24,14 +24,79 @@
 
 #pragma once
 
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+
 #include <Python.h>
 
+#include "Diff.h"
+#include "PyObjectRef.h"
+#include "Sha1Hash.h"
+
 namespace pyimmutable {
 
+class BinaryWriter;
+
 PyTypeObject* getImmutableDictTypeObject();
 extern PyTypeObject* immutableDictTypeObject;
 PyTypeObject* getImmutableDictIterTypeObject();
+PyTypeObject* getImmutableDictEvolverTypeObject();
+
+// Returns the ImmutableDict with the given key/value pairs. Later pairs
+// override earlier ones with the same key.
+PyObjectRef makeImmutableDict(
+    std::pair<PyObjectRef, PyObjectRef> const* items,
+    std::size_t count);
+
+// Returns the value stored under `key` in `dict` as a borrowed reference, or
+// nullptr if there is none. Stores the hash of `key` in `key_hash`.
+PyObject*
+immutableDictLookUp(PyObject* dict, PyObject* key, Sha1Hash& key_hash);
+
+// Returns a copy of `dict` with `key`, whose hash is `key_hash`, set to
+// `value`.
+PyObjectRef immutableDictSet(
+    PyObject* dict,
+    PyObject* key,
+    Sha1Hash const& key_hash,
+    PyObject* value);
+
+// Returns a copy of `dict` without the key whose hash is `key_hash`.
+PyObjectRef immutableDictDiscard(PyObject* dict, Sha1Hash const& key_hash);
+
+// Batched modification of `dict` through an ImmutableDictEvolver, which
+// interns only the final version. The functions taking an evolver use key
+// hashes in the same way as the ones above.
+PyObjectRef newImmutableDictEvolver(PyObject* dict);
+PyObject*
+immutableDictEvolverLookUp(PyObject* evolver, Sha1Hash const& key_hash);
+void immutableDictEvolverSet(
+    PyObject* evolver,
+    PyObject* key,
+    Sha1Hash const& key_hash,
+    PyObject* value);
+void immutableDictEvolverDiscard(PyObject* evolver, Sha1Hash const& key_hash);
+PyObjectRef immutableDictEvolverPersistent(PyObject* evolver);
+
+// Calls `callback` with the hash of each key of `dict`, the key and its value,
+// in no particular order. Stops and returns false as soon as `callback` does.
+bool forEachImmutableDictItem(
+    PyObject* dict,
+    std::function<bool(Sha1Hash const&, PyObject*, PyObject*)> const&
+        callback);
+
+// Calls `callback` for every key that is not mapped to the same value in `a`
+// and `b`. Subtrees shared by both dictionaries are skipped without being
+// visited.
+bool diffImmutableDicts(PyObject* a, PyObject* b, DiffCallback const& callback);
+
+// Returns the content hash of `dict`.
+Sha1Hash const& immutableDictSha1(PyObject* dict);
 
 bool isImmutableJsonDict(PyObject*);
+bool writeImmutableDictJson(std::string& out, PyObject*, bool cache);
+bool writeImmutableDictBinary(BinaryWriter& writer, PyObject*);
 
 } // namespace pyimmutable
@@ -25,12 +25,20 @@
 #include "ImmutableDict.h"
 
 #include <cstddef>
+#include <functional>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <immer/map.hpp>
+#include <immer/map_transient.hpp>
 
 #include "ClassWrapper.h"
+#include "Json.h"
+#include "KeyHashCache.h"
+#include "MemoryPolicy.h"
 #include "PyObjectRef.h"
 #include "Sha1Hasher.h"
 #include "util.h"
@@ -39,18 +47,51 @@ namespace pyimmutable {
 
 namespace {
 
+// The digest comes first and the isImmutableJson flag is kept in the tag bit
+// of the value reference, so that a map entry (key digest followed by the
+// item) has no padding.
 struct DictItem {
-  PyObjectRef key;
-  PyObjectRef value;
-  Sha1Hash valueHash;
-  bool isImmutableJson;
+  Sha1Hash valueHash{};
+  TaggedPyObjectRef key;
+  TaggedPyObjectRef value;
+
+  DictItem() = default;
+  DictItem(
+      PyObjectRef key,
+      PyObjectRef value,
+      Sha1Hash const& valueHash,
+      bool isImmutableJson)
+      : valueHash(valueHash),
+        key(std::move(key)),
+        value(std::move(value), isImmutableJson) {}
+
+  bool isImmutableJson() const {
+    return value.flag();
+  }
 };
+static_assert(sizeof(DictItem) == sizeof(Sha1Hash) + 2 * sizeof(PyObject*));
+
+// The value hash covers both key and value, so items with equal value hashes
+// are interchangeable. This is what immer::diff compares.
+inline bool operator==(DictItem const& a, DictItem const& b) {
+  return a.valueHash == b.valueHash;
+}
+
+inline bool operator!=(DictItem const& a, DictItem const& b) {
+  return !(a == b);
+}
 
 bool isImmutableJsonItem(PyObject* key, PyObject* value) {
   return PyUnicode_CheckExact(key) && isImmutableJsonObject(value);
 }
 
-using MapType = immer::map<Sha1Hash, DictItem, Sha1HashHasher>;
+using MapType = immer::map<
+    Sha1Hash,
+    DictItem,
+    Sha1HashHasher,
+    std::equal_to<Sha1Hash>,
+    MemoryPolicy>;
+using TransientMapType = MapType::transient_type;
 
 struct ImmutableDictIter {
   using Wrapper = ClassWrapper<ImmutableDictIter>;
@@ -80,11 +121,11 @@ struct ImmutableDictIter {
   }
 
   static PyObjectRef keyExtractor(DictItem const& item) {
-    return item.key;
+    return item.key.copy();
   }
 
   static PyObjectRef valueExtractor(DictItem const& item) {
-    return item.value;
+    return item.value.copy();
   }
 
   static PyObjectRef itemExtractor(DictItem const& item) {
@@ -102,6 +143,7 @@ struct ImmutableDict {
   std::size_t const immutableJsonItems;
   bool const isImmutableJson;
   PyObjectRef meta_;
+  std::unique_ptr<std::string const> jsonFragment_;
 
   ImmutableDict(MapType&& mapx, Sha1Hash sha1, std::size_t immutable_json_items)
       : map_(std::move(mapx)),
@@ -110,7 +152,7 @@ struct ImmutableDict {
         isImmutableJson(immutableJsonItems == map_.size()) {}
 
   PyObjectRef getItem(PyObject* key) noexcept {
-    auto const h = Sha1Hasher()(key).final();
+    auto const h = keyHash(key);
     auto const* ptr = map_.find(h);
     if (!ptr) {
       PyErr_SetObject(PyExc_KeyError, PyObjectRef{key}.release());
@@ -121,17 +163,25 @@ struct ImmutableDict {
   }
 
   PyObjectRef get(PyObject* key, PyObject* default_value) noexcept {
-    auto const h = Sha1Hasher()(key).final();
+    auto const h = keyHash(key);
     auto const* ptr = map_.find(h);
     if (!ptr) {
       return PyObjectRef{default_value};
     } else {
-      return ptr->value;
+      return ptr->value.copy();
     }
   }
 
   PyObjectRef set(PyObject* key, PyObject* value) noexcept {
     auto const [hkey, hvalue] = keyValueHashes(key, value);
+    return set(key, value, hkey, hvalue);
+  }
+
+  PyObjectRef set(
+      PyObject* key,
+      PyObject* value,
+      Sha1Hash const& hkey,
+      Sha1Hash const& hvalue) noexcept {
     auto map_hash = sha1;
     auto immutable_json_items = immutableJsonItems;
 
@@ -142,7 +192,7 @@ struct ImmutableDict {
       }
 
       xorHashInPlace(map_hash, ptr->valueHash);
-      if (ptr->isImmutableJson) {
+      if (ptr->isImmutableJson()) {
         --immutable_json_items;
       }
     }
@@ -167,7 +217,7 @@ struct ImmutableDict {
 
   template <bool Raise>
   PyObjectRef discard(PyObject* key) noexcept {
-    auto const h = Sha1Hasher()(key).final();
+    auto const h = keyHash(key);
     auto const* ptr = map_.find(h);
     if (!ptr) {
       if (Raise) {
@@ -176,22 +226,34 @@ struct ImmutableDict {
       }
       return TypedPyObjectRef{Wrapper::cast(this)};
     } else {
-      auto map_hash = sha1;
-      auto immutable_json_items = immutableJsonItems;
-      xorHashInPlace(map_hash, ptr->valueHash);
-      if (ptr->isImmutableJson) {
-        --immutable_json_items;
-      }
-      return Wrapper::getOrCreate(map_hash, [&]() {
-        return ImmutableDict{map_.erase(h), map_hash, immutable_json_items};
-      });
+      return erase(h, *ptr);
+    }
+  }
+
+  // Returns a copy without `item`, which is stored under the key hash `h`.
+  PyObjectRef erase(Sha1Hash const& h, DictItem const& item) noexcept {
+    auto map_hash = sha1;
+    auto immutable_json_items = immutableJsonItems;
+    xorHashInPlace(map_hash, item.valueHash);
+    if (item.isImmutableJson()) {
+      --immutable_json_items;
     }
+    return Wrapper::getOrCreate(map_hash, [&]() {
+      return ImmutableDict{map_.erase(h), map_hash, immutable_json_items};
+    });
   }
 
   Py_ssize_t len() {
     return map_.size();
   }
 
+  PyObjectRef sizeOf(PyObject* /* unused */) {
+    return PyObjectRef{
+        PyLong_FromSize_t(
+            sizeof(Wrapper) + map_.size() * sizeof(MapType::value_type)),
+        false};
+  }
+
   PyObjectRef iterImpl(ImmutableDictIter::Extractor extractor) {
     return ImmutableDictIter::Wrapper::create(
         map_.begin(),
@@ -283,6 +345,45 @@ struct ImmutableDict {
     return PyObjectRef(isImmutableJson ? Py_True : Py_False);
   }
 
+  bool writeJson(std::string& out, bool cache) {
+    if (jsonFragment_) {
+      out += *jsonFragment_;
+      return true;
+    }
+
+    std::size_t const begin = out.size();
+    out += '{';
+    bool first = true;
+    for (auto const& item : map_) {
+      if (!first) {
+        out += ", ";
+      }
+      first = false;
+      if (!writeJsonKey(out, item.second.key.get())) {
+        return false;
+      }
+      out += ": ";
+      if (!pyimmutable::writeJson(out, item.second.value.get(), cache)) {
+        return false;
+      }
+    }
+    out += '}';
+
+    if (cache && isImmutableJson) {
+      jsonFragment_ = std::make_unique<std::string const>(out, begin);
+    }
+    return true;
+  }
+
+  PyObjectRef evolver();
+
+  PyObjectRef digestBytes(void* /* unused */) {
+    return PyObjectRef{
+        PyBytes_FromStringAndSize(
+            reinterpret_cast<char const*>(sha1.data()), sha1.size()),
+        false};
+  }
+
   PyObjectRef meta(void* /* unused */) {
     if (!meta_) {
       meta_ = PyObjectRef{PyDict_New(), false};
@@ -293,7 +394,7 @@ struct ImmutableDict {
   static PyObjectRef new_(PyTypeObject* type, PyObject* args, PyObject* kwds) {
     Sha1Hash map_hash{0};
     std::size_t immutable_json_items = 0;
-    MapType map;
+    TransientMapType map;
 
     if (!updateCommon(
             map_hash, immutable_json_items, map, args, kwds, "ImmutableDict")) {
@@ -301,13 +402,14 @@ struct ImmutableDict {
     }
 
     return Wrapper::getOrCreate(map_hash, [&]() {
-      return ImmutableDict{std::move(map), map_hash, immutable_json_items};
+      return ImmutableDict{
+          std::move(map).persistent(), map_hash, immutable_json_items};
     });
   }
 
   PyObjectRef update(PyObject* args, PyObject* kwds) {
     auto map_hash = sha1;
-    auto map = map_;
+    auto map = map_.transient();
     auto immutable_json_items = immutableJsonItems;
 
     if (!updateCommon(
@@ -316,14 +418,15 @@ struct ImmutableDict {
     }
 
     return Wrapper::getOrCreate(map_hash, [&]() {
-      return ImmutableDict{std::move(map), map_hash, immutable_json_items};
+      return ImmutableDict{
+          std::move(map).persistent(), map_hash, immutable_json_items};
     });
   }
 
   static bool updateCommon(
       Sha1Hash& hash,
       std::size_t& immutable_json_items,
-      MapType& map,
+      TransientMapType& map,
       PyObject* args,
       PyObject* kwds,
       char const* methname) {
@@ -334,9 +437,8 @@ struct ImmutableDict {
     }
 
     if (arg) {
-      _Py_IDENTIFIER(keys);
       PyObject* func = nullptr;
-      if (_PyObject_LookupAttrId(arg, &PyId_keys, &func) < 0) {
+      if (lookupAttr(arg, "keys", &func) < 0) {
         return false;
       }
       if (func) {
@@ -367,7 +469,7 @@ struct ImmutableDict {
   static bool merge(
       Sha1Hash& hash,
       std::size_t& immutable_json_items,
-      MapType& map,
+      TransientMapType& map,
       PyObject* arg) {
     PyObjectRef keys{PyMapping_Keys(arg), false};
     if (!keys) {
@@ -380,28 +482,41 @@ struct ImmutableDict {
     }
     keys = {};
 
+    KeyValuePairs kvs;
+    kvs.reserve(kHashBatchSize);
+
     while (auto key = PyObjectRef{PyIter_Next(iter.get()), false}) {
       PyObjectRef value{PyObject_GetItem(arg, key.get()), false};
       if (!value) {
         return false;
       }
 
-      map_set(hash, immutable_json_items, map, key.get(), value.get());
+      kvs.emplace_back(std::move(key), std::move(value));
+      if (kvs.size() == kHashBatchSize) {
+        map_set_many(hash, immutable_json_items, map, kvs);
+      }
     }
 
-    return !PyErr_Occurred();
+    if (PyErr_Occurred()) {
+      return false;
+    }
+    map_set_many(hash, immutable_json_items, map, kvs);
+    return true;
   }
 
   static bool mergeFromSequence(
       Sha1Hash& hash,
       std::size_t& immutable_json_items,
-      MapType& map,
+      TransientMapType& map,
       PyObject* arg) {
     PyObjectRef iter{PyObject_GetIter(arg), false};
     if (!iter) {
       return false;
     }
 
+    KeyValuePairs kvs;
+    kvs.reserve(kHashBatchSize);
+
     while (auto kv = PyObjectRef{PyIter_Next(iter.get()), false}) {
       PyObjectRef kvseq{PySequence_Fast(kv.get(), ""), false};
       if (!kvseq) {
@@ -415,25 +530,87 @@ struct ImmutableDict {
         return false;
       }
 
-      map_set(
-          hash,
-          immutable_json_items,
-          map,
-          PySequence_Fast_GET_ITEM(kvseq.get(), 0),
-          PySequence_Fast_GET_ITEM(kvseq.get(), 1));
+      kvs.emplace_back(
+          PyObjectRef{PySequence_Fast_GET_ITEM(kvseq.get(), 0)},
+          PyObjectRef{PySequence_Fast_GET_ITEM(kvseq.get(), 1)});
+      if (kvs.size() == kHashBatchSize) {
+        map_set_many(hash, immutable_json_items, map, kvs);
+      }
+    }
+
+    if (PyErr_Occurred()) {
+      return false;
     }
+    map_set_many(hash, immutable_json_items, map, kvs);
+    return true;
+  }
+
+  using KeyValuePair = std::pair<PyObjectRef, PyObjectRef>;
+  using KeyValuePairs = std::vector<KeyValuePair>;
+
+  // Sets all given key/value pairs, in order, and clears `kvs`.
+  static void map_set_many(
+      Sha1Hash& hash,
+      std::size_t& immutable_json_items,
+      TransientMapType& map,
+      KeyValuePairs& kvs) {
+    map_set_many(hash, immutable_json_items, map, kvs.data(), kvs.size());
+    kvs.clear();
+  }
+
+  // Sets `count` key/value pairs, in order. Key and value hashes of the whole
+  // batch are computed together.
+  static void map_set_many(
+      Sha1Hash& hash,
+      std::size_t& immutable_json_items,
+      TransientMapType& map,
+      KeyValuePair const* kvs,
+      std::size_t count) {
+    Sha1Hash hkey;
+    hashMany(
+        2 * count,
+        [&](Sha1Hasher& hasher, std::size_t i) {
+          // the value hash covers both key and value, see keyValueHashes
+          hasher(kvs[i / 2].first.get());
+          if (i % 2) {
+            hasher(kvs[i / 2].second.get());
+          }
+        },
+        [&](std::size_t i, Sha1Hash const& h) {
+          if (i % 2 == 0) {
+            hkey = h;
+          } else {
+            map_set(
+                hash,
+                immutable_json_items,
+                map,
+                kvs[i / 2].first.get(),
+                kvs[i / 2].second.get(),
+                hkey,
+                h);
+          }
+        });
+  }
 
-    return !PyErr_Occurred();
+  static PyObjectRef fromItems(KeyValuePair const* kvs, std::size_t count) {
+    Sha1Hash map_hash{0};
+    std::size_t immutable_json_items = 0;
+    TransientMapType map;
+    map_set_many(map_hash, immutable_json_items, map, kvs, count);
+    return Wrapper::getOrCreate(map_hash, [&]() {
+      return ImmutableDict{
+          std::move(map).persistent(), map_hash, immutable_json_items};
+    });
   }
 
   static void map_set(
       Sha1Hash& hash,
       std::size_t& immutable_json_items,
-      MapType& map,
+      TransientMapType& map,
       PyObject* key,
-      PyObject* value) {
-    auto const [hkey, hvalue] = keyValueHashes(key, value);
-
+      PyObject* value,
+      Sha1Hash const& hkey,
+      Sha1Hash const& hvalue) {
     auto const* ptr = map.find(hkey);
     if (ptr) {
       if (ptr->valueHash == hvalue) {
@@ -441,7 +618,7 @@ struct ImmutableDict {
       }
 
       xorHashInPlace(hash, ptr->valueHash);
-      if (ptr->isImmutableJson) {
+      if (ptr->isImmutableJson()) {
         --immutable_json_items;
       }
     }
@@ -452,12 +629,128 @@ struct ImmutableDict {
       ++immutable_json_items;
     }
 
-    map = map.insert(std::make_pair(
+    map.set(
         hkey,
         DictItem{
-            PyObjectRef{key}, PyObjectRef{value}, hvalue, is_immutable_json}));
+            PyObjectRef{key}, PyObjectRef{value}, hvalue, is_immutable_json});
+  }
+};
+
+// A mutable copy of an ImmutableDict, for applying a batch of changes without
+// creating (and interning) an ImmutableDict for each intermediate state.
+struct ImmutableDictEvolver {
+  using Wrapper = ClassWrapper<ImmutableDictEvolver>;
+
+  TransientMapType map_;
+  Sha1Hash hash_;
+  std::size_t immutableJsonItems_;
+
+  explicit ImmutableDictEvolver(ImmutableDict const& dict)
+      : map_(dict.map_.transient()),
+        hash_(dict.sha1),
+        immutableJsonItems_(dict.immutableJsonItems) {}
+
+  PyObjectRef self() {
+    return TypedPyObjectRef{Wrapper::cast(this)};
+  }
+
+  PyObjectRef getItem(PyObject* key) noexcept {
+    auto const* ptr = map_.find(keyHash(key));
+    if (!ptr) {
+      PyErr_SetObject(PyExc_KeyError, PyObjectRef{key}.release());
+      return nullptr;
+    }
+    return ptr->value.copy();
+  }
+
+  void setItem(PyObject* key, PyObject* value) noexcept {
+    auto const [hkey, hvalue] = keyValueHashes(key, value);
+    ImmutableDict::map_set(
+        hash_, immutableJsonItems_, map_, key, value, hkey, hvalue);
+  }
+
+  void setItem(
+      PyObject* key,
+      Sha1Hash const& key_hash,
+      PyObject* value) noexcept {
+    ImmutableDict::map_set(
+        hash_,
+        immutableJsonItems_,
+        map_,
+        key,
+        value,
+        key_hash,
+        Sha1Hasher{}(key)(value).final());
+  }
+
+  // Removes the item whose key hash is `h`. Returns false if there is none.
+  bool erase(Sha1Hash const& h) noexcept {
+    auto const* ptr = map_.find(h);
+    if (!ptr) {
+      return false;
+    }
+
+    xorHashInPlace(hash_, ptr->valueHash);
+    if (ptr->isImmutableJson()) {
+      --immutableJsonItems_;
+    }
+    map_.erase(h);
+    return true;
+  }
+
+  bool delItem(PyObject* key, bool raise) noexcept {
+    if (!erase(keyHash(key)) && raise) {
+      PyErr_SetObject(PyExc_KeyError, PyObjectRef{key}.release());
+      return false;
+    }
+    return true;
+  }
+
+  int assSubscript(PyObject* key, PyObject* value) noexcept {
+    if (value) {
+      setItem(key, value);
+      return 0;
+    }
+    return delItem(key, true) ? 0 : -1;
+  }
+
+  PyObjectRef set(PyObject* args) noexcept {
+    PyObject* key;
+    PyObject* value;
+    if (!PyArg_UnpackTuple(args, "set", 2, 2, &key, &value)) {
+      return nullptr;
+    }
+    setItem(key, value);
+    return self();
+  }
+
+  PyObjectRef discard(PyObject* key) noexcept {
+    delItem(key, false);
+    return self();
+  }
+
+  PyObjectRef update(PyObject* args, PyObject* kwds) {
+    if (!ImmutableDict::updateCommon(
+            hash_, immutableJsonItems_, map_, args, kwds, "update")) {
+      return nullptr;
+    }
+    return self();
+  }
+
+  Py_ssize_t len() {
+    return map_.size();
+  }
+
+  PyObjectRef persistent(PyObject* /* unused */) {
+    return ImmutableDict::Wrapper::getOrCreate(hash_, [&]() {
+      return ImmutableDict{map_.persistent(), hash_, immutableJsonItems_};
+    });
   }
 };
 
+inline PyObjectRef ImmutableDict::evolver() {
+  return ImmutableDictEvolver::Wrapper::create(*this);
+}
+
 } // namespace
 } // namespace pyimmutable
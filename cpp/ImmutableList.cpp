@@ -23,6 +23,16 @@
  */
 
 #include "ImmutableListImpl.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <immer/algorithm.hpp>
+
+#include "Binary.h"
+#include "Diff.h"
+#include "Path.h"
 #include "clinic/ImmutableList.cpp.h"
 #include "docstrings.autogen.h"
 
@@ -90,6 +100,35 @@ _pyimmutable_ImmutableList_append(pyimmutable::ImmutableList::Wrapper*self,
   return self->append(value).release();
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableList.apply_patch
+
+  patch: object
+  /
+
+Return a copy with the changes of ``patch`` applied.
+
+``patch`` is an iterable of ``(path, op, value)`` tuples, as returned
+by ``diff`` and ``deep_diff``. ``"add"`` and ``"change"`` entries set
+the element at ``path`` to ``value``, like ``set_in``, with ``"add"``
+inserting into ``ImmutableList`` objects. ``"remove"`` entries discard
+the element at ``path``, like ``discard_in``.
+
+All entries are applied in one pass, creating only the final versions
+of the modified containers.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableList_apply_patch(pyimmutable::ImmutableList::Wrapper*self,
+                                       PyObject *patch)
+/*[clinic end generated code: output=7d6efd3375ef967a input=79fd9beab3c8f3c2]*/
+// clang-format on
+{
+  return pyimmutable::applyPatch(self->ptr(), patch).release();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // clang-format off
 /*[clinic input]
@@ -110,6 +149,141 @@ _pyimmutable_ImmutableList_count(pyimmutable::ImmutableList::Wrapper*self,
   return self->count(value).release();
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableList.deep_diff
+
+  other: object
+  /
+
+Return the differences to ``other``, comparing nested containers.
+
+Like ``diff``, but values that are both ``ImmutableDict`` or both
+``ImmutableList`` objects are compared recursively. Instead of such a
+value as a whole, the differences within it are reported, with paths
+leading through it.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableList_deep_diff(pyimmutable::ImmutableList::Wrapper*self,
+                                     PyObject *other)
+/*[clinic end generated code: output=96277c20ce43c9a6 input=72406b45cda46520]*/
+// clang-format on
+{
+  return pyimmutable::diff(self->ptr(), other, true).release();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableList.delete
+
+  index: Py_ssize_t
+  /
+
+Return a copy with item ``index`` removed.
+
+Raises ``IndexError`` if ``index`` is outside the range of existing elements.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableList_delete_impl(pyimmutable::ImmutableList::Wrapper*self,
+                                       Py_ssize_t index)
+/*[clinic end generated code: output=a7b54c6c941e5ee3 input=d8624145813a14d9]*/
+// clang-format on
+{
+  return self->delete_(index).release();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableList.diff
+
+  other: object
+  /
+
+Return the differences to ``other`` as ``(path, op, value)`` tuples.
+
+Each ``path`` is a tuple holding a single index. ``op`` is ``"add"``,
+``"remove"`` or ``"change"``, and ``value`` is the added, removed or
+new value. Elements added at the end are reported in ascending order,
+elements removed from the end in descending order after all other
+entries, so that the entries can be applied one after the other.
+
+Elements are compared by position. Parts of the tree that both lists
+share are skipped, but the cost still grows with the length of the
+lists, not only with the number of differences.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableList_diff(pyimmutable::ImmutableList::Wrapper*self,
+                                PyObject *other)
+/*[clinic end generated code: output=41c5de6ac7c39498 input=646997a6383ab2d1]*/
+// clang-format on
+{
+  return pyimmutable::diff(self->ptr(), other, false).release();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableList.discard_in
+
+  path: object
+  /
+
+Return a copy without the element at ``path``.
+
+Returns ``self`` if there is no such element.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableList_discard_in(pyimmutable::ImmutableList::Wrapper*self,
+                                      PyObject *path)
+/*[clinic end generated code: output=5088b1b77308d1b1 input=9ba3a3a364694e13]*/
+// clang-format on
+{
+  return pyimmutable::discardIn(self->ptr(), path).release();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableList.drop
+
+  count: Py_ssize_t
+  /
+
+Return a copy without the first ``count`` elements.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableList_drop_impl(pyimmutable::ImmutableList::Wrapper*self,
+                                     Py_ssize_t count)
+/*[clinic end generated code: output=a139b4cd1d6d112a input=81e465f391dc9ade]*/
+// clang-format on
+{
+  return self->drop(count).release();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableList.evolver
+
+Return an ``ImmutableListEvolver`` for applying a batch of changes to a copy.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableList_evolver_impl(pyimmutable::ImmutableList::Wrapper*self)
+/*[clinic end generated code: output=3e0ef4df5c256d21 input=98ef6cb1a623f17f]*/
+// clang-format on
+{
+  return self->evolver().release();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // clang-format off
 /*[clinic input]
@@ -130,6 +304,30 @@ _pyimmutable_ImmutableList_extend(pyimmutable::ImmutableList::Wrapper*self,
   return self->extend(iterable).release();
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableList.get_in
+
+  path: object
+  default: object = None
+  /
+
+Return the element at ``path``, or ``default`` if there is none.
+
+``path`` is a sequence of keys and indices, leading through nested
+``ImmutableDict`` and ``ImmutableList`` objects.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableList_get_in_impl(pyimmutable::ImmutableList::Wrapper*self,
+                                       PyObject *path, PyObject *default_value)
+/*[clinic end generated code: output=654b97759dea0d44 input=020e8090f46f3d34]*/
+// clang-format on
+{
+  return pyimmutable::getIn(self->ptr(), path, default_value).release();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // clang-format off
 /*[clinic input]
@@ -155,6 +353,27 @@ _pyimmutable_ImmutableList_index_impl(pyimmutable::ImmutableList::Wrapper*self,
   return self->index(value, start, stop).release();
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableList.insert
+
+  index: Py_ssize_t
+  value: object
+  /
+
+Return a copy with ``value`` inserted before item ``index``.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableList_insert_impl(pyimmutable::ImmutableList::Wrapper*self,
+                                       Py_ssize_t index, PyObject *value)
+/*[clinic end generated code: output=00a2c0aa5acf2e31 input=c11cb6aadae196ac]*/
+// clang-format on
+{
+  return self->insert(index, value).release();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // clang-format off
 /*[clinic input]
@@ -178,6 +397,78 @@ _pyimmutable_ImmutableList_set_impl(pyimmutable::ImmutableList::Wrapper*self,
   return self->set(index, value).release();
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableList.set_in
+
+  path: object
+  value: object
+  /
+
+Return a copy with the element at ``path`` set to ``value``.
+
+Keys missing along ``path`` are added, with empty ``ImmutableDict`` values.
+Raises ``IndexError`` if an index along ``path`` is out of range.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableList_set_in_impl(pyimmutable::ImmutableList::Wrapper*self,
+                                       PyObject *path, PyObject *value)
+/*[clinic end generated code: output=427b9d20eadc675a input=325eb6725a4d0f49]*/
+// clang-format on
+{
+  return pyimmutable::setIn(self->ptr(), path, value).release();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableList.splice
+
+  start: Py_ssize_t
+  stop: Py_ssize_t
+  iterable: object
+  /
+
+Return a copy with items ``start`` to ``stop`` replaced by ``iterable``.
+
+This is the equivalent of ``lst[start:stop] = iterable`` for ``list``.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableList_splice_impl(pyimmutable::ImmutableList::Wrapper*self,
+                                       Py_ssize_t start, Py_ssize_t stop,
+                                       PyObject *iterable)
+/*[clinic end generated code: output=aa6c29767e8f53a9 input=5d817052c0aaab71]*/
+// clang-format on
+{
+  return self->splice(start, stop, iterable).release();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// clang-format off
+/*[clinic input]
+_pyimmutable.ImmutableList.update_in
+
+  path: object
+  function: object
+  /
+
+Return a copy with the element at ``path`` replaced by ``function(element)``.
+
+Raises ``KeyError`` or ``IndexError`` if there is no such element.
+[clinic start generated code]*/
+
+static PyObject *
+_pyimmutable_ImmutableList_update_in_impl(pyimmutable::ImmutableList::Wrapper*self,
+                                          PyObject *path, PyObject *function)
+/*[clinic end generated code: output=a5ab305cd90823ec input=4ec726a575b1135a]*/
+// clang-format on
+{
+  return pyimmutable::updateIn(self->ptr(), path, function).release();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 
 using namespace pyimmutable;
@@ -189,10 +480,27 @@ PyMethodDef ImmutableList_methods[] = {
     _PYIMMUTABLE_IMMUTABLELIST___REVERSED___METHODDEF
     _PYIMMUTABLE_IMMUTABLELIST__GET_INSTANCE_COUNT_METHODDEF
     _PYIMMUTABLE_IMMUTABLELIST_APPEND_METHODDEF
+    _PYIMMUTABLE_IMMUTABLELIST_APPLY_PATCH_METHODDEF
     _PYIMMUTABLE_IMMUTABLELIST_COUNT_METHODDEF
+    _PYIMMUTABLE_IMMUTABLELIST_DEEP_DIFF_METHODDEF
+    _PYIMMUTABLE_IMMUTABLELIST_DELETE_METHODDEF
+    _PYIMMUTABLE_IMMUTABLELIST_DIFF_METHODDEF
+    _PYIMMUTABLE_IMMUTABLELIST_DISCARD_IN_METHODDEF
+    _PYIMMUTABLE_IMMUTABLELIST_DROP_METHODDEF
+    _PYIMMUTABLE_IMMUTABLELIST_EVOLVER_METHODDEF
     _PYIMMUTABLE_IMMUTABLELIST_EXTEND_METHODDEF
+    _PYIMMUTABLE_IMMUTABLELIST_GET_IN_METHODDEF
     _PYIMMUTABLE_IMMUTABLELIST_INDEX_METHODDEF
+    _PYIMMUTABLE_IMMUTABLELIST_INSERT_METHODDEF
     _PYIMMUTABLE_IMMUTABLELIST_SET_METHODDEF
+    _PYIMMUTABLE_IMMUTABLELIST_SET_IN_METHODDEF
+    _PYIMMUTABLE_IMMUTABLELIST_SPLICE_METHODDEF
+    _PYIMMUTABLE_IMMUTABLELIST_UPDATE_IN_METHODDEF
+    {"__sizeof__",
+     ImmutableList::Wrapper::method<&ImmutableList::sizeOf>(),
+     METH_NOARGS,
+     docstring_ImmutableList___sizeof__
+   },
     {nullptr}};
 // clang-format on
 
@@ -211,6 +519,11 @@ PyMappingMethods ImmutableList_mappingMethods = {
 };
 
 PyGetSetDef ImmutableList_getset[] = {
+    {"digest",
+     ImmutableList::Wrapper::method<&ImmutableList::digestBytes>(),
+     nullptr,
+     docstring_ImmutableList_digest,
+     nullptr},
     {"isImmutableJson",
      ImmutableList::Wrapper::method<&ImmutableList::isImmutableJsonList>(),
      nullptr,
@@ -223,10 +536,226 @@ PyGetSetDef ImmutableList_getset[] = {
      nullptr},
     {nullptr}};
 
+// clang-format off
+PyMethodDef ImmutableListEvolver_methods[] = {
+    {"append",
+     ImmutableListEvolver::Wrapper::method<&ImmutableListEvolver::append>(),
+     METH_O,
+     docstring_ImmutableListEvolver_append
+   },
+    {"extend",
+     ImmutableListEvolver::Wrapper::method<&ImmutableListEvolver::extend>(),
+     METH_O,
+     docstring_ImmutableListEvolver_extend
+   },
+    {"persistent",
+     ImmutableListEvolver::Wrapper::method<&ImmutableListEvolver::persistent>(),
+     METH_NOARGS,
+     docstring_ImmutableListEvolver_persistent
+   },
+    {"set",
+     ImmutableListEvolver::Wrapper::method<&ImmutableListEvolver::set>(),
+     METH_VARARGS,
+     docstring_ImmutableListEvolver_set
+   },
+    {nullptr}};
+// clang-format on
+
+PySequenceMethods ImmutableListEvolver_sequenceMethods = {
+    .sq_length =
+        ImmutableListEvolver::Wrapper::method<&ImmutableListEvolver::len>(),
+    .sq_item =
+        ImmutableListEvolver::Wrapper::method<&ImmutableListEvolver::getItem>(),
+    .sq_ass_item =
+        ImmutableListEvolver::Wrapper::method<&ImmutableListEvolver::setItem>(),
+};
+
 } // namespace
 
 namespace pyimmutable {
 
+PyObjectRef makeImmutableList(PyObjectRef* values, std::size_t count) {
+  return ImmutableList::fromValues(values, count);
+}
+
+bool writeImmutableListJson(std::string& out, PyObject* obj, bool cache) {
+  return ImmutableList::Wrapper::cast(obj)->writeJson(out, cache);
+}
+
+bool writeImmutableListBinary(BinaryWriter& writer, PyObject* obj) {
+  auto const& vec = ImmutableList::Wrapper::cast(obj)->vec;
+  writer.writeTag(binary_tag::kList);
+  writer.writeSize(vec.size());
+  for (auto const& item : vec) {
+    if (!writer.write(item.value.get())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+PyObject* immutableListLookUp(PyObject* list, Py_ssize_t& idx) {
+  auto const& vec = ImmutableList::Wrapper::cast(list)->vec;
+  if (idx < 0) {
+    idx += vec.size();
+  }
+  if (idx < 0 or idx >= static_cast<Py_ssize_t>(vec.size())) {
+    return nullptr;
+  }
+  return vec[idx].value.get();
+}
+
+PyObjectRef immutableListSet(PyObject* list, Py_ssize_t idx, PyObject* value) {
+  return ImmutableList::Wrapper::cast(list)->set(idx, value);
+}
+
+PyObjectRef immutableListDelete(PyObject* list, Py_ssize_t idx) {
+  return ImmutableList::Wrapper::cast(list)->delete_(idx);
+}
+
+PyObjectRef newImmutableListEvolver(PyObject* list) {
+  return ImmutableList::Wrapper::cast(list)->evolver();
+}
+
+Py_ssize_t immutableListEvolverLength(PyObject* evolver) {
+  return ImmutableListEvolver::Wrapper::cast(evolver)->len();
+}
+
+PyObject* immutableListEvolverLookUp(PyObject* evolver, Py_ssize_t idx) {
+  return ImmutableListEvolver::Wrapper::cast(evolver)->vec_[idx].value.get();
+}
+
+bool immutableListEvolverSet(
+    PyObject* evolver,
+    Py_ssize_t idx,
+    PyObject* value) {
+  return ImmutableListEvolver::Wrapper::cast(evolver)->setItem(idx, value) == 0;
+}
+
+bool immutableListEvolverInsert(
+    PyObject* evolver,
+    Py_ssize_t idx,
+    PyObject* value) {
+  return ImmutableListEvolver::Wrapper::cast(evolver)->insert(idx, value);
+}
+
+bool immutableListEvolverDelete(PyObject* evolver, Py_ssize_t idx) {
+  return ImmutableListEvolver::Wrapper::cast(evolver)->delete_(idx);
+}
+
+PyObjectRef immutableListEvolverPersistent(PyObject* evolver) {
+  return ImmutableListEvolver::Wrapper::cast(evolver)->persistent(nullptr);
+}
+
+bool forEachImmutableListItem(
+    PyObject* list,
+    std::function<bool(PyObject*)> const& callback) {
+  for (auto const& item : ImmutableList::Wrapper::cast(list)->vec) {
+    if (!callback(item.value.get())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+namespace {
+
+// Walks the leaf chunks of a vector, as visited by immer::for_each_chunk.
+// Chunks that two versions of a list share have the same address.
+class ChunkCursor {
+ public:
+  explicit ChunkCursor(VectorType const& vec) {
+    immer::for_each_chunk(
+        vec, [&](ListItem const* first, ListItem const* last) {
+          if (first != last) {
+            chunks_.emplace_back(first, last);
+          }
+        });
+    if (!chunks_.empty()) {
+      pos_ = chunks_.front().first;
+    }
+  }
+
+  ListItem const* get() const {
+    return pos_;
+  }
+
+  // Number of items left in the current chunk
+  std::size_t available() const {
+    return chunks_[chunk_].second - pos_;
+  }
+
+  void advance(std::size_t n) {
+    pos_ += n;
+    if (pos_ == chunks_[chunk_].second && ++chunk_ < chunks_.size()) {
+      pos_ = chunks_[chunk_].first;
+    }
+  }
+
+ private:
+  std::vector<std::pair<ListItem const*, ListItem const*>> chunks_;
+  std::size_t chunk_{0};
+  ListItem const* pos_{nullptr};
+};
+
+} // namespace
+
+bool diffImmutableLists(
+    PyObject* a,
+    PyObject* b,
+    DiffCallback const& callback) {
+  auto const& old_vec = ImmutableList::Wrapper::cast(a)->vec;
+  auto const& new_vec = ImmutableList::Wrapper::cast(b)->vec;
+  auto const report =
+      [&](std::size_t idx, PyObject* old_value, PyObject* new_value) {
+        PyObjectRef key{PyLong_FromSize_t(idx), false};
+        return key && callback(key.get(), old_value, new_value);
+      };
+
+  if (old_vec.identity_equal(new_vec)) {
+    return true;
+  }
+
+  // Runs of items at the same address lie in a chunk shared by both lists,
+  // and are skipped without comparing them.
+  std::size_t const common = std::min(old_vec.size(), new_vec.size());
+  ChunkCursor old_it{old_vec};
+  ChunkCursor new_it{new_vec};
+  for (std::size_t idx = 0; idx < common;) {
+    std::size_t const run = std::min(
+        {old_it.available(), new_it.available(), common - idx});
+    if (old_it.get() != new_it.get()) {
+      for (std::size_t i = 0; i < run; ++i) {
+        ListItem const& old_item = old_it.get()[i];
+        ListItem const& new_item = new_it.get()[i];
+        if (old_item.valueHash != new_item.valueHash &&
+            !report(idx + i, old_item.value.get(), new_item.value.get())) {
+          return false;
+        }
+      }
+    }
+    idx += run;
+    old_it.advance(run);
+    new_it.advance(run);
+  }
+  for (std::size_t idx = common; idx < new_vec.size(); ++idx) {
+    if (!report(idx, nullptr, new_it.get()->value.get())) {
+      return false;
+    }
+    new_it.advance(1);
+  }
+  for (std::size_t idx = old_vec.size(); idx-- > common;) {
+    if (!report(idx, old_vec[idx].value.get(), nullptr)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Sha1Hash const& immutableListSha1(PyObject* list) {
+  return ImmutableList::Wrapper::cast(list)->sha1;
+}
+
 bool isImmutableJsonList(PyObject* obj) {
   return ImmutableList::Wrapper::cast(obj)->isImmutableJson;
 }
@@ -264,4 +793,17 @@ PyTypeObject* getImmutableListIterTypeObject() {
   return ImmutableListIter::Wrapper::initType();
 }
 
+template <>
+PyTypeObject ImmutableListEvolver::Wrapper::typeObject = {
+    PyVarObject_HEAD_INIT(nullptr, 0) //
+        .tp_name = "ImmutableListEvolver",
+    .tp_as_sequence = &ImmutableListEvolver_sequenceMethods,
+    .tp_doc = docstring_ImmutableListEvolver,
+    .tp_methods = ImmutableListEvolver_methods,
+    .tp_new = &disallow_construction,
+};
+PyTypeObject* getImmutableListEvolverTypeObject() {
+  return ImmutableListEvolver::Wrapper::initType();
+}
+
 } // namespace pyimmutable
@@ -24,14 +24,70 @@
 
 #pragma once
 
+#include <cstddef>
+#include <functional>
+#include <string>
+
 #include <Python.h>
 
+#include "Diff.h"
+#include "PyObjectRef.h"
+#include "Sha1Hash.h"
+
 namespace pyimmutable {
 
+class BinaryWriter;
+
 PyTypeObject* getImmutableListTypeObject();
 extern PyTypeObject* immutableListTypeObject;
 PyTypeObject* getImmutableListIterTypeObject();
+PyTypeObject* getImmutableListEvolverTypeObject();
+
+// Returns the ImmutableList with the given values, moving from them.
+PyObjectRef makeImmutableList(PyObjectRef* values, std::size_t count);
+
+// Returns item `idx` of `list` as a borrowed reference, or nullptr if `idx` is
+// out of range. A negative `idx` counts from the end of the list, and is
+// replaced by the corresponding non-negative index.
+PyObject* immutableListLookUp(PyObject* list, Py_ssize_t& idx);
+
+PyObjectRef immutableListSet(PyObject* list, Py_ssize_t idx, PyObject* value);
+PyObjectRef immutableListDelete(PyObject* list, Py_ssize_t idx);
+
+// Batched modification of `list` through an ImmutableListEvolver, which
+// interns only the final version. Indices must be non-negative, and must be in
+// range, except for insertion, where `idx` may be the length of the list.
+PyObjectRef newImmutableListEvolver(PyObject* list);
+Py_ssize_t immutableListEvolverLength(PyObject* evolver);
+PyObject* immutableListEvolverLookUp(PyObject* evolver, Py_ssize_t idx);
+bool immutableListEvolverSet(
+    PyObject* evolver,
+    Py_ssize_t idx,
+    PyObject* value);
+bool immutableListEvolverInsert(
+    PyObject* evolver,
+    Py_ssize_t idx,
+    PyObject* value);
+bool immutableListEvolverDelete(PyObject* evolver, Py_ssize_t idx);
+PyObjectRef immutableListEvolverPersistent(PyObject* evolver);
+
+// Calls `callback` with each element of `list`, in order. Stops and returns
+// false as soon as `callback` does.
+bool forEachImmutableListItem(
+    PyObject* list,
+    std::function<bool(PyObject*)> const& callback);
+
+// Calls `callback` for every index at which `a` and `b` hold different values.
+// Indices past the end of the shorter list are reported as added (in
+// ascending order) or removed (in descending order, after all other
+// differences), so that applying the differences in order turns `a` into `b`.
+bool diffImmutableLists(PyObject* a, PyObject* b, DiffCallback const& callback);
+
+// Returns the content hash of `list`.
+Sha1Hash const& immutableListSha1(PyObject* list);
 
 bool isImmutableJsonList(PyObject*);
+bool writeImmutableListJson(std::string& out, PyObject*, bool cache);
+bool writeImmutableListBinary(BinaryWriter& writer, PyObject*);
 
 } // namespace pyimmutable
@@ -24,15 +24,20 @@
 
 #include "ImmutableList.h"
 
+#include <array>
 #include <cstddef>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
-#include <immer/vector.hpp>
-#include <immer/vector_transient.hpp>
+#include <immer/flex_vector.hpp>
+#include <immer/flex_vector_transient.hpp>
 
 #include "ClassWrapper.h"
+#include "Json.h"
+#include "ListDigest.h"
+#include "MemoryPolicy.h"
 #include "PyObjectRef.h"
 #include "Sha1Hasher.h"
 #include "util.h"
@@ -41,15 +46,24 @@ namespace pyimmutable {
 
 namespace {
 
+// The isImmutableJson flag is kept in the tag bit of the value reference, so
+// that an item is no larger than its digest and one pointer.
 struct ListItem {
-  PyObjectRef value;
-  Sha1Hash valueHash;
-  Sha1Hash itemHash;
-  bool isImmutableJson;
+  Sha1Hash valueHash{};
+  TaggedPyObjectRef value;
+
+  ListItem() = default;
+  ListItem(PyObjectRef value, Sha1Hash const& valueHash, bool isImmutableJson)
+      : valueHash(valueHash), value(std::move(value), isImmutableJson) {}
+
+  bool isImmutableJson() const {
+    return value.flag();
+  }
 };
+static_assert(sizeof(ListItem) == sizeof(Sha1Hash) + sizeof(PyObject*));
 
-using VectorType = immer::vector<ListItem>;
-using TransientVectorType = immer::vector_transient<ListItem>;
+using VectorType = immer::flex_vector<ListItem, MemoryPolicy>;
+using TransientVectorType = VectorType::transient_type;
 
 struct ImmutableListIter {
   using Wrapper = ClassWrapper<ImmutableListIter>;
@@ -84,20 +98,116 @@ struct ImmutableList {
   static constexpr bool sha1_lookup_enabled = true;
 
   VectorType vec;
+  ListDigest const digest;
   Sha1Hash const sha1;
   std::size_t const immutableJsonItems;
   bool const isImmutableJson;
   PyObjectRef meta_;
+  std::unique_ptr<std::string const> jsonFragment_;
 
   ImmutableList(
       VectorType&& vecx,
+      ListDigest const& digest,
       Sha1Hash sha1,
       std::size_t immutable_json_items)
       : vec(std::move(vecx)),
+        digest(digest),
         sha1(sha1),
         immutableJsonItems(immutable_json_items),
         isImmutableJson(immutableJsonItems == vec.size()) {}
 
+  // Returns the list with the given digest and length, calling `make_vec` to
+  // create its elements only if no such list exists yet.
+  template <typename MakeVec>
+  static auto intern(
+      ListDigest const& digest,
+      std::size_t size,
+      std::size_t immutable_json_items,
+      MakeVec&& make_vec) {
+    auto const hash = digest.final(size);
+    return Wrapper::getOrCreate(hash, [&]() {
+      return ImmutableList{make_vec(), digest, hash, immutable_json_items};
+    });
+  }
+
+  // Digest and number of JSON items of a range of elements.
+  struct Range {
+    ListDigest digest;
+    std::size_t immutableJsonItems{0};
+  };
+
+  // The elements in [begin, end) of `vec`, at their current positions.
+  static Range range(
+      VectorType const& vec,
+      std::size_t begin,
+      std::size_t end) {
+    Range result;
+    ListDigest::Accumulator acc{begin};
+    for (auto it = vec.begin() + begin; begin < end; ++begin, ++it) {
+      acc.add(it->valueHash);
+      if (it->isImmutableJson()) {
+        ++result.immutableJsonItems;
+      }
+    }
+    result.digest = acc.digest();
+    return result;
+  }
+
+  // Same as range(vec, begin, end), but iterating over the shorter of the
+  // range itself and the rest of `vec`, whose elements together are `all`.
+  static Range shortRange(
+      VectorType const& vec,
+      Range const& all,
+      std::size_t begin,
+      std::size_t end) {
+    if (end - begin <= vec.size() / 2) {
+      return range(vec, begin, end);
+    }
+
+    Range result = all;
+    for (auto const& outside :
+         {range(vec, 0, begin), range(vec, end, vec.size())}) {
+      result.digest -= outside.digest;
+      result.immutableJsonItems -= outside.immutableJsonItems;
+    }
+    return result;
+  }
+
+  Range shortRange(std::size_t begin, std::size_t end) const {
+    return shortRange(vec, Range{digest, immutableJsonItems}, begin, end);
+  }
+
+  // The digest of `vec` (whose digest is `digest`) after inserting an element
+  // with hash `hvalue` at `idx`.
+  static ListDigest digestAfterInsert(
+      VectorType const& vec,
+      ListDigest const& digest,
+      std::size_t idx,
+      Sha1Hash const& hvalue) {
+    auto const head = shortRange(vec, Range{digest}, 0, idx);
+    auto tail = digest;
+    tail -= head.digest;
+    auto new_digest = head.digest;
+    new_digest += ListDigest::element(hvalue, idx);
+    new_digest += tail.shifted(1);
+    return new_digest;
+  }
+
+  // The digest of `vec` (whose digest is `digest`) after deleting the element
+  // at `idx`.
+  static ListDigest digestAfterDelete(
+      VectorType const& vec,
+      ListDigest const& digest,
+      std::size_t idx) {
+    auto const head = shortRange(vec, Range{digest}, 0, idx);
+    auto tail = digest;
+    tail -= head.digest;
+    tail -= ListDigest::element(vec[idx].valueHash, idx);
+    auto new_digest = head.digest;
+    new_digest += tail.unshifted(1);
+    return new_digest;
+  }
+
   PyObjectRef getItemIdx(Py_ssize_t idx) noexcept {
     Py_ssize_t const len = vec.size();
 
@@ -147,53 +257,36 @@ struct ImmutableList {
       return makeEmpty();
     }
 
-    if (start == 0 && step == 1) {
+    std::size_t immutable_json_items = 0;
+
+    if (step == 1) {
       if (length >= static_cast<Py_ssize_t>(vec.size())) {
         return TypedPyObjectRef{Wrapper::cast(this)};
       }
 
-      Sha1Hash hash{0};
-      std::size_t immutable_json_items = 0;
-      for (auto it = vec.begin(); start < stop; ++start, ++it) {
-        xorHashInPlace(hash, it->itemHash);
-        if (it->isImmutableJson) {
-          ++immutable_json_items;
-        }
-      }
-
-      return Wrapper::getOrCreate(hash, [&]() {
-        return ImmutableList{vec.take(length), hash, immutable_json_items};
-      });
+      auto const slice = shortRange(start, stop);
+      return intern(
+          slice.digest.unshifted(start),
+          length,
+          slice.immutableJsonItems,
+          [&]() { return vec.drop(start).take(length); });
     }
 
-    Sha1Hash hash{0};
-    std::size_t immutable_json_items = 0;
-    std::vector<Sha1Hash> item_hashes;
-    item_hashes.reserve(length);
-
+    ListDigest::Accumulator acc{0};
     for (Py_ssize_t i = 0; i < length; ++i) {
       auto const& src_item = vec[start + i * step];
-      auto item_hash = itemHash(src_item.valueHash, i);
-      item_hashes.push_back(item_hash);
-      xorHashInPlace(hash, item_hash);
-      if (src_item.isImmutableJson) {
+      acc.add(src_item.valueHash);
+      if (src_item.isImmutableJson()) {
         ++immutable_json_items;
       }
     }
 
-    return Wrapper::getOrCreate(hash, [&]() {
+    return intern(acc.digest(), length, immutable_json_items, [&]() {
       TransientVectorType tvec;
       for (Py_ssize_t i = 0; i < length; ++i) {
-        auto const& src_item = vec[start + i * step];
-        auto const& item_hash = item_hashes[i];
-        tvec.push_back(ListItem{src_item.value,
-                                src_item.valueHash,
-                                item_hash,
-                                src_item.isImmutableJson});
+        tvec.push_back(vec[start + i * step]);
       }
-
-      return ImmutableList{
-          std::move(tvec).persistent(), hash, immutable_json_items};
+      return std::move(tvec).persistent();
     });
   }
 
@@ -213,40 +306,117 @@ struct ImmutableList {
       return TypedPyObjectRef{Wrapper::cast(this)};
     }
 
-    auto const hitem = itemHash(hvalue, idx);
-    auto const vec_hash = xorHash(xorHash(sha1, src_item.itemHash), hitem);
+    auto new_digest = digest;
+    new_digest -= ListDigest::element(src_item.valueHash, idx);
+    new_digest += ListDigest::element(hvalue, idx);
     bool const is_immutable_json = isImmutableJsonObject(value);
     auto const immutable_json_items = immutableJsonItems -
-        (src_item.isImmutableJson ? 1 : 0) + (is_immutable_json ? 1 : 0);
-
-    return Wrapper::getOrCreate(vec_hash, [&]() {
-      return ImmutableList{
-          vec.set(
-              idx,
-              ListItem{
-                  PyObjectRef{value}, hvalue, hitem, immutable_json_items}),
-          vec_hash,
-          immutable_json_items};
+        (src_item.isImmutableJson() ? 1 : 0) + (is_immutable_json ? 1 : 0);
+
+    return intern(new_digest, vec.size(), immutable_json_items, [&]() {
+      return vec.set(
+          idx, ListItem{PyObjectRef{value}, hvalue, is_immutable_json});
     });
   }
 
   auto append(PyObject* value) noexcept {
     auto const hvalue = valueHash(value);
-    auto const hitem = itemHash(hvalue, vec.size());
-    auto vec_hash = xorHash(sha1, hitem);
+    auto new_digest = digest;
+    new_digest += ListDigest::element(hvalue, vec.size());
+    bool const is_immutable_json = isImmutableJsonObject(value);
+    auto const immutable_json_items =
+        immutableJsonItems + (is_immutable_json ? 1 : 0);
+
+    return intern(new_digest, vec.size() + 1, immutable_json_items, [&]() {
+      return vec.push_back(
+          ListItem{PyObjectRef{value}, hvalue, is_immutable_json});
+    });
+  }
+
+  PyObjectRef insert(Py_ssize_t idx, PyObject* value) noexcept {
+    Py_ssize_t const len = vec.size();
+    if (idx < 0) {
+      idx = std::max<Py_ssize_t>(idx + len, 0);
+    }
+    idx = std::min(idx, len);
+
+    auto const hvalue = valueHash(value);
+    auto const new_digest = digestAfterInsert(vec, digest, idx, hvalue);
     bool const is_immutable_json = isImmutableJsonObject(value);
     auto const immutable_json_items =
         immutableJsonItems + (is_immutable_json ? 1 : 0);
 
-    return Wrapper::getOrCreate(vec_hash, [&]() {
-      return ImmutableList{
-          vec.push_back(
-              ListItem{PyObjectRef{value}, hvalue, hitem, is_immutable_json}),
-          vec_hash,
-          immutable_json_items};
+    return intern(new_digest, vec.size() + 1, immutable_json_items, [&]() {
+      return vec.insert(
+          idx, ListItem{PyObjectRef{value}, hvalue, is_immutable_json});
     });
   }
 
+  PyObjectRef delete_(Py_ssize_t idx) noexcept {
+    if (idx < 0) {
+      idx += vec.size();
+    }
+    if (idx < 0 or idx >= static_cast<Py_ssize_t>(vec.size())) {
+      PyErr_SetNone(PyExc_IndexError);
+      return nullptr;
+    }
+
+    auto const new_digest = digestAfterDelete(vec, digest, idx);
+    auto const immutable_json_items =
+        immutableJsonItems - (vec[idx].isImmutableJson() ? 1 : 0);
+
+    return intern(new_digest, vec.size() - 1, immutable_json_items, [&]() {
+      return vec.erase(idx);
+    });
+  }
+
+  PyObjectRef drop(Py_ssize_t count) noexcept {
+    if (count < 0) {
+      PyErr_SetString(PyExc_ValueError, "count must not be negative");
+      return nullptr;
+    }
+    return makeSlice(count, PY_SSIZE_T_MAX, 1);
+  }
+
+  PyObjectRef splice(Py_ssize_t start, Py_ssize_t stop, PyObject* iterable) {
+    PySlice_AdjustIndices(vec.size(), &start, &stop, 1);
+    stop = std::max(start, stop);
+
+    ListDigest inserted_digest;
+    std::size_t inserted_json_items = 0;
+    VectorType inserted;
+    if (Py_TYPE(iterable) == immutableListTypeObject) {
+      // no need to compute value hashes of an ImmutableList
+      ImmutableList const& other = *Wrapper::cast(iterable);
+      inserted_digest = other.digest;
+      inserted_json_items = other.immutableJsonItems;
+      inserted = other.vec;
+    } else {
+      TransientVectorType tvec;
+      if (!extendCommon(inserted_digest, inserted_json_items, tvec, iterable)) {
+        return nullptr;
+      }
+      inserted = std::move(tvec).persistent();
+    }
+
+    auto const head = shortRange(0, start);
+    auto const tail = shortRange(stop, vec.size());
+    std::size_t const new_stop = start + inserted.size();
+    auto new_digest = head.digest;
+    new_digest += inserted_digest.shifted(start);
+    new_digest += new_stop >= static_cast<std::size_t>(stop)
+        ? tail.digest.shifted(new_stop - stop)
+        : tail.digest.unshifted(stop - new_stop);
+    auto const immutable_json_items = head.immutableJsonItems +
+        inserted_json_items + tail.immutableJsonItems;
+
+    return intern(
+        new_digest,
+        vec.size() - (stop - start) + inserted.size(),
+        immutable_json_items,
+        [&]() { return vec.take(start) + inserted + vec.drop(stop); });
+  }
+
   PyObjectRef count(PyObject* value) noexcept {
     std::size_t count = 0;
 
@@ -297,6 +467,13 @@ struct ImmutableList {
     return vec.size();
   }
 
+  PyObjectRef sizeOf(PyObject* /* unused */) {
+    return PyObjectRef{
+        PyLong_FromSize_t(
+            sizeof(Wrapper) + vec.size() * sizeof(VectorType::value_type)),
+        false};
+  }
+
   PyObjectRef concat(PyObject* rhs_ptr) {
     if (Py_TYPE(rhs_ptr) != immutableListTypeObject) {
       PyErr_Format(
@@ -316,31 +493,19 @@ struct ImmutableList {
     if (vec.empty()) {
       return PyObjectRef{rhs_ptr};
     }
-
-    Py_ssize_t idx = vec.size();
-    Sha1Hash hash = sha1;
-    std::vector<Sha1Hash> item_hashes;
-    item_hashes.reserve(rhs.vec.size());
-
-    for (auto const& item : rhs.vec) {
-      auto hitem = itemHash(item.valueHash, idx++);
-      item_hashes.push_back(hitem);
-      xorHashInPlace(hash, hitem);
+    if (vec.size() > PY_SSIZE_T_MAX - rhs.vec.size()) {
+      PyErr_NoMemory();
+      return nullptr;
     }
 
-    return Wrapper::getOrCreate(hash, [&]() {
-      auto tvec = vec.transient();
-
-      auto it = item_hashes.begin();
-      for (auto const& item : rhs.vec) {
-        tvec.push_back(
-            ListItem{item.value, item.valueHash, *it++, item.isImmutableJson});
-      }
+    auto new_digest = digest;
+    new_digest += rhs.digest.shifted(vec.size());
 
-      return ImmutableList{std::move(tvec).persistent(),
-                           hash,
-                           immutableJsonItems + rhs.immutableJsonItems};
-    });
+    return intern(
+        new_digest,
+        vec.size() + rhs.vec.size(),
+        immutableJsonItems + rhs.immutableJsonItems,
+        [&]() { return vec + rhs.vec; });
   }
 
   PyObjectRef repeat(Py_ssize_t count) {
@@ -350,34 +515,29 @@ struct ImmutableList {
     if (count == 1) {
       return TypedPyObjectRef{Wrapper::cast(this)};
     }
-
-    Py_ssize_t idx = vec.size();
-    Sha1Hash hash = sha1;
-    std::vector<Sha1Hash> item_hashes;
-    item_hashes.reserve(idx * (count - 1));
-
-    for (Py_ssize_t c = 1; c < count; ++c) {
-      for (auto const& item : vec) {
-        auto hitem = itemHash(item.valueHash, idx++);
-        item_hashes.push_back(hitem);
-        xorHashInPlace(hash, hitem);
-      }
+    // list raises MemoryError for lengths that do not fit in a Py_ssize_t
+    if (static_cast<std::size_t>(count) > PY_SSIZE_T_MAX / vec.size()) {
+      PyErr_NoMemory();
+      return nullptr;
     }
 
-    return Wrapper::getOrCreate(hash, [&]() {
-      auto tvec = vec.transient();
-
-      auto it = item_hashes.begin();
-      for (Py_ssize_t c = 1; c < count; ++c) {
-        for (auto const& item : vec) {
-          tvec.push_back(ListItem{
-              item.value, item.valueHash, *it++, item.isImmutableJson});
-        }
-      }
-
-      return ImmutableList{
-          std::move(tvec).persistent(), hash, immutableJsonItems * count};
-    });
+    return intern(
+        digest.repeated(vec.size(), count),
+        vec.size() * count,
+        immutableJsonItems * count,
+        [&]() {
+          // concatenate by repeated doubling, sharing structure
+          VectorType result;
+          VectorType power = vec;
+          for (auto c = count;; power = power + power) {
+            if (c & 1) {
+              result = result + power;
+            }
+            if (!(c >>= 1)) {
+              return result;
+            }
+          }
+        });
   }
 
   auto iterImpl(bool reversed) {
@@ -447,6 +607,41 @@ struct ImmutableList {
     return PyObjectRef(isImmutableJson ? Py_True : Py_False);
   }
 
+  bool writeJson(std::string& out, bool cache) {
+    if (jsonFragment_) {
+      out += *jsonFragment_;
+      return true;
+    }
+
+    std::size_t const begin = out.size();
+    out += '[';
+    bool first = true;
+    for (auto const& item : vec) {
+      if (!first) {
+        out += ", ";
+      }
+      first = false;
+      if (!pyimmutable::writeJson(out, item.value.get(), cache)) {
+        return false;
+      }
+    }
+    out += ']';
+
+    if (cache && isImmutableJson) {
+      jsonFragment_ = std::make_unique<std::string const>(out, begin);
+    }
+    return true;
+  }
+
+  PyObjectRef evolver();
+
+  PyObjectRef digestBytes(void* /* unused */) {
+    return PyObjectRef{
+        PyBytes_FromStringAndSize(
+            reinterpret_cast<char const*>(sha1.data()), sha1.size()),
+        false};
+  }
+
   PyObjectRef meta(void* /* unused */) {
     if (!meta_) {
       meta_ = PyObjectRef{PyDict_New(), false};
@@ -455,11 +650,11 @@ struct ImmutableList {
   }
 
   static PyObjectRef makeEmpty() {
-    return Wrapper::getOrCreate({}, []() { return ImmutableList({}, {}, 0); });
+    return intern({}, 0, 0, []() { return VectorType{}; });
   }
 
   static PyObjectRef new_(PyTypeObject* type, PyObject* args, PyObject* kwds) {
-    if (!_PyArg_NoKeywords("ImmutableList", kwds)) {
+    if (!noKeywords("ImmutableList", kwds)) {
       return nullptr;
     }
 
@@ -469,15 +664,14 @@ struct ImmutableList {
     }
 
     if (arg) {
-      Sha1Hash vec_hash{0};
+      ListDigest new_digest;
       std::size_t immutable_json_items = 0;
       TransientVectorType tvec;
-      if (!extendCommon(vec_hash, immutable_json_items, tvec, arg)) {
+      if (!extendCommon(new_digest, immutable_json_items, tvec, arg)) {
         return nullptr;
       }
-      return Wrapper::getOrCreate(vec_hash, [&]() {
-        return ImmutableList{
-            std::move(tvec).persistent(), vec_hash, immutable_json_items};
+      return intern(new_digest, tvec.size(), immutable_json_items, [&]() {
+        return std::move(tvec).persistent();
       });
     } else {
       return makeEmpty();
@@ -491,20 +685,19 @@ struct ImmutableList {
       return concat(seq);
     }
 
-    auto vec_hash = sha1;
+    auto new_digest = digest;
     auto immutable_json_items = immutableJsonItems;
     auto tvec = vec.transient();
-    if (!extendCommon(vec_hash, immutable_json_items, tvec, seq)) {
+    if (!extendCommon(new_digest, immutable_json_items, tvec, seq)) {
       return nullptr;
     }
-    return Wrapper::getOrCreate(vec_hash, [&]() {
-      return ImmutableList{
-          std::move(tvec).persistent(), vec_hash, immutable_json_items};
+    return intern(new_digest, tvec.size(), immutable_json_items, [&]() {
+      return std::move(tvec).persistent();
     });
   }
 
   static bool extendCommon(
-      Sha1Hash& hash,
+      ListDigest& digest,
       std::size_t& immutable_json_items,
       TransientVectorType& tvec,
       PyObject* arg) {
@@ -513,22 +706,243 @@ struct ImmutableList {
       return false;
     }
 
+    std::vector<PyObjectRef> values;
+    values.reserve(kHashBatchSize);
+
+    auto flush = [&]() {
+      appendValues(
+          digest, immutable_json_items, tvec, values.data(), values.size());
+      values.clear();
+    };
+
     while (auto value = PyObjectRef{PyIter_Next(iter.get()), false}) {
-      auto const hvalue = valueHash(value.get());
-      auto const hitem = itemHash(hvalue, tvec.size());
-      xorHashInPlace(hash, hitem);
-      auto is_immutable_json = isImmutableJsonObject(value.get());
-      if (is_immutable_json) {
-        ++immutable_json_items;
+      values.push_back(std::move(value));
+      if (values.size() == kHashBatchSize) {
+        flush();
+      }
+    }
+
+    if (PyErr_Occurred()) {
+      return false;
+    }
+    flush();
+    return true;
+  }
+
+  // Appends `count` values to `tvec`, moving from them. Value hashes are
+  // computed in batches of kHashBatchSize.
+  static void appendValues(
+      ListDigest& digest,
+      std::size_t& immutable_json_items,
+      TransientVectorType& tvec,
+      PyObjectRef* values,
+      std::size_t count) {
+    std::array<Sha1Hash, kHashBatchSize> value_hashes;
+    std::array<std::size_t, kHashBatchSize> unhashed;
+    ListDigest::Accumulator acc{tvec.size()};
+
+    for (std::size_t begin = 0; begin < count; begin += kHashBatchSize) {
+      PyObjectRef* const batch = values + begin;
+      std::size_t const n = std::min(kHashBatchSize, count - begin);
+
+      std::size_t unhashed_count = 0;
+      for (std::size_t i = 0; i < n; ++i) {
+        if (auto const* const h = PrecomputedHashes::find(batch[i].get())) {
+          value_hashes[i] = *h;
+        } else {
+          unhashed[unhashed_count++] = i;
+        }
+      }
+      hashMany(
+          unhashed_count,
+          [&](Sha1Hasher& hasher, std::size_t i) {
+            hasher(batch[unhashed[i]].get());
+          },
+          [&](std::size_t i, Sha1Hash const& hvalue) {
+            value_hashes[unhashed[i]] = hvalue;
+          });
+
+      for (std::size_t i = 0; i < n; ++i) {
+        acc.add(value_hashes[i]);
+        auto is_immutable_json = isImmutableJsonObject(batch[i].get());
+        if (is_immutable_json) {
+          ++immutable_json_items;
+        }
+        tvec.push_back(ListItem{
+            std::move(batch[i]), value_hashes[i], is_immutable_json});
+      }
+    }
+    digest += acc.digest();
+  }
+
+  static PyObjectRef fromValues(PyObjectRef* values, std::size_t count) {
+    ListDigest new_digest;
+    std::size_t immutable_json_items = 0;
+    TransientVectorType tvec;
+    appendValues(new_digest, immutable_json_items, tvec, values, count);
+    return intern(new_digest, count, immutable_json_items, [&]() {
+      return std::move(tvec).persistent();
+    });
+  }
+};
+
+// A mutable copy of an ImmutableList, for applying a batch of changes without
+// creating (and interning) an ImmutableList for each intermediate state.
+struct ImmutableListEvolver {
+  using Wrapper = ClassWrapper<ImmutableListEvolver>;
+
+  TransientVectorType vec_;
+  ListDigest digest_;
+  std::size_t immutableJsonItems_;
+
+  explicit ImmutableListEvolver(ImmutableList const& list)
+      : vec_(list.vec.transient()),
+        digest_(list.digest),
+        immutableJsonItems_(list.immutableJsonItems) {}
+
+  PyObjectRef self() {
+    return TypedPyObjectRef{Wrapper::cast(this)};
+  }
+
+  // Negative indices have been adjusted already by the sequence protocol.
+  bool checkIndex(Py_ssize_t idx) {
+    if (idx < 0 or idx >= static_cast<Py_ssize_t>(vec_.size())) {
+      PyErr_SetNone(PyExc_IndexError);
+      return false;
+    }
+    return true;
+  }
+
+  PyObjectRef getItem(Py_ssize_t idx) noexcept {
+    if (!checkIndex(idx)) {
+      return nullptr;
+    }
+    return vec_[idx].value.copy();
+  }
+
+  int setItem(Py_ssize_t idx, PyObject* value) noexcept {
+    if (!value) {
+      PyErr_SetString(
+          PyExc_TypeError, "ImmutableListEvolver does not support deletion");
+      return -1;
+    }
+    if (!checkIndex(idx)) {
+      return -1;
+    }
+
+    auto const& src_item = vec_[idx];
+    auto const hvalue = valueHash(value);
+    if (hvalue == src_item.valueHash) {
+      return 0;
+    }
+
+    digest_ -= ListDigest::element(src_item.valueHash, idx);
+    digest_ += ListDigest::element(hvalue, idx);
+    bool const is_immutable_json = isImmutableJsonObject(value);
+    immutableJsonItems_ +=
+        (is_immutable_json ? 1 : 0) - (src_item.isImmutableJson() ? 1 : 0);
+    vec_.set(idx, ListItem{PyObjectRef{value}, hvalue, is_immutable_json});
+    return 0;
+  }
+
+  PyObjectRef set(PyObject* args) noexcept {
+    Py_ssize_t idx;
+    PyObject* value;
+    if (!PyArg_ParseTuple(args, "nO:set", &idx, &value)) {
+      return nullptr;
+    }
+    if (idx < 0) {
+      idx += vec_.size();
+    }
+    if (setItem(idx, value) < 0) {
+      return nullptr;
+    }
+    return self();
+  }
+
+  PyObjectRef append(PyObject* value) noexcept {
+    auto const hvalue = valueHash(value);
+    digest_ += ListDigest::element(hvalue, vec_.size());
+    bool const is_immutable_json = isImmutableJsonObject(value);
+    if (is_immutable_json) {
+      ++immutableJsonItems_;
+    }
+    vec_.push_back(ListItem{PyObjectRef{value}, hvalue, is_immutable_json});
+    return self();
+  }
+
+  PyObjectRef extend(PyObject* seq) noexcept {
+    if (Py_TYPE(seq) == immutableListTypeObject) {
+      // no need to compute value hashes of an ImmutableList
+      ImmutableList const& other = *ImmutableList::Wrapper::cast(seq);
+      digest_ += other.digest.shifted(vec_.size());
+      immutableJsonItems_ += other.immutableJsonItems;
+      for (auto const& item : other.vec) {
+        vec_.push_back(item);
       }
-      tvec.push_back(
-          ListItem{std::move(value), hvalue, hitem, is_immutable_json});
+    } else if (!ImmutableList::extendCommon(
+                   digest_, immutableJsonItems_, vec_, seq)) {
+      return nullptr;
+    }
+    return self();
+  }
+
+  // Inserting or deleting anywhere but at the end shifts the positions of all
+  // following elements. The digest is updated like in ImmutableList::insert
+  // and ImmutableList::delete_. Transient vectors cannot insert or erase in
+  // the middle, so that goes through a persistent vector, without creating an
+  // ImmutableList.
+  bool insert(Py_ssize_t idx, PyObject* value) noexcept {
+    if (idx == len()) {
+      append(value);
+      return true;
     }
 
-    return !PyErr_Occurred();
+    auto const hvalue = valueHash(value);
+    VectorType const vec = vec_.persistent();
+    digest_ = ImmutableList::digestAfterInsert(vec, digest_, idx, hvalue);
+    bool const is_immutable_json = isImmutableJsonObject(value);
+    if (is_immutable_json) {
+      ++immutableJsonItems_;
+    }
+    ListItem item{PyObjectRef{value}, hvalue, is_immutable_json};
+    vec_ = vec.insert(idx, std::move(item)).transient();
+    return true;
+  }
+
+  bool delete_(Py_ssize_t idx) noexcept {
+    auto const& src_item = vec_[idx];
+    if (src_item.isImmutableJson()) {
+      --immutableJsonItems_;
+    }
+    if (idx == len() - 1) {
+      digest_ -= ListDigest::element(src_item.valueHash, idx);
+      vec_.take(idx);
+      return true;
+    }
+
+    VectorType const vec = vec_.persistent();
+    digest_ = ImmutableList::digestAfterDelete(vec, digest_, idx);
+    vec_ = vec.erase(idx).transient();
+    return true;
+  }
+
+  Py_ssize_t len() {
+    return vec_.size();
+  }
+
+  PyObjectRef persistent(PyObject* /* unused */) {
+    return ImmutableList::intern(
+        digest_, vec_.size(), immutableJsonItems_, [&]() {
+          return vec_.persistent();
+        });
   }
 };
 
+inline PyObjectRef ImmutableList::evolver() {
+  return ImmutableListEvolver::Wrapper::create(*this);
+}
+
 } // namespace
 
 } // namespace pyimmutable
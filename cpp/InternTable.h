@@ -0,0 +1,329 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <endian.h>
+#include <memory>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Sha1Hash.h"
+
+namespace pyimmutable {
+
+namespace detail {
+
+// Control bytes of InternTable slots. A full slot holds the 7-bit fingerprint
+// of its hash, so all special values have the sign bit set.
+enum Ctrl : int8_t {
+  kEmpty = -128,
+  kDeleted = -2,
+};
+
+// The set bits of a mask over the slots of a group. Each slot is represented
+// by 2^Shift bits, of which only the top one may be set.
+template <typename U, int Width, int Shift>
+class BitMask {
+ public:
+  explicit BitMask(U mask) : mask_(mask) {}
+
+  explicit operator bool() const {
+    return mask_ != 0;
+  }
+
+  // Index of the lowest slot in the mask, which must not be empty.
+  int lowest() const {
+    return trailingZeros();
+  }
+
+  void removeLowest() {
+    mask_ &= mask_ - 1;
+  }
+
+  int trailingZeros() const {
+    return __builtin_ctzll(mask_) >> Shift;
+  }
+
+  int leadingZeros() const {
+    constexpr int unused_bits = 64 - (Width << Shift);
+    return (__builtin_clzll(mask_) - unused_bits) >> Shift;
+  }
+
+ private:
+  U mask_;
+};
+
+#ifdef __SSE2__
+
+// Sixteen control bytes, compared with SSE2 instructions.
+struct Group {
+  static constexpr std::size_t kWidth = 16;
+  using Mask = BitMask<std::uint64_t, 16, 0>;
+
+  explicit Group(int8_t const* ctrl)
+      : ctrl_(_mm_loadu_si128(reinterpret_cast<__m128i const*>(ctrl))) {}
+
+  Mask match(int8_t fingerprint) const {
+    return Mask(static_cast<std::uint16_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(fingerprint), ctrl_))));
+  }
+
+  Mask matchEmpty() const {
+    return match(kEmpty);
+  }
+
+  Mask matchEmptyOrDeleted() const {
+    return Mask(static_cast<std::uint16_t>(_mm_movemask_epi8(ctrl_)));
+  }
+
+ private:
+  __m128i ctrl_;
+};
+
+#else
+
+// Eight control bytes, compared bytewise within a 64-bit word.
+struct Group {
+  static constexpr std::size_t kWidth = 8;
+  using Mask = BitMask<std::uint64_t, 8, 3>;
+
+  explicit Group(int8_t const* ctrl) {
+    std::memcpy(&ctrl_, ctrl, sizeof(ctrl_));
+    ctrl_ = le64toh(ctrl_);
+  }
+
+  // May report false positives next to a true match, which is fine because
+  // every candidate is verified.
+  Mask match(int8_t fingerprint) const {
+    std::uint64_t const x = ctrl_ ^ (kLsbs * static_cast<uint8_t>(fingerprint));
+    return Mask((x - kLsbs) & ~x & kMsbs);
+  }
+
+  Mask matchEmpty() const {
+    return Mask(ctrl_ & (~ctrl_ << 6) & kMsbs);
+  }
+
+  Mask matchEmptyOrDeleted() const {
+    return Mask(ctrl_ & kMsbs);
+  }
+
+ private:
+  static constexpr std::uint64_t kLsbs = 0x0101010101010101;
+  static constexpr std::uint64_t kMsbs = 0x8080808080808080;
+
+  std::uint64_t ctrl_;
+};
+
+#endif
+
+} // namespace detail
+
+// Open-addressing hash set of pointers to interned objects, keyed by their
+// `sha1` member.
+//
+// Slots are organised like SwissTable: each holds just the object pointer,
+// and a separate array of control bytes holds a 7-bit fingerprint of the hash
+// of each full slot. A lookup compares the fingerprints of a whole group of
+// slots at once and dereferences only the candidates that match. The control
+// bytes of the first group are mirrored after the last one, so that groups
+// can be loaded at any position without wrapping around.
+template <typename T>
+class InternTable {
+  using Group = detail::Group;
+
+ public:
+  InternTable() {
+    allocate(kMinCapacity);
+  }
+
+  InternTable(InternTable const&) = delete;
+  InternTable& operator=(InternTable const&) = delete;
+
+  std::size_t size() const {
+    return size_;
+  }
+
+  T* find(Sha1Hash const& hash) const {
+    std::size_t const h = Sha1HashHasher{}(hash);
+    for (ProbeSeq seq{h, mask_};; seq.next()) {
+      Group const g{ctrl_.get() + seq.offset};
+      for (auto m = g.match(fingerprint(h)); m; m.removeLowest()) {
+        T* const candidate = slots_[seq(m.lowest())];
+        if (candidate->sha1 == hash) {
+          return candidate;
+        }
+      }
+      if (g.matchEmpty()) {
+        return nullptr;
+      }
+    }
+  }
+
+  // Adds `obj`, which must not be in the table yet.
+  void insert(T* obj) {
+    std::size_t const h = Sha1HashHasher{}(obj->sha1);
+    std::size_t idx = findInsertSlot(h);
+    if (growthLeft_ == 0 && ctrl_[idx] == detail::kEmpty) {
+      // Reclaim deleted slots if they take up at least half of the used
+      // ones, otherwise grow.
+      rehash(
+          size_ <= maxLoad(capacity()) / 2 ? capacity() : capacity() * 2);
+      idx = findInsertSlot(h);
+    }
+    if (ctrl_[idx] == detail::kEmpty) {
+      --growthLeft_;
+    }
+    setCtrl(idx, fingerprint(h));
+    slots_[idx] = obj;
+    ++size_;
+  }
+
+  // Removes `obj`, if it is in the table.
+  void erase(T* obj) {
+    std::size_t const h = Sha1HashHasher{}(obj->sha1);
+    for (ProbeSeq seq{h, mask_};; seq.next()) {
+      Group const g{ctrl_.get() + seq.offset};
+      for (auto m = g.match(fingerprint(h)); m; m.removeLowest()) {
+        std::size_t const idx = seq(m.lowest());
+        if (slots_[idx] == obj) {
+          eraseAt(idx);
+          return;
+        }
+      }
+      if (g.matchEmpty()) {
+        return;
+      }
+    }
+  }
+
+ private:
+  static constexpr std::size_t kMinCapacity = 2 * Group::kWidth;
+  static constexpr std::size_t kMaxLoadNum = 7;
+  static constexpr std::size_t kMaxLoadDen = 8;
+
+  // Triangular probing over groups, which visits every group of a
+  // power-of-two sized table.
+  struct ProbeSeq {
+    std::size_t offset;
+    std::size_t mask;
+    std::size_t step{0};
+
+    ProbeSeq(std::size_t h, std::size_t mask)
+        : offset((h >> 7) & mask), mask(mask) {}
+
+    void next() {
+      step += Group::kWidth;
+      offset = (offset + step) & mask;
+    }
+
+    std::size_t operator()(std::size_t i) const {
+      return (offset + i) & mask;
+    }
+  };
+
+  static int8_t fingerprint(std::size_t h) {
+    return static_cast<int8_t>(h & 0x7f);
+  }
+
+  std::size_t capacity() const {
+    return mask_ + 1;
+  }
+
+  static std::size_t maxLoad(std::size_t capacity) {
+    return capacity * kMaxLoadNum / kMaxLoadDen;
+  }
+
+  std::size_t findInsertSlot(std::size_t h) const {
+    for (ProbeSeq seq{h, mask_};; seq.next()) {
+      Group const g{ctrl_.get() + seq.offset};
+      if (auto m = g.matchEmptyOrDeleted()) {
+        return seq(m.lowest());
+      }
+    }
+  }
+
+  void setCtrl(std::size_t idx, int8_t value) {
+    ctrl_[idx] = value;
+    if (idx < Group::kWidth) {
+      ctrl_[capacity() + idx] = value;
+    }
+  }
+
+  void eraseAt(std::size_t idx) {
+    --size_;
+    // A slot can become empty again if no group containing it has ever been
+    // full, because then no probe sequence has continued past it.
+    std::size_t const before = (idx - Group::kWidth) & mask_;
+    auto const empty_after = Group{ctrl_.get() + idx}.matchEmpty();
+    auto const empty_before = Group{ctrl_.get() + before}.matchEmpty();
+    if (empty_before && empty_after &&
+        static_cast<std::size_t>(
+            empty_after.trailingZeros() + empty_before.leadingZeros()) <
+            Group::kWidth) {
+      setCtrl(idx, detail::kEmpty);
+      ++growthLeft_;
+    } else {
+      setCtrl(idx, detail::kDeleted);
+    }
+  }
+
+  void allocate(std::size_t capacity) {
+    mask_ = capacity - 1;
+    ctrl_ = std::make_unique<int8_t[]>(capacity + Group::kWidth);
+    std::memset(ctrl_.get(), detail::kEmpty, capacity + Group::kWidth);
+    slots_ = std::make_unique<T*[]>(capacity);
+    growthLeft_ = maxLoad(capacity);
+  }
+
+  void rehash(std::size_t new_capacity) {
+    auto const old_ctrl = std::move(ctrl_);
+    auto const old_slots = std::move(slots_);
+    std::size_t const old_capacity = capacity();
+
+    allocate(new_capacity);
+    for (std::size_t i = 0; i < old_capacity; ++i) {
+      if (old_ctrl[i] >= 0) {
+        std::size_t const h = Sha1HashHasher{}(old_slots[i]->sha1);
+        std::size_t const idx = findInsertSlot(h);
+        setCtrl(idx, fingerprint(h));
+        slots_[idx] = old_slots[i];
+        --growthLeft_;
+      }
+    }
+  }
+
+  std::unique_ptr<int8_t[]> ctrl_;
+  std::unique_ptr<T*[]> slots_;
+  std::size_t mask_{0};
+  std::size_t size_{0};
+  std::size_t growthLeft_{0};
+};
+
+} // namespace pyimmutable
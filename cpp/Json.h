@@ -0,0 +1,52 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <string>
+
+#include <Python.h>
+
+#include "PyObjectRef.h"
+
+namespace pyimmutable {
+
+// Parses the JSON document in the str object `doc` into a (potentially
+// nested) structure of ImmutableDict and ImmutableList objects. Accepts the
+// same documents as Python's json.loads with default arguments, and raises
+// json.JSONDecodeError for invalid input.
+PyObjectRef parseJson(PyObject* doc);
+
+// Appends the JSON encoding of `obj` to `out`, in the format of json.dumps
+// with default arguments. If `cache` is set, the encodings of ImmutableDict
+// and ImmutableList objects with isImmutableJson set are stored in those
+// objects and reused whenever they are serialized again.
+bool writeJson(std::string& out, PyObject* obj, bool cache);
+
+// Appends the JSON encoding of the dictionary key `key` to `out`.
+bool writeJsonKey(std::string& out, PyObject* key);
+
+PyObjectRef serializeJson(PyObject* obj, bool cache);
+
+} // namespace pyimmutable
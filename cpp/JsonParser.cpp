@@ -0,0 +1,496 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Json.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ImmutableDict.h"
+#include "ImmutableList.h"
+#include "util.h"
+
+namespace pyimmutable {
+
+namespace {
+
+template <typename Char>
+class JsonParser {
+ public:
+  JsonParser(PyObject* doc, Char const* data, std::size_t size)
+      : doc_(doc), begin_(data), pos_(data), end_(data + size) {}
+
+  PyObjectRef parse() {
+    memo_ = PyObjectRef{PyDict_New(), false};
+    if (!memo_) {
+      return nullptr;
+    }
+
+    PyObjectRef value = parseValue();
+    if (!value) {
+      return nullptr;
+    }
+
+    skipWhitespace();
+    if (pos_ != end_) {
+      return error("Extra data", pos_);
+    }
+    return value;
+  }
+
+ private:
+  PyObjectRef parseValue() {
+    skipWhitespace();
+    if (pos_ == end_) {
+      return error("Expecting value", pos_);
+    }
+
+    switch (*pos_) {
+      case '"':
+        return parseString();
+      case '{':
+        return parseObject();
+      case '[':
+        return parseArray();
+      case 'n':
+        if (consume("null")) {
+          return PyObjectRef{Py_None};
+        }
+        break;
+      case 't':
+        if (consume("true")) {
+          return PyObjectRef{Py_True};
+        }
+        break;
+      case 'f':
+        if (consume("false")) {
+          return PyObjectRef{Py_False};
+        }
+        break;
+      case 'N':
+        if (consume("NaN")) {
+          return PyObjectRef{PyFloat_FromDouble(Py_NAN), false};
+        }
+        break;
+      case 'I':
+        if (consume("Infinity")) {
+          return PyObjectRef{PyFloat_FromDouble(Py_HUGE_VAL), false};
+        }
+        break;
+      case '-':
+        if (consume("-Infinity")) {
+          return PyObjectRef{PyFloat_FromDouble(-Py_HUGE_VAL), false};
+        }
+        return parseNumber();
+      default:
+        if (*pos_ >= '0' && *pos_ <= '9') {
+          return parseNumber();
+        }
+    }
+    return error("Expecting value", pos_);
+  }
+
+  PyObjectRef parseArray() {
+    if (Py_EnterRecursiveCall(" while decoding a JSON array")) {
+      return nullptr;
+    }
+    OnDestroy leave{[]() { Py_LeaveRecursiveCall(); }};
+
+    // the values of all open arrays share one stack
+    std::size_t const base = values_.size();
+    ++pos_;
+    skipWhitespace();
+    if (pos_ != end_ && *pos_ == ']') {
+      ++pos_;
+    } else {
+      while (true) {
+        PyObjectRef value = parseValue();
+        if (!value) {
+          return nullptr;
+        }
+        values_.push_back(std::move(value));
+
+        skipWhitespace();
+        if (pos_ != end_ && *pos_ == ',') {
+          if (trailingComma(']')) {
+            return error("Illegal trailing comma before end of array", pos_);
+          }
+          ++pos_;
+        } else if (pos_ != end_ && *pos_ == ']') {
+          ++pos_;
+          break;
+        } else {
+          return error("Expecting ',' delimiter", pos_);
+        }
+      }
+    }
+
+    auto result =
+        makeImmutableList(values_.data() + base, values_.size() - base);
+    values_.resize(base);
+    return result;
+  }
+
+  PyObjectRef parseObject() {
+    if (Py_EnterRecursiveCall(" while decoding a JSON object")) {
+      return nullptr;
+    }
+    OnDestroy leave{[]() { Py_LeaveRecursiveCall(); }};
+
+    // the items of all open objects share one stack
+    std::size_t const base = items_.size();
+    ++pos_;
+    skipWhitespace();
+    if (pos_ != end_ && *pos_ == '}') {
+      ++pos_;
+    } else {
+      while (true) {
+        skipWhitespace();
+        if (pos_ == end_ || *pos_ != '"') {
+          return error(
+              "Expecting property name enclosed in double quotes", pos_);
+        }
+        PyObjectRef key = parseString();
+        if (!key) {
+          return nullptr;
+        }
+        // identical keys share one str object, as with json.loads
+        key = PyObjectRef{PyDict_SetDefault(memo_.get(), key.get(), key.get())};
+        if (!key) {
+          return nullptr;
+        }
+
+        skipWhitespace();
+        if (pos_ == end_ || *pos_ != ':') {
+          return error("Expecting ':' delimiter", pos_);
+        }
+        ++pos_;
+
+        PyObjectRef value = parseValue();
+        if (!value) {
+          return nullptr;
+        }
+        items_.emplace_back(std::move(key), std::move(value));
+
+        skipWhitespace();
+        if (pos_ != end_ && *pos_ == ',') {
+          if (trailingComma('}')) {
+            return error("Illegal trailing comma before end of object", pos_);
+          }
+          ++pos_;
+        } else if (pos_ != end_ && *pos_ == '}') {
+          ++pos_;
+          break;
+        } else {
+          return error("Expecting ',' delimiter", pos_);
+        }
+      }
+    }
+
+    auto result = makeImmutableDict(items_.data() + base, items_.size() - base);
+    items_.resize(base);
+    return result;
+  }
+
+  PyObjectRef parseString() {
+    Char const* const start = pos_++;
+
+    // fast path: no escape sequences
+    Char const* p = pos_;
+    while (p != end_ && *p != '"' && *p != '\\' && *p >= 0x20) {
+      ++p;
+    }
+    if (p != end_ && *p == '"') {
+      PyObjectRef result{
+          PyUnicode_FromKindAndData(sizeof(Char), pos_, p - pos_), false};
+      pos_ = p + 1;
+      return result;
+    }
+
+    std::vector<Py_UCS4> chars(pos_, p);
+    pos_ = p;
+    while (true) {
+      if (pos_ == end_) {
+        return error("Unterminated string starting at", start);
+      }
+
+      Py_UCS4 c = *pos_;
+      if (c == '"') {
+        ++pos_;
+        break;
+      } else if (c < 0x20) {
+        return error("Invalid control character at", pos_);
+      } else if (c != '\\') {
+        chars.push_back(c);
+        ++pos_;
+        continue;
+      }
+
+      if (++pos_ == end_) {
+        return error("Unterminated string starting at", start);
+      }
+      switch (*pos_) {
+        case '"':
+          c = '"';
+          break;
+        case '\\':
+          c = '\\';
+          break;
+        case '/':
+          c = '/';
+          break;
+        case 'b':
+          c = '\b';
+          break;
+        case 'f':
+          c = '\f';
+          break;
+        case 'n':
+          c = '\n';
+          break;
+        case 'r':
+          c = '\r';
+          break;
+        case 't':
+          c = '\t';
+          break;
+        case 'u': {
+          c = parseHex4(pos_ + 1);
+          if (c == kInvalidHex) {
+            return error("Invalid \\uXXXX escape", pos_);
+          }
+          pos_ += 4;
+          // combine a surrogate pair, keep lone surrogates as they are
+          if (c >= 0xD800 && c <= 0xDBFF && end_ - pos_ >= 7 &&
+              pos_[1] == '\\' && pos_[2] == 'u') {
+            Py_UCS4 const low = parseHex4(pos_ + 3);
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+              c = 0x10000 + (((c - 0xD800) << 10) | (low - 0xDC00));
+              pos_ += 6;
+            }
+          }
+          break;
+        }
+        default:
+          return error("Invalid \\escape", pos_ - 1);
+      }
+      chars.push_back(c);
+      ++pos_;
+    }
+
+    return PyObjectRef{
+        PyUnicode_FromKindAndData(
+            PyUnicode_4BYTE_KIND, chars.data(), chars.size()),
+        false};
+  }
+
+  static constexpr Py_UCS4 kInvalidHex = 0xFFFFFFFF;
+
+  Py_UCS4 parseHex4(Char const* p) const {
+    if (end_ - p < 4) {
+      return kInvalidHex;
+    }
+
+    Py_UCS4 result = 0;
+    for (int i = 0; i < 4; ++i) {
+      Py_UCS4 const c = p[i];
+      result <<= 4;
+      if (c >= '0' && c <= '9') {
+        result |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        result |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        result |= c - 'A' + 10;
+      } else {
+        return kInvalidHex;
+      }
+    }
+    return result;
+  }
+
+  // Numbers follow the same grammar as in json.loads: an integer part
+  // without leading zeros, an optional fraction and an optional exponent.
+  // Numbers with fraction or exponent become floats, all others ints.
+  PyObjectRef parseNumber() {
+    Char const* const start = pos_;
+    Char const* p = pos_;
+
+    if (*p == '-') {
+      ++p;
+    }
+    if (p != end_ && *p == '0') {
+      ++p;
+    } else if (p != end_ && isDigit(*p)) {
+      p = skipDigits(p);
+    } else {
+      return error("Expecting value", start);
+    }
+
+    bool is_float = false;
+    if (end_ - p >= 2 && *p == '.' && isDigit(p[1])) {
+      p = skipDigits(p + 1);
+      is_float = true;
+    }
+    if (p != end_ && (*p == 'e' || *p == 'E')) {
+      Char const* q = p + 1;
+      if (q != end_ && (*q == '+' || *q == '-')) {
+        ++q;
+      }
+      if (q != end_ && isDigit(*q)) {
+        p = skipDigits(q);
+        is_float = true;
+      }
+    }
+    pos_ = p;
+
+    std::string const text(start, p);
+    if (is_float) {
+      double const d = PyOS_string_to_double(text.c_str(), nullptr, nullptr);
+      if (d == -1.0 && PyErr_Occurred()) {
+        return nullptr;
+      }
+      return PyObjectRef{PyFloat_FromDouble(d), false};
+    } else if (text.size() <= 18) {
+      return PyObjectRef{
+          PyLong_FromLongLong(std::strtoll(text.c_str(), nullptr, 10)), false};
+    } else {
+      return PyObjectRef{PyLong_FromString(text.c_str(), nullptr, 10), false};
+    }
+  }
+
+  static bool isDigit(Char c) {
+    return c >= '0' && c <= '9';
+  }
+
+  Char const* skipDigits(Char const* p) const {
+    while (p != end_ && isDigit(*p)) {
+      ++p;
+    }
+    return p;
+  }
+
+  static bool isWhitespace(Char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+  }
+
+  void skipWhitespace() {
+    while (pos_ != end_ && isWhitespace(*pos_)) {
+      ++pos_;
+    }
+  }
+
+  // Whether the comma at pos_ is followed by `closing`, which json.loads
+  // reports as such from Python 3.13 on, rather than as a missing value.
+  bool trailingComma(Char closing) const {
+#if PY_VERSION_HEX >= 0x030D0000
+    Char const* p = pos_ + 1;
+    while (p != end_ && isWhitespace(*p)) {
+      ++p;
+    }
+    return p != end_ && *p == closing;
+#else
+    static_cast<void>(closing);
+    return false;
+#endif
+  }
+
+  template <std::size_t N>
+  bool consume(char const (&literal)[N]) {
+    if (static_cast<std::size_t>(end_ - pos_) < N - 1) {
+      return false;
+    }
+    for (std::size_t i = 0; i < N - 1; ++i) {
+      if (pos_[i] != static_cast<unsigned char>(literal[i])) {
+        return false;
+      }
+    }
+    pos_ += N - 1;
+    return true;
+  }
+
+  PyObjectRef error(char const* msg, Char const* where) {
+    PyObjectRef json_module{PyImport_ImportModule("json"), false};
+    if (!json_module) {
+      return nullptr;
+    }
+    PyObjectRef error_type{
+        PyObject_GetAttrString(json_module.get(), "JSONDecodeError"), false};
+    if (!error_type) {
+      return nullptr;
+    }
+    PyObjectRef exc{PyObject_CallFunction(
+                        error_type.get(),
+                        "sOn",
+                        msg,
+                        doc_,
+                        static_cast<Py_ssize_t>(where - begin_)),
+                    false};
+    if (exc) {
+      PyErr_SetObject(error_type.get(), exc.get());
+    }
+    return nullptr;
+  }
+
+  PyObject* const doc_;
+  Char const* const begin_;
+  Char const* pos_;
+  Char const* const end_;
+  PyObjectRef memo_;
+  std::vector<PyObjectRef> values_;
+  std::vector<std::pair<PyObjectRef, PyObjectRef>> items_;
+};
+
+template <typename Char>
+PyObjectRef parse(PyObject* doc) {
+  return JsonParser<Char>{doc,
+                          static_cast<Char const*>(PyUnicode_DATA(doc)),
+                          static_cast<std::size_t>(PyUnicode_GET_LENGTH(doc))}
+      .parse();
+}
+
+} // namespace
+
+PyObjectRef parseJson(PyObject* doc) {
+  if (!PyUnicode_Check(doc)) {
+    PyErr_Format(
+        PyExc_TypeError,
+        "the JSON object must be str, not %.80s",
+        Py_TYPE(doc)->tp_name);
+    return nullptr;
+  }
+
+  switch (PyUnicode_KIND(doc)) {
+    case PyUnicode_1BYTE_KIND:
+      return parse<Py_UCS1>(doc);
+    case PyUnicode_2BYTE_KIND:
+      return parse<Py_UCS2>(doc);
+    default:
+      return parse<Py_UCS4>(doc);
+  }
+}
+
+} // namespace pyimmutable
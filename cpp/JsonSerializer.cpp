@@ -0,0 +1,262 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Json.h"
+
+#include <cstdio>
+#include <string>
+
+#include "ImmutableDict.h"
+#include "ImmutableList.h"
+#include "util.h"
+
+namespace pyimmutable {
+
+namespace {
+
+char const kHexDigits[] = "0123456789abcdef";
+
+void writeEscape(std::string& out, Py_UCS4 c) {
+  char const buf[] = {'\\',
+                      'u',
+                      kHexDigits[(c >> 12) & 0xf],
+                      kHexDigits[(c >> 8) & 0xf],
+                      kHexDigits[(c >> 4) & 0xf],
+                      kHexDigits[c & 0xf]};
+  out.append(buf, sizeof(buf));
+}
+
+template <typename Char>
+void writeString(std::string& out, Char const* data, std::size_t len) {
+  out += '"';
+  for (Char const* const end = data + len; data != end; ++data) {
+    Py_UCS4 const c = *data;
+    if (c >= ' ' && c <= '~' && c != '"' && c != '\\') {
+      out += static_cast<char>(c);
+      continue;
+    }
+
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\b':
+        out += "\\b";
+        break;
+      case '\f':
+        out += "\\f";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (c >= 0x10000) {
+          Py_UCS4 const v = c - 0x10000;
+          writeEscape(out, 0xD800 | (v >> 10));
+          writeEscape(out, 0xDC00 | (v & 0x3ff));
+        } else {
+          writeEscape(out, c);
+        }
+    }
+  }
+  out += '"';
+}
+
+void writeString(std::string& out, PyObject* str) {
+  void const* const data = PyUnicode_DATA(str);
+  std::size_t const len = PyUnicode_GET_LENGTH(str);
+  switch (PyUnicode_KIND(str)) {
+    case PyUnicode_1BYTE_KIND:
+      return writeString(out, static_cast<Py_UCS1 const*>(data), len);
+    case PyUnicode_2BYTE_KIND:
+      return writeString(out, static_cast<Py_UCS2 const*>(data), len);
+    default:
+      return writeString(out, static_cast<Py_UCS4 const*>(data), len);
+  }
+}
+
+bool writeInt(std::string& out, PyObject* obj) {
+  int overflow = 0;
+  long long const value = PyLong_AsLongLongAndOverflow(obj, &overflow);
+  if (!overflow) {
+    if (value == -1 && PyErr_Occurred()) {
+      return false;
+    }
+    char buf[24];
+    out.append(buf, std::snprintf(buf, sizeof(buf), "%lld", value));
+    return true;
+  }
+
+  PyObjectRef repr{PyLong_Type.tp_repr(obj), false};
+  if (!repr) {
+    return false;
+  }
+  out += PyUnicode_AsUTF8(repr.get());
+  return true;
+}
+
+bool writeFloat(std::string& out, PyObject* obj) {
+  double const d = PyFloat_AS_DOUBLE(obj);
+  if (Py_IS_NAN(d)) {
+    out += "NaN";
+  } else if (Py_IS_INFINITY(d)) {
+    out += d > 0 ? "Infinity" : "-Infinity";
+  } else {
+    char* const repr =
+        PyOS_double_to_string(d, 'r', 0, Py_DTSF_ADD_DOT_0, nullptr);
+    if (!repr) {
+      return false;
+    }
+    out += repr;
+    PyMem_Free(repr);
+  }
+  return true;
+}
+
+template <typename Items>
+bool writeArray(std::string& out, Items const* items, Py_ssize_t size) {
+  out += '[';
+  for (Py_ssize_t i = 0; i < size; ++i) {
+    if (i) {
+      out += ", ";
+    }
+    if (!writeJson(out, items[i], false)) {
+      return false;
+    }
+  }
+  out += ']';
+  return true;
+}
+
+bool writeDict(std::string& out, PyObject* dict) {
+  out += '{';
+  Py_ssize_t pos = 0;
+  PyObject* key;
+  PyObject* value;
+  bool first = true;
+  while (PyDict_Next(dict, &pos, &key, &value)) {
+    if (!first) {
+      out += ", ";
+    }
+    first = false;
+    if (!writeJsonKey(out, key)) {
+      return false;
+    }
+    out += ": ";
+    if (!writeJson(out, value, false)) {
+      return false;
+    }
+  }
+  out += '}';
+  return true;
+}
+
+bool notSerializable(PyObject* obj) {
+  PyErr_Format(
+      PyExc_TypeError,
+      "Object of type %.80s is not JSON serializable",
+      Py_TYPE(obj)->tp_name);
+  return false;
+}
+
+} // namespace
+
+bool writeJson(std::string& out, PyObject* obj, bool cache) {
+  if (obj == Py_None) {
+    out += "null";
+  } else if (obj == Py_True) {
+    out += "true";
+  } else if (obj == Py_False) {
+    out += "false";
+  } else if (PyUnicode_Check(obj)) {
+    writeString(out, obj);
+  } else if (PyLong_Check(obj)) {
+    return writeInt(out, obj);
+  } else if (PyFloat_Check(obj)) {
+    return writeFloat(out, obj);
+  } else {
+    if (Py_EnterRecursiveCall(" while encoding a JSON object")) {
+      return false;
+    }
+    OnDestroy leave{[]() { Py_LeaveRecursiveCall(); }};
+
+    if (Py_TYPE(obj) == immutableDictTypeObject) {
+      return writeImmutableDictJson(out, obj, cache);
+    } else if (Py_TYPE(obj) == immutableListTypeObject) {
+      return writeImmutableListJson(out, obj, cache);
+    } else if (PyDict_CheckExact(obj)) {
+      return writeDict(out, obj);
+    } else if (PyList_CheckExact(obj)) {
+      return writeArray(out, PySequence_Fast_ITEMS(obj), PyList_GET_SIZE(obj));
+    } else if (PyTuple_CheckExact(obj)) {
+      return writeArray(out, PySequence_Fast_ITEMS(obj), PyTuple_GET_SIZE(obj));
+    } else {
+      return notSerializable(obj);
+    }
+  }
+  return true;
+}
+
+bool writeJsonKey(std::string& out, PyObject* key) {
+  if (PyUnicode_Check(key)) {
+    writeString(out, key);
+    return true;
+  }
+
+  // json.dumps turns keys of these types into strings
+  if (key == Py_None || PyLong_Check(key) || PyFloat_Check(key)) {
+    out += '"';
+    if (!writeJson(out, key, false)) {
+      return false;
+    }
+    out += '"';
+    return true;
+  }
+
+  PyErr_Format(
+      PyExc_TypeError,
+      "keys must be str, int, float, bool or None, not %.80s",
+      Py_TYPE(key)->tp_name);
+  return false;
+}
+
+PyObjectRef serializeJson(PyObject* obj, bool cache) {
+  std::string out;
+  if (!writeJson(out, obj, cache)) {
+    return nullptr;
+  }
+  return PyObjectRef{PyUnicode_DecodeASCII(out.data(), out.size(), nullptr),
+                     false};
+}
+
+} // namespace pyimmutable
@@ -0,0 +1,84 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "KeyHashCache.h"
+
+#include <new>
+#include <utility>
+
+namespace pyimmutable {
+
+KeyHashCache* KeyHashCache::instance_{nullptr};
+
+bool KeyHashCache::setCapacity(std::size_t capacity) {
+  if (capacity > kMaxCapacity) {
+    PyErr_Format(
+        PyExc_ValueError,
+        "key hash cache capacity must not exceed %zu",
+        kMaxCapacity);
+    return false;
+  }
+
+  // release the old entries before anything else, since dropping their key
+  // references may run arbitrary code
+  delete std::exchange(instance_, nullptr);
+
+  if (capacity) {
+    std::size_t size = 1;
+    while (size < capacity) {
+      size *= 2;
+    }
+    try {
+      instance_ = new KeyHashCache{size};
+    } catch (std::bad_alloc const&) {
+      PyErr_NoMemory();
+      return false;
+    }
+  }
+  return true;
+}
+
+PyObjectRef KeyHashCache::info() {
+  std::size_t size = 0;
+  if (instance_) {
+    for (auto const& entry : instance_->entries_) {
+      if (entry.key) {
+        ++size;
+      }
+    }
+  }
+
+  return buildValue(
+      "{snsnsnsn}",
+      "capacity",
+      static_cast<Py_ssize_t>(instance_ ? instance_->entries_.size() : 0),
+      "size",
+      static_cast<Py_ssize_t>(size),
+      "hits",
+      static_cast<Py_ssize_t>(instance_ ? instance_->hits_ : 0),
+      "misses",
+      static_cast<Py_ssize_t>(instance_ ? instance_->misses_ : 0));
+}
+
+} // namespace pyimmutable
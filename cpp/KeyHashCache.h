@@ -0,0 +1,108 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Python.h>
+
+#include "PyObjectRef.h"
+#include "Sha1Hasher.h"
+
+namespace pyimmutable {
+
+// Direct-mapped cache from key object identity to the key's hash, for keys
+// that are looked up over and over again, like the interned strings used as
+// attribute names and JSON field names. Each entry holds a reference to its
+// key, so a key cannot die and have its address reused while it is cached.
+class KeyHashCache {
+ public:
+  static Sha1Hash keyHash(PyObject* key) {
+    if (instance_ && isCacheable(key)) {
+      return instance_->lookUp(key);
+    }
+    return valueHash(key);
+  }
+
+  static constexpr std::size_t kMaxCapacity = std::size_t{1} << 20;
+
+  // Replaces the cache with an empty one with room for `capacity` entries,
+  // rounded up to a power of two. A capacity of zero disables the cache.
+  // Returns false with a Python exception set if `capacity` exceeds
+  // kMaxCapacity or the entries cannot be allocated.
+  static bool setCapacity(std::size_t capacity);
+
+  static PyObjectRef info();
+
+ private:
+  struct Entry {
+    PyObjectRef key;
+    Sha1Hash hash;
+  };
+
+  explicit KeyHashCache(std::size_t capacity) : entries_(capacity) {}
+
+  // Interned strings and CPython's preallocated small integers
+  static bool isCacheable(PyObject* key) {
+    if (PyUnicode_CheckExact(key)) {
+      return PyUnicode_CHECK_INTERNED(key);
+    }
+    if (PyLong_CheckExact(key)) {
+      int overflow;
+      long const value = PyLong_AsLongAndOverflow(key, &overflow);
+      return !overflow && value >= -5 && value <= 256;
+    }
+    return false;
+  }
+
+  Sha1Hash lookUp(PyObject* key) {
+    auto const ptr = reinterpret_cast<std::uintptr_t>(key);
+    Entry& entry = entries_[((ptr >> 4) * 0x9E3779B97F4A7C15ull >> 32) &
+                            (entries_.size() - 1)];
+
+    if (entry.key.get() == key) {
+      ++hits_;
+    } else {
+      ++misses_;
+      entry.hash = valueHash(key);
+      entry.key = PyObjectRef{key};
+    }
+    return entry.hash;
+  }
+
+  std::vector<Entry> entries_;
+  std::size_t hits_{0};
+  std::size_t misses_{0};
+
+  static KeyHashCache* instance_;
+};
+
+inline Sha1Hash keyHash(PyObject* key) {
+  return KeyHashCache::keyHash(key);
+}
+
+} // namespace pyimmutable
@@ -0,0 +1,204 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "Sha1Hasher.h"
+
+namespace pyimmutable {
+
+// Position-independent digest of a sequence of value hashes.
+//
+// Each lane holds the polynomial sum(e_i * r^i) over the field of integers
+// modulo the Mersenne prime 2^61-1, where e_i is derived from the hash of the
+// i-th value and r is a fixed base. Digests of concatenations, repetitions
+// and single-element updates can then be computed from the digests of the
+// parts with O(log n) field operations, instead of hashing every element
+// again at its new position.
+class ListDigest {
+ public:
+  static constexpr std::size_t kLanes = 2;
+
+  // The digest of the empty sequence
+  ListDigest() = default;
+
+  // The digest of a single value at position `idx`.
+  static ListDigest element(Sha1Hash const& value_hash, std::size_t idx) {
+    return element(value_hash).shifted(idx);
+  }
+
+  // The digest of a single value at position zero.
+  static ListDigest element(Sha1Hash const& value_hash) {
+    static_assert(sizeof(Sha1Hash) >= 8 * kLanes);
+    ListDigest result;
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      uint64_t v;
+      std::memcpy(&v, value_hash.data() + 8 * l, 8);
+      result.lanes_[l] = reduce((v & kPrime) + (v >> 61));
+    }
+    return result;
+  }
+
+  ListDigest& operator+=(ListDigest const& other) {
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      lanes_[l] = reduce(lanes_[l] + other.lanes_[l]);
+    }
+    return *this;
+  }
+
+  ListDigest& operator-=(ListDigest const& other) {
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      lanes_[l] = reduce(lanes_[l] + kPrime - other.lanes_[l]);
+    }
+    return *this;
+  }
+
+  // Moves the sequence `n` positions to the right, i.e. multiplies by r^n.
+  ListDigest shifted(std::size_t n) const {
+    return (*this) * power(base(), n);
+  }
+
+  // Moves the sequence `n` positions to the left, i.e. multiplies by r^-n.
+  // The first `n` positions must be empty.
+  ListDigest unshifted(std::size_t n) const {
+    return (*this) * power(inverseBase(), n);
+  }
+
+  // The digest of `count` repetitions of a sequence of `len` elements.
+  ListDigest repeated(std::size_t len, std::size_t count) const {
+    return (*this) * geometricSeries(power(base(), len), count);
+  }
+
+  // The hash used for interning, which also covers the length, so that
+  // trailing elements with a zero digest are not lost.
+  Sha1Hash final(std::size_t size) const {
+    return Sha1Hasher{}("lst", 3)(&size, sizeof(size))(lanes_, sizeof(lanes_))
+        .final();
+  }
+
+  // Computes the digests of consecutive positions, starting at a given one,
+  // with a single multiplication per element.
+  class Accumulator;
+
+ private:
+  static constexpr uint64_t kPrime = (uint64_t{1} << 61) - 1;
+  // fixed bases, one per lane, derived from the fractional digits of the
+  // golden ratio and of sqrt(2)
+  static constexpr uint64_t kBase[kLanes] = {
+      0x9E3779B97F4A7C15ull % kPrime, 0x6A09E667F3BCC908ull % kPrime};
+
+  static constexpr uint64_t reduce(uint64_t x) {
+    return x >= kPrime ? x - kPrime : x;
+  }
+
+  static uint64_t mul(uint64_t a, uint64_t b) {
+    unsigned __int128 const x = static_cast<unsigned __int128>(a) * b;
+    uint64_t const lo = static_cast<uint64_t>(x) & kPrime;
+    uint64_t const hi = static_cast<uint64_t>(x >> 61);
+    return reduce(lo + hi);
+  }
+
+  ListDigest operator*(ListDigest const& other) const {
+    ListDigest result;
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      result.lanes_[l] = mul(lanes_[l], other.lanes_[l]);
+    }
+    return result;
+  }
+
+  static ListDigest base() {
+    ListDigest result;
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      result.lanes_[l] = kBase[l];
+    }
+    return result;
+  }
+
+  static ListDigest one() {
+    ListDigest result;
+    for (auto& lane : result.lanes_) {
+      lane = 1;
+    }
+    return result;
+  }
+
+  static ListDigest power(ListDigest base, std::size_t n) {
+    ListDigest result = one();
+    for (; n; n >>= 1) {
+      if (n & 1) {
+        result = result * base;
+      }
+      base = base * base;
+    }
+    return result;
+  }
+
+  // r^-1 = r^(p-2), by Fermat's little theorem
+  static ListDigest const& inverseBase() {
+    static ListDigest const inverse = power(base(), kPrime - 2);
+    return inverse;
+  }
+
+  // 1 + x + x^2 + ... + x^(n-1)
+  static ListDigest geometricSeries(ListDigest const& x, std::size_t n) {
+    if (n == 0) {
+      return ListDigest{};
+    } else if (n % 2) {
+      ListDigest result = x * geometricSeries(x, n - 1);
+      result += one();
+      return result;
+    } else {
+      ListDigest const half = geometricSeries(x, n / 2);
+      ListDigest factor = power(x, n / 2);
+      factor += one();
+      return half * factor;
+    }
+  }
+
+  uint64_t lanes_[kLanes]{};
+};
+
+class ListDigest::Accumulator {
+ public:
+  explicit Accumulator(std::size_t idx) : factor_(power(base(), idx)) {}
+
+  void add(Sha1Hash const& value_hash) {
+    digest_ += element(value_hash) * factor_;
+    factor_ = factor_ * base();
+  }
+
+  ListDigest const& digest() const {
+    return digest_;
+  }
+
+ private:
+  ListDigest factor_;
+  ListDigest digest_;
+};
+
+} // namespace pyimmutable
@@ -0,0 +1,82 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include <immer/memory_policy.hpp>
+
+#include "Arena.h"
+#include "util.h"
+
+namespace pyimmutable {
+
+// A heap that serves allocations from the active Arena, if there is one, and
+// otherwise from `Base`.
+template <typename Base>
+struct ArenaHeap {
+  template <typename... Tags>
+  static void* allocate(std::size_t size, Tags... tags) {
+    if (void* const ptr = Arena::allocate(size)) {
+      return ptr;
+    }
+    return Base::allocate(size, tags...);
+  }
+
+  template <typename... Tags>
+  static void deallocate(std::size_t size, void* data, Tags... tags) {
+    if (!Arena::deallocate(data)) {
+      Base::deallocate(size, data, tags...);
+    }
+  }
+};
+
+// Wraps the heaps of the immer heap policy `Base` in ArenaHeap. The arena
+// comes first, so that memory released to it does not end up in a free list.
+template <typename Base>
+struct ArenaHeapPolicy {
+  using type = ArenaHeap<typename Base::type>;
+
+  template <std::size_t... Sizes>
+  struct optimized {
+    using type =
+        ArenaHeap<typename Base::template optimized<Sizes...>::type>;
+  };
+};
+
+// The memory policy of the immer containers behind ImmutableDict and
+// ImmutableList.
+//
+// Their nodes are only ever copied, modified and released by the thread that
+// holds the GIL, so reference counts do not need to be atomic, and released
+// nodes can be kept for reuse in free lists that need no locking. immer keeps
+// one free list per node size, i.e. one for each kind of node of a map of
+// DictItem or a vector of ListItem. Nodes allocated while an Arena is active
+// come from the arena instead.
+using MemoryPolicy = immer::memory_policy<
+    ArenaHeapPolicy<immer::unsafe_free_list_heap_policy<immer::malloc_heap>>,
+    immer::unsafe_refcount_policy>;
+
+} // namespace pyimmutable
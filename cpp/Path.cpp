@@ -0,0 +1,578 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Path.h"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ImmutableDict.h"
+#include "ImmutableList.h"
+#include "KeyHashCache.h"
+#include "Sha1Hash.h"
+
+namespace pyimmutable {
+
+namespace {
+
+// One step along a path: the element stored under `key` in `container`.
+// All references are borrowed from the path and the tree.
+struct Step {
+  PyObject* container;
+  PyObject* key;
+  PyObject* element{nullptr};
+  Sha1Hash keyHash{};
+  Py_ssize_t index{0};
+};
+
+enum class Found { kYes, kNo, kNotIndexable, kError };
+
+Found locate(Step& step) {
+  if (Py_TYPE(step.container) == immutableDictTypeObject) {
+    step.element =
+        immutableDictLookUp(step.container, step.key, step.keyHash);
+  } else if (
+      Py_TYPE(step.container) == immutableListTypeObject &&
+      PyIndex_Check(step.key)) {
+    step.index = PyNumber_AsSsize_t(step.key, nullptr);
+    if (step.index == -1 && PyErr_Occurred()) {
+      return Found::kError;
+    }
+    step.element = immutableListLookUp(step.container, step.index);
+  } else {
+    return Found::kNotIndexable;
+  }
+  return step.element ? Found::kYes : Found::kNo;
+}
+
+void raiseNotIndexable(Step const& step) {
+  if (Py_TYPE(step.container) == immutableListTypeObject) {
+    PyErr_Format(
+        PyExc_TypeError,
+        "ImmutableList indices must be integers, not %.200s",
+        Py_TYPE(step.key)->tp_name);
+  } else {
+    PyErr_Format(
+        PyExc_TypeError,
+        "path leads into %.200s object, which is not an ImmutableDict or "
+        "ImmutableList",
+        Py_TYPE(step.container)->tp_name);
+  }
+}
+
+void raiseNotFound(Step const& step) {
+  if (Py_TYPE(step.container) == immutableDictTypeObject) {
+    PyErr_SetObject(PyExc_KeyError, PyObjectRef{step.key}.release());
+  } else {
+    PyErr_SetString(PyExc_IndexError, "ImmutableList index out of range");
+  }
+}
+
+// Like PySequence_Fast, but always returns a tuple. PySequence_Fast returns
+// lists as they are, and the caller may change them while Python code (like
+// the function passed to update_in) runs.
+PyObjectRef sequenceTuple(PyObject* obj, char const* message) {
+  PyObjectRef seq{PySequence_Fast(obj, message), false};
+  if (seq && !PyTuple_Check(seq.get())) {
+    seq = PyObjectRef{PyList_AsTuple(seq.get()), false};
+  }
+  return seq;
+}
+
+// The keys of a path, kept alive for the duration of an operation.
+class Path {
+ public:
+  explicit Path(PyObject* path)
+      : seq_{sequenceTuple(path, "path must be iterable")} {}
+
+  explicit operator bool() const {
+    return bool(seq_);
+  }
+
+  std::size_t size() const {
+    return PySequence_Fast_GET_SIZE(seq_.get());
+  }
+
+  PyObject* operator[](std::size_t i) const {
+    return PySequence_Fast_GET_ITEM(seq_.get(), i);
+  }
+
+  bool checkNotEmpty() const {
+    if (size() == 0) {
+      PyErr_SetString(PyExc_ValueError, "path must not be empty");
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  PyObjectRef seq_;
+};
+
+PyObjectRef replace(Step const& step, PyObject* value) {
+  if (Py_TYPE(step.container) == immutableDictTypeObject) {
+    return immutableDictSet(step.container, step.key, step.keyHash, value);
+  } else {
+    return immutableListSet(step.container, step.index, value);
+  }
+}
+
+PyObjectRef remove(Step const& step) {
+  if (Py_TYPE(step.container) == immutableDictTypeObject) {
+    return immutableDictDiscard(step.container, step.keyHash);
+  } else {
+    return immutableListDelete(step.container, step.index);
+  }
+}
+
+// Replaces the containers along `steps`, bottom-up, putting `value` in place
+// of the element of the last step. Stops early if a container is unchanged.
+PyObjectRef rebuild(std::vector<Step> const& steps, PyObjectRef value) {
+  for (auto it = steps.rbegin(); it != steps.rend(); ++it) {
+    if (value.get() == it->element) {
+      return PyObjectRef{steps.front().container};
+    }
+    value = replace(*it, value.get());
+    if (!value) {
+      return nullptr;
+    }
+  }
+  return value;
+}
+
+// Follows `path` from `root`, recording all steps. Stops at the first element
+// that is not found, without raising an exception, unless `create` is set:
+// then missing ImmutableDict values are replaced by empty ImmutableDicts
+// (whose references go to `created`), and the last element may be missing
+// from its ImmutableDict.
+Found follow(
+    PyObject* root,
+    Path const& path,
+    std::vector<Step>& steps,
+    bool create,
+    std::vector<PyObjectRef>& created) {
+  steps.reserve(path.size());
+  PyObject* node = root;
+  for (std::size_t i = 0; i < path.size(); ++i) {
+    auto& step = steps.emplace_back(Step{node, path[i]});
+    switch (locate(step)) {
+      case Found::kYes:
+        break;
+      case Found::kNo:
+        if (!create || Py_TYPE(node) != immutableDictTypeObject) {
+          return Found::kNo;
+        }
+        if (i + 1 < path.size()) {
+          step.element =
+              created.emplace_back(makeImmutableDict(nullptr, 0)).get();
+          if (!step.element) {
+            return Found::kError;
+          }
+        }
+        break;
+      case Found::kNotIndexable:
+        raiseNotIndexable(step);
+        return Found::kError;
+      case Found::kError:
+        return Found::kError;
+    }
+    node = step.element;
+  }
+  return Found::kYes;
+}
+
+enum class Op { kAdd, kRemove, kChange };
+
+bool parseOp(PyObject* obj, Op& op) {
+  static std::pair<char const*, Op> const ops[] = {
+      {"add", Op::kAdd}, {"remove", Op::kRemove}, {"change", Op::kChange}};
+  if (PyUnicode_Check(obj)) {
+    for (auto const& [name, value] : ops) {
+      if (PyUnicode_CompareWithASCIIString(obj, name) == 0) {
+        op = value;
+        return true;
+      }
+    }
+  }
+  PyErr_Format(PyExc_ValueError, "unknown patch operation %R", obj);
+  return false;
+}
+
+// An ImmutableDict or ImmutableList modified by a patch, through an evolver.
+// Containers below it that are modified as well are kept open as children,
+// and written back when it is closed, so that every container is interned
+// only once per patch.
+struct PatchNode {
+  PyObjectRef container;
+  PyObjectRef evolver;
+  // children of an ImmutableDict, by key hash, with their keys
+  std::unordered_map<
+      Sha1Hash,
+      std::pair<PyObjectRef, std::unique_ptr<PatchNode>>,
+      Sha1HashHasher>
+      dictChildren;
+  // children of an ImmutableList, by index
+  std::map<Py_ssize_t, std::unique_ptr<PatchNode>> listChildren;
+
+  bool isDict() const {
+    return Py_TYPE(container.get()) == immutableDictTypeObject;
+  }
+};
+
+std::unique_ptr<PatchNode> openNode(PyObject* container) {
+  PyObjectRef evolver;
+  if (Py_TYPE(container) == immutableDictTypeObject) {
+    evolver = newImmutableDictEvolver(container);
+  } else if (Py_TYPE(container) == immutableListTypeObject) {
+    evolver = newImmutableListEvolver(container);
+  } else {
+    raiseNotIndexable(Step{container, nullptr});
+    return nullptr;
+  }
+  if (!evolver) {
+    return nullptr;
+  }
+  return std::unique_ptr<PatchNode>{
+      new PatchNode{PyObjectRef{container}, std::move(evolver)}};
+}
+
+PyObjectRef closeNode(PatchNode& node);
+
+// Writes back the children of an ImmutableList node from index `begin` on.
+bool closeListChildren(PatchNode& node, Py_ssize_t begin) {
+  for (auto it = node.listChildren.lower_bound(begin);
+       it != node.listChildren.end();
+       it = node.listChildren.erase(it)) {
+    auto const value = closeNode(*it->second);
+    if (!value ||
+        !immutableListEvolverSet(node.evolver.get(), it->first, value.get())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+PyObjectRef closeNode(PatchNode& node) {
+  if (!node.isDict()) {
+    if (!closeListChildren(node, 0)) {
+      return nullptr;
+    }
+    return immutableListEvolverPersistent(node.evolver.get());
+  }
+
+  for (auto& [key_hash, child] : node.dictChildren) {
+    auto const value = closeNode(*child.second);
+    if (!value) {
+      return nullptr;
+    }
+    immutableDictEvolverSet(
+        node.evolver.get(), child.first.get(), key_hash, value.get());
+  }
+  node.dictChildren.clear();
+  return immutableDictEvolverPersistent(node.evolver.get());
+}
+
+// Resolves `key` to an index into the ImmutableList of `node`. With `insert`
+// set, the index may also point just past the end of the list.
+Found locateIndex(
+    PatchNode const& node,
+    PyObject* key,
+    bool insert,
+    Py_ssize_t& idx) {
+  if (!PyIndex_Check(key)) {
+    raiseNotIndexable(Step{node.container.get(), key});
+    return Found::kError;
+  }
+  idx = PyNumber_AsSsize_t(key, nullptr);
+  if (idx == -1 && PyErr_Occurred()) {
+    return Found::kError;
+  }
+  Py_ssize_t const len = immutableListEvolverLength(node.evolver.get());
+  if (idx < 0) {
+    idx += len;
+  }
+  return idx >= 0 && idx < len + (insert ? 1 : 0) ? Found::kYes : Found::kNo;
+}
+
+// Opens the child of `node` at `key`. If there is none, and `create` is set,
+// missing ImmutableDict values are replaced by empty ImmutableDicts, like in
+// setIn.
+Found openChild(
+    PatchNode& node,
+    PyObject* key,
+    bool create,
+    PatchNode*& child) {
+  if (node.isDict()) {
+    auto const key_hash = keyHash(key);
+    auto const it = node.dictChildren.find(key_hash);
+    if (it != node.dictChildren.end()) {
+      child = it->second.second.get();
+      return Found::kYes;
+    }
+
+    PyObjectRef element{
+        immutableDictEvolverLookUp(node.evolver.get(), key_hash)};
+    if (!element) {
+      if (!create) {
+        return Found::kNo;
+      }
+      element = makeImmutableDict(nullptr, 0);
+    }
+    auto opened = element ? openNode(element.get()) : nullptr;
+    if (!opened) {
+      return Found::kError;
+    }
+    child = opened.get();
+    node.dictChildren.emplace(
+        key_hash, std::pair{PyObjectRef{key}, std::move(opened)});
+    return Found::kYes;
+  }
+
+  Py_ssize_t idx;
+  switch (locateIndex(node, key, false, idx)) {
+    case Found::kYes:
+      break;
+    case Found::kNo:
+      if (create) {
+        raiseNotFound(Step{node.container.get(), key});
+        return Found::kError;
+      }
+      return Found::kNo;
+    default:
+      return Found::kError;
+  }
+
+  auto& slot = node.listChildren[idx];
+  if (!slot) {
+    slot = openNode(immutableListEvolverLookUp(node.evolver.get(), idx));
+    if (!slot) {
+      node.listChildren.erase(idx);
+      return Found::kError;
+    }
+  }
+  child = slot.get();
+  return Found::kYes;
+}
+
+// Applies `op` to the element at `key` in the container of `node`. Removing
+// missing elements does nothing, as in discardIn.
+bool modify(PatchNode& node, PyObject* key, Op op, PyObject* value) {
+  if (node.isDict()) {
+    auto const key_hash = keyHash(key);
+    node.dictChildren.erase(key_hash);
+    if (op == Op::kRemove) {
+      immutableDictEvolverDiscard(node.evolver.get(), key_hash);
+    } else {
+      immutableDictEvolverSet(node.evolver.get(), key, key_hash, value);
+    }
+    return true;
+  }
+
+  Py_ssize_t idx;
+  switch (locateIndex(node, key, op == Op::kAdd, idx)) {
+    case Found::kYes:
+      break;
+    case Found::kNo:
+      if (op == Op::kRemove) {
+        return true;
+      }
+      raiseNotFound(Step{node.container.get(), key});
+      return false;
+    default:
+      return false;
+  }
+
+  // insertion and removal shift the elements behind `idx`, so open children
+  // from there on are written back first
+  auto* const evolver = node.evolver.get();
+  switch (op) {
+    case Op::kAdd:
+      return closeListChildren(node, idx) &&
+          immutableListEvolverInsert(evolver, idx, value);
+    case Op::kRemove:
+      node.listChildren.erase(idx);
+      return closeListChildren(node, idx + 1) &&
+          immutableListEvolverDelete(evolver, idx);
+    case Op::kChange:
+      node.listChildren.erase(idx);
+      return immutableListEvolverSet(evolver, idx, value);
+  }
+  return false;
+}
+
+bool applyPatchEntry(PatchNode& root, PyObject* entry) {
+  static char const* const kEntryError =
+      "patch entries must be (path, op, value) tuples";
+  PyObjectRef const fields{sequenceTuple(entry, kEntryError)};
+  if (!fields) {
+    return false;
+  }
+  if (PySequence_Fast_GET_SIZE(fields.get()) != 3) {
+    PyErr_SetString(PyExc_TypeError, kEntryError);
+    return false;
+  }
+  PyObject* const* items = PySequence_Fast_ITEMS(fields.get());
+
+  Op op;
+  Path const keys{items[0]};
+  if (!keys || !keys.checkNotEmpty() || !parseOp(items[1], op)) {
+    return false;
+  }
+
+  PatchNode* node = &root;
+  for (std::size_t i = 0; i + 1 < keys.size(); ++i) {
+    switch (openChild(*node, keys[i], op != Op::kRemove, node)) {
+      case Found::kYes:
+        break;
+      case Found::kNo:
+        return true;
+      default:
+        return false;
+    }
+  }
+  return modify(*node, keys[keys.size() - 1], op, items[2]);
+}
+
+} // namespace
+
+PyObjectRef getIn(PyObject* root, PyObject* path, PyObject* default_value) {
+  Path const keys{path};
+  if (!keys) {
+    return nullptr;
+  }
+
+  PyObject* node = root;
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    Step step{node, keys[i]};
+    switch (locate(step)) {
+      case Found::kYes:
+        node = step.element;
+        break;
+      case Found::kNo:
+      case Found::kNotIndexable:
+        return PyObjectRef{default_value};
+      case Found::kError:
+        return nullptr;
+    }
+  }
+  return PyObjectRef{node};
+}
+
+PyObjectRef setIn(PyObject* root, PyObject* path, PyObject* value) {
+  Path const keys{path};
+  if (!keys || !keys.checkNotEmpty()) {
+    return nullptr;
+  }
+
+  std::vector<Step> steps;
+  std::vector<PyObjectRef> created;
+  switch (follow(root, keys, steps, true, created)) {
+    case Found::kYes:
+      return rebuild(steps, PyObjectRef{value});
+    case Found::kNo:
+      raiseNotFound(steps.back());
+      return nullptr;
+    default:
+      return nullptr;
+  }
+}
+
+PyObjectRef discardIn(PyObject* root, PyObject* path) {
+  Path const keys{path};
+  if (!keys || !keys.checkNotEmpty()) {
+    return nullptr;
+  }
+
+  std::vector<Step> steps;
+  std::vector<PyObjectRef> created;
+  switch (follow(root, keys, steps, false, created)) {
+    case Found::kYes:
+      break;
+    case Found::kNo:
+      return PyObjectRef{root};
+    default:
+      return nullptr;
+  }
+
+  PyObjectRef value = remove(steps.back());
+  if (!value) {
+    return nullptr;
+  }
+  steps.pop_back();
+  return rebuild(steps, std::move(value));
+}
+
+PyObjectRef updateIn(PyObject* root, PyObject* path, PyObject* function) {
+  Path const keys{path};
+  if (!keys || !keys.checkNotEmpty()) {
+    return nullptr;
+  }
+
+  std::vector<Step> steps;
+  std::vector<PyObjectRef> created;
+  switch (follow(root, keys, steps, false, created)) {
+    case Found::kYes:
+      break;
+    case Found::kNo:
+      raiseNotFound(steps.back());
+      return nullptr;
+    default:
+      return nullptr;
+  }
+
+  PyObjectRef value{
+      PyObject_CallFunctionObjArgs(function, steps.back().element, nullptr),
+      false};
+  if (!value) {
+    return nullptr;
+  }
+  return rebuild(steps, std::move(value));
+}
+
+PyObjectRef applyPatch(PyObject* root, PyObject* patch) {
+  PyObjectRef const entries{PyObject_GetIter(patch), false};
+  if (!entries) {
+    return nullptr;
+  }
+  auto const root_node = openNode(root);
+  if (!root_node) {
+    return nullptr;
+  }
+
+  while (PyObjectRef entry{PyIter_Next(entries.get()), false}) {
+    if (!applyPatchEntry(*root_node, entry.get())) {
+      return nullptr;
+    }
+  }
+  if (PyErr_Occurred()) {
+    return nullptr;
+  }
+  return closeNode(*root_node);
+}
+
+} // namespace pyimmutable
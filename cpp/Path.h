@@ -0,0 +1,52 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <Python.h>
+
+#include "PyObjectRef.h"
+
+namespace pyimmutable {
+
+// Access to elements nested in ImmutableDict/ImmutableList trees. A path is a
+// sequence of keys (into ImmutableDict objects) and integer indices (into
+// ImmutableList objects), leading from `root` down to an element.
+//
+// The modifying functions return a copy of `root` in which only the
+// containers along the path are replaced.
+
+PyObjectRef getIn(PyObject* root, PyObject* path, PyObject* default_value);
+PyObjectRef setIn(PyObject* root, PyObject* path, PyObject* value);
+PyObjectRef discardIn(PyObject* root, PyObject* path);
+PyObjectRef updateIn(PyObject* root, PyObject* path, PyObject* function);
+
+// Applies the (path, op, value) entries of `patch`, in the format returned by
+// diff, in one pass: "add" and "change" set the element at `path` to `value`
+// like setIn (with "add" inserting into lists), "remove" discards it like
+// discardIn. All containers along the touched paths are modified in place
+// through evolvers, and interned only once at the end.
+PyObjectRef applyPatch(PyObject* root, PyObject* patch);
+
+} // namespace pyimmutable
@@ -25,6 +25,8 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <utility>
 
 #include <Python.h>
@@ -137,4 +139,77 @@ inline auto none() {
   return PyObjectRef{Py_None};
 }
 
+// An owning reference like PyObjectRef that carries a boolean flag in the
+// lowest bit of the pointer, which is always zero for Python objects. The
+// pointer is stored as bytes with 4-byte alignment, so that a reference
+// placed after a 20-byte digest does not need padding.
+class TaggedPyObjectRef final {
+ public:
+  TaggedPyObjectRef() noexcept = default;
+  ~TaggedPyObjectRef() noexcept {
+    Py_XDECREF(get());
+  }
+
+  explicit TaggedPyObjectRef(PyObjectRef ref, bool flag = false) noexcept {
+    store(ref.release(), flag);
+  }
+
+  TaggedPyObjectRef(TaggedPyObjectRef const& other) noexcept {
+    std::memcpy(bits_, other.bits_, sizeof(bits_));
+    Py_XINCREF(get());
+  }
+
+  TaggedPyObjectRef(TaggedPyObjectRef&& other) noexcept {
+    std::memcpy(bits_, other.bits_, sizeof(bits_));
+    other.store(nullptr, false);
+  }
+
+  TaggedPyObjectRef& operator=(TaggedPyObjectRef const& other) {
+    if (load() != other.load()) {
+      *this = TaggedPyObjectRef(other);
+    }
+    return *this;
+  }
+
+  TaggedPyObjectRef& operator=(TaggedPyObjectRef&& other) noexcept {
+    Py_XDECREF(get());
+    std::memcpy(bits_, other.bits_, sizeof(bits_));
+    other.store(nullptr, false);
+    return *this;
+  }
+
+  PyObject* get() const noexcept {
+    return reinterpret_cast<PyObject*>(load() & ~kFlag);
+  }
+
+  bool flag() const noexcept {
+    return load() & kFlag;
+  }
+
+  PyObjectRef copy() const {
+    return PyObjectRef{get()};
+  }
+
+  explicit operator bool() const {
+    return get();
+  }
+
+ private:
+  static constexpr std::uintptr_t kFlag = 1;
+
+  std::uintptr_t load() const noexcept {
+    std::uintptr_t value;
+    std::memcpy(&value, bits_, sizeof(value));
+    return value;
+  }
+
+  void store(PyObject* ptr, bool flag) noexcept {
+    std::uintptr_t const value =
+        reinterpret_cast<std::uintptr_t>(ptr) | (flag ? kFlag : 0);
+    std::memcpy(bits_, &value, sizeof(value));
+  }
+
+  alignas(4) unsigned char bits_[sizeof(std::uintptr_t)]{};
+};
+
 } // namespace pyimmutable
@@ -5,94 +5,112 @@
  * Based on the Wikipedia article about SHA1 and on
  * Steve Reid's <steve@edmweb.com> public domain implementation.
  *
+ * The hardware-accelerated compression functions follow the structure of
+ * Jeffrey Walton's public domain SHA-NI and ARMv8 sample code.
+ *
  * This is 100% public domain.
  *
  */
 
+#pragma once
+
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <endian.h>
+#include <type_traits>
 #include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHA1_HAVE_SHANI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__linux__)
+#define SHA1_HAVE_ARMV8 1
+#include <arm_neon.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
 
 namespace sha1 {
 
 inline constexpr std::size_t kHashSize = 20;
+inline constexpr std::size_t kBlockSize = 64;
 using Hash = std::array<uint8_t, kHashSize>;
 
-class alignas(16) Context {
- public:
-  Context& operator()(void const* data, std::size_t len) {
-    uint8_t const* ptr = reinterpret_cast<uint8_t const*>(data);
-
-    while (len) {
-      unsigned int const bytes_in_buffer = count % 64;
-      unsigned int const copy_bytes =
-          std::min<unsigned int>(64 - bytes_in_buffer, len);
-      std::copy(ptr, ptr + copy_bytes, buffer.bytes + bytes_in_buffer);
-      ptr += copy_bytes;
-      len -= copy_bytes;
-      count += copy_bytes;
+// A compression function updates the five state words with `blocks`
+// consecutive 64-byte blocks read from `data`.
+using CompressFunction =
+    void (*)(uint32_t* state, uint8_t const* data, std::size_t blocks);
 
-      if (count % 64 == 0) {
-        // buffer is full
-        process_buffer();
-      }
-    }
-    return *this;
-  }
+struct Backend {
+  char const* name;
+  CompressFunction compress;
+};
 
-  Hash final() {
-    uint64_t const message_length_in_bits = count * 8;
+// A multi-lane compression function processes one 64-byte block for each of
+// `lanes` independent messages in lockstep. `states[i]` is updated with
+// `blocks[i]`.
+using MultiCompressFunction =
+    void (*)(uint32_t* const* states, uint8_t const* const* blocks);
 
-    buffer.bytes[count++ % 64] = 0x80;
-    if (count % 64 == 0) {
-      // buffer is full
-      process_buffer();
-    }
+struct MultiBackend {
+  char const* name;
+  std::size_t lanes;
+  MultiCompressFunction compress;
+};
 
-    unsigned int bytes_in_buffer = count % 64;
-    if (bytes_in_buffer > 56) {
-      std::fill(buffer.bytes + bytes_in_buffer, buffer.bytes + 64, 0);
-      process_buffer();
-      bytes_in_buffer = 0;
-    }
+inline constexpr std::size_t kMaxLanes = 16;
 
-    std::fill(buffer.bytes + bytes_in_buffer, buffer.bytes + 56, 0);
+namespace detail {
 
-    *reinterpret_cast<uint64_t*>(&buffer.bytes[56]) =
-        ::htobe64(message_length_in_bits);
-    process_buffer();
+// Portable implementation, fully unrolled at compile time.
+class Generic {
+ public:
+  static void compress(uint32_t* state, uint8_t const* data, std::size_t n) {
+    for (; n; --n, data += kBlockSize) {
+      Generic g{state, data};
+      g.doSteps(std::make_index_sequence<80>());
 
-    Hash result;
-    for (int i = 0; i < 20; ++i) {
-      result[i] = state[i / 4] >> ((3 - (i % 4)) * 8);
+      state[0] += g.s[0];
+      state[1] += g.s[1];
+      state[2] += g.s[2];
+      state[3] += g.s[3];
+      state[4] += g.s[4];
     }
-    return result;
   }
 
  private:
+  Generic(uint32_t const* state, uint8_t const* data) {
+    std::copy(state, state + 5, s);
+    std::copy(data, data + kBlockSize, reinterpret_cast<uint8_t*>(words));
+  }
+
   static uint32_t leftrotate(uint32_t value, unsigned int bits) {
     return ((value << bits) | (value >> (32 - bits)));
   }
 
   template <std::size_t I>
   void doStep() {
-    uint32_t& a = state[(80 - I) % 5];
-    uint32_t& b = state[(81 - I) % 5];
-    uint32_t& c = state[(82 - I) % 5];
-    uint32_t& d = state[(83 - I) % 5];
-    uint32_t& e = state[(84 - I) % 5];
+    uint32_t& a = s[(80 - I) % 5];
+    uint32_t& b = s[(81 - I) % 5];
+    uint32_t& c = s[(82 - I) % 5];
+    uint32_t& d = s[(83 - I) % 5];
+    uint32_t& e = s[(84 - I) % 5];
 
     if constexpr (I < 16) {
-      buffer.words[I] = ::be32toh(buffer.words[I]);
+      words[I] = ::be32toh(words[I]);
     } else {
-      buffer.words[I % 16] = leftrotate(
-          (buffer.words[(I - 3) % 16] ^ buffer.words[(I - 8) % 16] ^
-           buffer.words[(I - 14) % 16] ^ buffer.words[I % 16]),
+      words[I % 16] = leftrotate(
+          (words[(I - 3) % 16] ^ words[(I - 8) % 16] ^ words[(I - 14) % 16] ^
+           words[I % 16]),
           1);
     }
 
-    e += buffer.words[I % 16] + leftrotate(a, 5);
+    e += words[I % 16] + leftrotate(a, 5);
 
     if constexpr (I < 20) {
       e += ((b & (c ^ d)) ^ d) + 0x5A827999;
@@ -112,22 +130,433 @@ class alignas(16) Context {
     (void)std::array<int, 81>{0, (doStep<I>(), 0)...};
   }
 
-  void process_buffer() {
-    auto const saved_state = state;
+  uint32_t s[5];
+  uint32_t words[16];
+};
+
+#ifdef SHA1_HAVE_SHANI
+#define SHA1_SHANI_TARGET __attribute__((target("sha,sse4.1"), always_inline))
+
+// Intel SHA extensions. Each step covers four rounds. The four message
+// registers are used as a ring buffer, as are the two E registers.
+class ShaNi {
+ public:
+  __attribute__((target("sha,sse4.1"))) static void
+  compress(uint32_t* state, uint8_t const* data, std::size_t n) {
+    ShaNi x;
+    x.abcd = _mm_shuffle_epi32(
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(state)), 0x1B);
+    x.e[0] = _mm_set_epi32(state[4], 0, 0, 0);
+
+    for (; n; --n, data += kBlockSize) {
+      __m128i const abcd_saved = x.abcd;
+      __m128i const e_saved = x.e[0];
 
-    doSteps(std::make_index_sequence<80>());
+      x.doSteps(data, std::make_index_sequence<20>());
 
-    state[0] += saved_state[0];
-    state[1] += saved_state[1];
-    state[2] += saved_state[2];
-    state[3] += saved_state[3];
-    state[4] += saved_state[4];
+      x.e[0] = _mm_sha1nexte_epu32(x.e[0], e_saved);
+      x.abcd = _mm_add_epi32(x.abcd, abcd_saved);
+    }
+
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(x.abcd, 0x1B));
+    state[4] = _mm_extract_epi32(x.e[0], 3);
+  }
+
+  static bool supported() {
+    unsigned int a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSSE3) ||
+        !(c & bit_SSE4_1)) {
+      return false;
+    }
+    return __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & bit_SHA);
   }
 
-  union {
-    uint8_t bytes[64];
-    uint32_t words[16];
-  } buffer;
+ private:
+  template <std::size_t G>
+  SHA1_SHANI_TARGET void doStep(uint8_t const* data) {
+    __m128i& e_this = e[G % 2];
+    __m128i& e_next = e[(G + 1) % 2];
+
+    if constexpr (G < 4) {
+      msg[G] = _mm_shuffle_epi8(
+          _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + 16 * G)),
+          _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL));
+    }
+
+    if constexpr (G == 0) {
+      e_this = _mm_add_epi32(e_this, msg[0]);
+    } else {
+      e_this = _mm_sha1nexte_epu32(e_this, msg[G % 4]);
+    }
+    e_next = abcd;
+    if constexpr (G >= 3 && G <= 18) {
+      msg[(G + 1) % 4] = _mm_sha1msg2_epu32(msg[(G + 1) % 4], msg[G % 4]);
+    }
+    abcd = _mm_sha1rnds4_epu32(abcd, e_this, G / 5);
+    if constexpr (G >= 1 && G <= 16) {
+      msg[(G + 3) % 4] = _mm_sha1msg1_epu32(msg[(G + 3) % 4], msg[G % 4]);
+    }
+    if constexpr (G >= 2 && G <= 17) {
+      msg[(G + 2) % 4] = _mm_xor_si128(msg[(G + 2) % 4], msg[G % 4]);
+    }
+  }
+
+  template <std::size_t... G>
+  SHA1_SHANI_TARGET void
+  doSteps(uint8_t const* data, std::index_sequence<G...>) {
+    (doStep<G>(data), ...);
+  }
+
+  __m128i abcd;
+  __m128i e[2];
+  __m128i msg[4];
+};
+
+#undef SHA1_SHANI_TARGET
+#endif
+
+#ifdef SHA1_HAVE_ARMV8
+#define SHA1_ARMV8_TARGET __attribute__((target("+crypto"), always_inline))
+
+// ARMv8 cryptography extensions. Each step covers four rounds, with the
+// message and round-constant registers used as ring buffers.
+class Armv8 {
+ public:
+  __attribute__((target("+crypto"))) static void
+  compress(uint32_t* state, uint8_t const* data, std::size_t n) {
+    Armv8 x;
+    x.abcd = vld1q_u32(state);
+    x.e[0] = state[4];
+
+    for (; n; --n, data += kBlockSize) {
+      uint32x4_t const abcd_saved = x.abcd;
+      uint32_t const e_saved = x.e[0];
+
+      for (std::size_t i = 0; i < 4; ++i) {
+        x.msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+      }
+      x.tmp[0] = vaddq_u32(x.msg[0], vdupq_n_u32(0x5A827999));
+      x.tmp[1] = vaddq_u32(x.msg[1], vdupq_n_u32(0x5A827999));
+
+      x.doSteps(std::make_index_sequence<20>());
+
+      x.e[0] += e_saved;
+      x.abcd = vaddq_u32(x.abcd, abcd_saved);
+    }
+
+    vst1q_u32(state, x.abcd);
+    state[4] = x.e[0];
+  }
+
+  static bool supported() {
+    return ::getauxval(AT_HWCAP) & HWCAP_SHA1;
+  }
+
+ private:
+  static constexpr uint32_t kRoundConstants[4] = {
+      0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6};
+
+  template <std::size_t G>
+  SHA1_ARMV8_TARGET void doStep() {
+    e[(G + 1) % 2] = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+
+    if constexpr (G < 5) {
+      abcd = vsha1cq_u32(abcd, e[G % 2], tmp[G % 2]);
+    } else if constexpr (G >= 10 && G < 15) {
+      abcd = vsha1mq_u32(abcd, e[G % 2], tmp[G % 2]);
+    } else {
+      abcd = vsha1pq_u32(abcd, e[G % 2], tmp[G % 2]);
+    }
+
+    if constexpr (G + 2 < 20) {
+      tmp[G % 2] = vaddq_u32(
+          msg[(G + 2) % 4], vdupq_n_u32(kRoundConstants[(G + 2) / 5]));
+    }
+    if constexpr (G >= 1 && G <= 16) {
+      msg[(G + 3) % 4] = vsha1su1q_u32(msg[(G + 3) % 4], msg[(G + 2) % 4]);
+    }
+    if constexpr (G <= 15) {
+      msg[G % 4] =
+          vsha1su0q_u32(msg[G % 4], msg[(G + 1) % 4], msg[(G + 2) % 4]);
+    }
+  }
+
+  template <std::size_t... G>
+  SHA1_ARMV8_TARGET void doSteps(std::index_sequence<G...>) {
+    (doStep<G>(), ...);
+  }
+
+  uint32x4_t abcd;
+  uint32_t e[2];
+  uint32x4_t msg[4];
+  uint32x4_t tmp[2];
+};
+
+#undef SHA1_ARMV8_TARGET
+#endif
+
+typedef uint32_t Lanes8 __attribute__((vector_size(32)));
+typedef uint32_t Lanes16 __attribute__((vector_size(64)));
+
+// Multi-buffer implementation using GCC vector extensions: every vector
+// element is one lane, i.e. one independent message. The code is inlined
+// into functions compiled for a given instruction set, which determines the
+// machine instructions the vector operations are lowered to.
+template <typename V>
+class MultiLane {
+  static constexpr std::size_t L = sizeof(V) / sizeof(uint32_t);
+
+ public:
+  __attribute__((always_inline)) static void
+  compress(uint32_t* const* states, uint8_t const* const* blocks) {
+    MultiLane m;
+    for (std::size_t l = 0; l < L; ++l) {
+      for (std::size_t i = 0; i < 5; ++i) {
+        m.s[i][l] = states[l][i];
+      }
+      for (std::size_t i = 0; i < 16; ++i) {
+        uint32_t w;
+        std::copy(
+            blocks[l] + 4 * i,
+            blocks[l] + 4 * i + 4,
+            reinterpret_cast<uint8_t*>(&w));
+        m.words[i][l] = ::be32toh(w);
+      }
+    }
+
+    V const a = m.s[0], b = m.s[1], c = m.s[2], d = m.s[3], e = m.s[4];
+
+    m.doSteps(std::make_index_sequence<80>());
+
+    m.s[0] += a;
+    m.s[1] += b;
+    m.s[2] += c;
+    m.s[3] += d;
+    m.s[4] += e;
+    for (std::size_t l = 0; l < L; ++l) {
+      for (std::size_t i = 0; i < 5; ++i) {
+        states[l][i] = m.s[i][l];
+      }
+    }
+  }
+
+ private:
+  template <unsigned int Bits>
+  __attribute__((always_inline)) static void leftrotate(V& value) {
+    value = (value << Bits) | (value >> (32 - Bits));
+  }
+
+  template <std::size_t I>
+  __attribute__((always_inline)) void doStep() {
+    V& a = s[(80 - I) % 5];
+    V& b = s[(81 - I) % 5];
+    V& c = s[(82 - I) % 5];
+    V& d = s[(83 - I) % 5];
+    V& e = s[(84 - I) % 5];
+
+    if constexpr (I >= 16) {
+      words[I % 16] ^=
+          words[(I - 3) % 16] ^ words[(I - 8) % 16] ^ words[(I - 14) % 16];
+      leftrotate<1>(words[I % 16]);
+    }
+
+    V rotated_a = a;
+    leftrotate<5>(rotated_a);
+    e += words[I % 16] + rotated_a;
+
+    if constexpr (I < 20) {
+      e += ((b & (c ^ d)) ^ d) + 0x5A827999;
+    } else if constexpr (I < 40) {
+      e += (b ^ c ^ d) + 0x6ED9EBA1;
+    } else if constexpr (I < 60) {
+      e += (((b | c) & d) | (b & c)) + 0x8F1BBCDC;
+    } else {
+      e += (b ^ c ^ d) + 0xCA62C1D6;
+    }
+
+    leftrotate<30>(b);
+  }
+
+  template <std::size_t... I>
+  __attribute__((always_inline)) void doSteps(std::index_sequence<I...>) {
+    (doStep<I>(), ...);
+  }
+
+  V s[5];
+  V words[16];
+};
+
+#ifdef SHA1_HAVE_SHANI
+__attribute__((target("avx2"))) inline void
+compressAvx2(uint32_t* const* states, uint8_t const* const* blocks) {
+  MultiLane<Lanes8>::compress(states, blocks);
+}
+
+__attribute__((target("avx512f"))) inline void
+compressAvx512(uint32_t* const* states, uint8_t const* const* blocks) {
+  MultiLane<Lanes16>::compress(states, blocks);
+}
+#endif
+
+} // namespace detail
+
+// All compression functions usable on this CPU. The portable implementation
+// comes first, the preferred one last.
+inline std::vector<Backend> const& availableBackends() {
+  static std::vector<Backend> const backends = []() {
+    std::vector<Backend> b{{"generic", &detail::Generic::compress}};
+#ifdef SHA1_HAVE_SHANI
+    if (detail::ShaNi::supported()) {
+      b.push_back({"sha-ni", &detail::ShaNi::compress});
+    }
+#endif
+#ifdef SHA1_HAVE_ARMV8
+    if (detail::Armv8::supported()) {
+      b.push_back({"armv8", &detail::Armv8::compress});
+    }
+#endif
+    return b;
+  }();
+  return backends;
+}
+
+// The compression function used by every `Context`. It is constant
+// initialized to the portable implementation, so hashing works even before
+// dynamic initialization has run, and is then switched to the best backend
+// for this CPU when the library is loaded.
+inline CompressFunction compressFunction = &detail::Generic::compress;
+
+inline void selectBackend(Backend const& backend) {
+  compressFunction = backend.compress;
+}
+
+// All multi-lane compression functions usable on this CPU, the preferred one
+// last. There is no portable multi-lane implementation: without one, batches
+// of messages are hashed one by one with `compressFunction`.
+inline std::vector<MultiBackend> const& availableMultiBackends() {
+  static std::vector<MultiBackend> const backends = []() {
+    std::vector<MultiBackend> b;
+#ifdef SHA1_HAVE_SHANI
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      b.push_back({"avx2", 8, &detail::compressAvx2});
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+      b.push_back({"avx512", 16, &detail::compressAvx512});
+    }
+#endif
+    return b;
+  }();
+  return backends;
+}
+
+inline MultiBackend multiBackend = {"none", 1, nullptr};
+
+inline void selectMultiBackend(MultiBackend const& backend) {
+  multiBackend = backend;
+}
+
+namespace detail {
+inline bool const backendSelected =
+    (selectBackend(availableBackends().back()),
+     availableMultiBackends().empty()
+         ? void()
+         : selectMultiBackend(availableMultiBackends().back()),
+     true);
+} // namespace detail
+
+class alignas(16) Context {
+  template <typename C>
+  friend void finalMany(C* contexts, std::size_t n, Hash* results);
+
+ public:
+  Context& operator()(void const* data, std::size_t len) {
+    uint8_t const* ptr = reinterpret_cast<uint8_t const*>(data);
+
+    if (unsigned int const bytes_in_buffer = count % kBlockSize) {
+      unsigned int const copy_bytes =
+          std::min<std::size_t>(kBlockSize - bytes_in_buffer, len);
+      std::copy(ptr, ptr + copy_bytes, buffer + bytes_in_buffer);
+      ptr += copy_bytes;
+      len -= copy_bytes;
+      count += copy_bytes;
+
+      if (count % kBlockSize) {
+        // buffer is still not full
+        return *this;
+      }
+      compressFunction(state.data(), buffer, 1);
+    }
+
+    // hash full blocks straight from the input
+    if (std::size_t const blocks = len / kBlockSize) {
+      compressFunction(state.data(), ptr, blocks);
+      ptr += blocks * kBlockSize;
+      len -= blocks * kBlockSize;
+      count += blocks * kBlockSize;
+    }
+
+    std::copy(ptr, ptr + len, buffer);
+    count += len;
+    return *this;
+  }
+
+  Hash final() {
+    uint64_t const message_length_in_bits = count * 8;
+
+    buffer[count++ % kBlockSize] = 0x80;
+    if (count % kBlockSize == 0) {
+      // buffer is full
+      compressFunction(state.data(), buffer, 1);
+    }
+
+    unsigned int bytes_in_buffer = count % kBlockSize;
+    if (bytes_in_buffer > 56) {
+      std::fill(buffer + bytes_in_buffer, buffer + kBlockSize, 0);
+      compressFunction(state.data(), buffer, 1);
+      bytes_in_buffer = 0;
+    }
+
+    std::fill(buffer + bytes_in_buffer, buffer + 56, 0);
+
+    uint64_t const be_length = ::htobe64(message_length_in_bits);
+    std::copy(
+        reinterpret_cast<uint8_t const*>(&be_length),
+        reinterpret_cast<uint8_t const*>(&be_length) + 8,
+        buffer + 56);
+    compressFunction(state.data(), buffer, 1);
+
+    return digest();
+  }
+
+ private:
+  // Adds the padding if the complete message fits into one block, which then
+  // is the only one left to compress. Returns false otherwise.
+  bool padSingleBlock() {
+    if (count >= 56) {
+      return false;
+    }
+
+    uint64_t const be_length = ::htobe64(count * 8);
+    buffer[count] = 0x80;
+    std::fill(buffer + count + 1, buffer + 56, 0);
+    std::copy(
+        reinterpret_cast<uint8_t const*>(&be_length),
+        reinterpret_cast<uint8_t const*>(&be_length) + 8,
+        buffer + 56);
+    return true;
+  }
+
+  Hash digest() const {
+    Hash result;
+    for (int i = 0; i < 20; ++i) {
+      result[i] = state[i / 4] >> ((3 - (i % 4)) * 8);
+    }
+    return result;
+  }
+
+  alignas(16) uint8_t buffer[kBlockSize];
   std::array<uint32_t, 6> state = {0x67452301,
                                    0xEFCDAB89,
                                    0x98BADCFE,
@@ -136,4 +565,55 @@ class alignas(16) Context {
   uint64_t count = 0;
 };
 
+// Finalizes `n` contexts and writes their digests to `results`. Messages that
+// fit into a single block are compressed in lockstep by the selected
+// multi-lane backend, all others are finalized one by one. The contexts must
+// not be used afterwards.
+template <typename C>
+void finalMany(C* contexts, std::size_t n, Hash* results) {
+  static_assert(std::is_base_of_v<Context, C>);
+
+  std::size_t const lanes = multiBackend.lanes;
+  std::size_t lane_index[kMaxLanes];
+  uint32_t* states[kMaxLanes];
+  uint8_t const* blocks[kMaxLanes];
+  std::size_t used = 0;
+
+  auto flush = [&]() {
+    // unused lanes repeat the first one, which is harmless as all lanes are
+    // read before any is written back
+    for (std::size_t l = used; l < lanes; ++l) {
+      states[l] = states[0];
+      blocks[l] = blocks[0];
+    }
+    multiBackend.compress(states, blocks);
+    for (std::size_t l = 0; l < used; ++l) {
+      results[lane_index[l]] = contexts[lane_index[l]].digest();
+    }
+    used = 0;
+  };
+
+  for (std::size_t i = 0; i < n; ++i) {
+    Context& ctx = contexts[i];
+    if (lanes > 1 && ctx.padSingleBlock()) {
+      lane_index[used] = i;
+      states[used] = ctx.state.data();
+      blocks[used] = ctx.buffer;
+      if (++used == lanes) {
+        flush();
+      }
+    } else {
+      results[i] = ctx.final();
+    }
+  }
+
+  if (used > 1) {
+    flush();
+  } else if (used == 1) {
+    Context& ctx = contexts[lane_index[0]];
+    compressFunction(ctx.state.data(), ctx.buffer, 1);
+    results[lane_index[0]] = ctx.digest();
+  }
+}
+
 } // namespace sha1
@@ -24,11 +24,68 @@
 
 #pragma once
 
+#include <cstddef>
+#include <memory>
+#include <tuple>
+
+#include "Blake3.h"
 #include "Sha1.h"
+#ifdef PYIMMUTABLE_HASH_XXH3
+#include "Xxh3.h"
+#endif
 
 namespace pyimmutable {
 
-using Sha1Hash = sha1::Hash;
+// A hash policy names the digest type, the incremental hashing context, and a
+// function that finalizes many contexts at once.
+
+struct Sha1Policy {
+  static constexpr char const* name = "sha1";
+  using Hash = sha1::Hash;
+  using Context = sha1::Context;
+
+  template <typename C>
+  static void finalMany(C* contexts, std::size_t n, Hash* results) {
+    sha1::finalMany(contexts, n, results);
+  }
+};
+
+// Base for policies of hash functions without a batch implementation.
+struct SequentialFinalMany {
+  template <typename C, typename H>
+  static void finalMany(C* contexts, std::size_t n, H* results) {
+    for (std::size_t i = 0; i < n; ++i) {
+      results[i] = contexts[i].final();
+    }
+  }
+};
+
+// BLAKE3, truncated to 128 bits.
+struct Blake3Policy : SequentialFinalMany {
+  static constexpr char const* name = "blake3";
+  using Context = blake3::Context<16>;
+  using Hash = Context::Hash;
+};
+
+#ifdef PYIMMUTABLE_HASH_XXH3
+struct Xxh3Policy : SequentialFinalMany {
+  static constexpr char const* name = "xxh3";
+  using Context = xxh3::Context;
+  using Hash = xxh3::Hash;
+};
+#endif
+
+// The policy used for all content hashes is chosen at build time (see
+// setup.py). Sha1Hash and Sha1Hasher name its types whichever it is.
+#if defined(PYIMMUTABLE_HASH_XXH3)
+using HashPolicy = Xxh3Policy;
+#elif defined(PYIMMUTABLE_HASH_BLAKE3)
+using HashPolicy = Blake3Policy;
+#else
+using HashPolicy = Sha1Policy;
+#endif
+
+using Sha1Hash = HashPolicy::Hash;
 
 struct Sha1HashHasher {
   std::size_t operator()(Sha1Hash const& h) const {
@@ -38,8 +95,9 @@ struct Sha1HashHasher {
 
 inline Sha1Hash&
 xorHashInPlace(Sha1Hash& h1, Sha1Hash const& h2, unsigned int shift = 0) {
-  for (std::size_t i = 0; i < sha1::kHashSize; ++i) {
-    h1[i] ^= h2[(i + shift) % sha1::kHashSize];
+  constexpr std::size_t size = std::tuple_size_v<Sha1Hash>;
+  for (std::size_t i = 0; i < size; ++i) {
+    h1[i] ^= h2[(i + shift) % size];
   }
 
   return h1;
@@ -24,18 +24,136 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Python.h>
+
+#include "ImmutableDict.h"
+#include "ImmutableList.h"
+#include "PyObjectRef.h"
 #include "Sha1Hash.h"
 
 namespace pyimmutable {
 
-class Sha1Hasher : public sha1::Context {
+// The sign and magnitude of an int in CPython's internal base 2**PyLong_SHIFT,
+// least significant digit first. That is how PyLongObject stores ints up to
+// Python 3.11. Later versions changed the layout, so the digits are computed
+// through the public API there, which keeps digests the same on all versions.
+class LongDigits {
+ public:
+  explicit LongDigits(PyObject* obj) {
+#if PY_VERSION_HEX < 0x030C0000
+    auto const* const lobj = reinterpret_cast<PyLongObject*>(obj);
+    signedSize_ = Py_SIZE(lobj);
+    digits_ = lobj->ob_digit;
+#else
+    int overflow;
+    long long const value = PyLong_AsLongLongAndOverflow(obj, &overflow);
+    if (!overflow) {
+      unsigned long long magnitude = value < 0
+          ? 0ull - static_cast<unsigned long long>(value)
+          : static_cast<unsigned long long>(value);
+      Py_ssize_t size = 0;
+      for (; magnitude; magnitude >>= PyLong_SHIFT) {
+        small_[size++] = static_cast<digit>(magnitude & PyLong_MASK);
+      }
+      signedSize_ = value < 0 ? -size : size;
+      digits_ = small_;
+    } else {
+      fromBytes(obj, overflow < 0);
+    }
+#endif
+  }
+
+  // The number of digits, negated for negative numbers (what Py_SIZE was)
+  Py_ssize_t signedSize() const {
+    return signedSize_;
+  }
+
+  digit const* data() const {
+    return digits_;
+  }
+
+  std::size_t size() const {
+    return signedSize_ < 0 ? -signedSize_ : signedSize_;
+  }
+
+ private:
+#if PY_VERSION_HEX >= 0x030C0000
+  // Converts an int that does not fit into a long long via its two's
+  // complement bytes.
+  void fromBytes(PyObject* obj, bool negative) {
+#if PY_VERSION_HEX >= 0x030D0000
+    Py_ssize_t const len = PyLong_AsNativeBytes(
+        obj, nullptr, 0, Py_ASNATIVEBYTES_LITTLE_ENDIAN);
+    std::vector<unsigned char> bytes(std::max<Py_ssize_t>(len, 0));
+    PyLong_AsNativeBytes(
+        obj, bytes.data(), bytes.size(), Py_ASNATIVEBYTES_LITTLE_ENDIAN);
+#else
+    std::vector<unsigned char> bytes(_PyLong_NumBits(obj) / 8 + 1);
+    _PyLong_AsByteArray(
+        reinterpret_cast<PyLongObject*>(obj),
+        bytes.data(),
+        bytes.size(),
+        /* little_endian */ 1,
+        /* is_signed */ 1);
+#endif
+    if (negative) {
+      // negate the two's complement
+      unsigned carry = 1;
+      for (auto& byte : bytes) {
+        unsigned const sum = static_cast<unsigned char>(~byte) + carry;
+        byte = static_cast<unsigned char>(sum);
+        carry = sum >> 8;
+      }
+    }
+
+    uint64_t acc = 0;
+    unsigned bits = 0;
+    for (unsigned char const byte : bytes) {
+      acc |= uint64_t{byte} << bits;
+      bits += 8;
+      if (bits >= PyLong_SHIFT) {
+        large_.push_back(static_cast<digit>(acc & PyLong_MASK));
+        acc >>= PyLong_SHIFT;
+        bits -= PyLong_SHIFT;
+      }
+    }
+    large_.push_back(static_cast<digit>(acc));
+    while (!large_.empty() && !large_.back()) {
+      large_.pop_back();
+    }
+
+    Py_ssize_t const size = large_.size();
+    signedSize_ = negative ? -size : size;
+    digits_ = large_.data();
+  }
+
+  digit small_[(64 + PyLong_SHIFT - 1) / PyLong_SHIFT];
+  std::vector<digit> large_;
+#endif
+
+  Py_ssize_t signedSize_;
+  digit const* digits_;
+};
+
+template <typename Policy>
+class BasicHasher : public Policy::Context {
  public:
-  Sha1Hasher& operator()(void const* data, std::size_t len) {
-    sha1::Context::operator()(data, len);
+  BasicHasher& operator()(void const* data, std::size_t len) {
+    Policy::Context::operator()(data, len);
     return *this;
   }
 
-  Sha1Hasher& operator()(PyObject* obj) {
+  BasicHasher& operator()(Sha1Hash const& hash) {
+    return (*this)(hash.data(), hash.size());
+  }
+
+  BasicHasher& operator()(PyObject* obj) {
     if (PyUnicode_Check(obj)) {
       Py_ssize_t len = PyUnicode_GET_LENGTH(obj) * PyUnicode_KIND(obj);
       return (*this)("unc", 3)(static_cast<void const*>(&len), sizeof(len))(
@@ -46,14 +164,12 @@ class Sha1Hasher : public sha1::Context {
       PyBytes_AsStringAndSize(obj, &data, &len);
       return (*this)("byt", 3)(data, len);
     } else if (PyLong_Check(obj)) {
-      PyLongObject* const lobj = reinterpret_cast<PyLongObject*>(obj);
+      LongDigits const digits{obj};
 
-      Py_ssize_t l = Py_SIZE(lobj);
+      Py_ssize_t l = digits.signedSize();
       (*this)("lon", 3)(&l, sizeof(l));
-      if (l > 0) {
-        (*this)(lobj->ob_digit, l * sizeof(lobj->ob_digit[0]));
-      } else if (l < 0) {
-        (*this)(lobj->ob_digit, -l * sizeof(lobj->ob_digit[0]));
+      if (l) {
+        (*this)(digits.data(), digits.size() * sizeof(digit));
       }
       return (*this);
     } else if (PyFloat_Check(obj)) {
@@ -67,6 +183,14 @@ class Sha1Hasher : public sha1::Context {
         (*this)(PyTuple_GetItem(obj, i));
       }
       return *this;
+    } else if (obj == Py_None) {
+      return (*this)("non", 3);
+    } else if (Py_TYPE(obj) == immutableDictTypeObject) {
+      // nested containers are hashed by their own content hash, so that
+      // digests of trees do not depend on object addresses
+      return (*this)("imd", 3)(immutableDictSha1(obj));
+    } else if (Py_TYPE(obj) == immutableListTypeObject) {
+      return (*this)("iml", 3)(immutableListSha1(obj));
     } else {
       return (*this)("obj", 3)(&obj, sizeof(PyObject*));
     }
@@ -87,7 +211,7 @@ class Sha1Hasher : public sha1::Context {
         PyTuple_Check(p)) {
       // the objects are of an immutable builtin type for which we check
       // the contents
-      return Sha1Hasher()(p).final() == Sha1Hasher()(q).final();
+      return BasicHasher()(p).final() == BasicHasher()(q).final();
     }
 
     // ...for all other types we require object identity, and we checked for
@@ -96,6 +220,8 @@ class Sha1Hasher : public sha1::Context {
   }
 };
 
+using Sha1Hasher = BasicHasher<HashPolicy>;
+
 inline std::pair<Sha1Hash, Sha1Hash> keyValueHashes(
     PyObject* key,
     PyObject* value) {
@@ -106,14 +232,89 @@ inline std::pair<Sha1Hash, Sha1Hash> keyValueHashes(
   return {hasher.final(), value_hasher.final()};
 }
 
+// Digests of values that are hashed over and over again: CPython's cached
+// small integers (and with them True and False, which hash like 1 and 0),
+// None, the empty string and the empty tuple. The table is filled in once
+// during module initialisation.
+class PrecomputedHashes {
+ public:
+  static constexpr long kMinInt = -5;
+  static constexpr long kMaxInt = 256;
+
+  static void init() {
+    for (long i = kMinInt; i <= kMaxInt; ++i) {
+      PyObjectRef const obj{PyLong_FromLong(i), false};
+      ints_[i - kMinInt] = Sha1Hasher{}(obj.get()).final();
+    }
+    none_ = Sha1Hasher{}(Py_None).final();
+    PyObjectRef const empty_str{PyUnicode_New(0, 0), false};
+    emptyStr_ = Sha1Hasher{}(empty_str.get()).final();
+    PyObjectRef const empty_tuple{PyTuple_New(0), false};
+    emptyTuple_ = Sha1Hasher{}(empty_tuple.get()).final();
+    initialized_ = true;
+  }
+
+  static Sha1Hash const* find(PyObject* obj) {
+    if (!initialized_) {
+      return nullptr;
+    }
+    if (PyLong_Check(obj)) {
+      int overflow;
+      long const value = PyLong_AsLongAndOverflow(obj, &overflow);
+      if (!overflow && value >= kMinInt && value <= kMaxInt) {
+        return &ints_[value - kMinInt];
+      }
+    } else if (obj == Py_None) {
+      return &none_;
+    } else if (PyUnicode_Check(obj)) {
+      if (PyUnicode_GET_LENGTH(obj) == 0) {
+        return &emptyStr_;
+      }
+    } else if (PyTuple_Check(obj)) {
+      if (PyTuple_GET_SIZE(obj) == 0) {
+        return &emptyTuple_;
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  inline static std::array<Sha1Hash, kMaxInt - kMinInt + 1> ints_;
+  inline static Sha1Hash none_;
+  inline static Sha1Hash emptyStr_;
+  inline static Sha1Hash emptyTuple_;
+  inline static bool initialized_{false};
+};
+
 inline Sha1Hash valueHash(PyObject* value) {
+  if (auto const* const precomputed = PrecomputedHashes::find(value)) {
+    return *precomputed;
+  }
   return Sha1Hasher{}(value).final();
 }
 
-inline Sha1Hash itemHash(Sha1Hash const& value_hash, std::size_t idx) {
-  return Sha1Hasher{}("itm", 3)(&idx, sizeof(idx))(
-             value_hash.data(), value_hash.size())
-      .final();
+inline constexpr std::size_t kHashBatchSize = 64;
+
+// Computes the digests of `count` messages in batches, so that short messages
+// can be hashed in lockstep by a multi-lane SHA1 implementation.
+// `feed(hasher, i)` writes message `i` into a fresh hasher, and
+// `consume(i, hash)` receives its digest. Both are called in order of `i`.
+template <typename Feed, typename Consume>
+void hashMany(std::size_t count, Feed&& feed, Consume&& consume) {
+  std::array<Sha1Hasher, kHashBatchSize> hashers;
+  std::array<Sha1Hash, kHashBatchSize> hashes;
+
+  for (std::size_t begin = 0; begin < count; begin += kHashBatchSize) {
+    std::size_t const n = std::min(kHashBatchSize, count - begin);
+    for (std::size_t i = 0; i < n; ++i) {
+      hashers[i] = Sha1Hasher{};
+      feed(hashers[i], begin + i);
+    }
+    HashPolicy::finalMany(hashers.data(), n, hashes.data());
+    for (std::size_t i = 0; i < n; ++i) {
+      consume(begin + i, hashes[i]);
+    }
+  }
 }
 
 } // namespace pyimmutable
@@ -0,0 +1,962 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <endian.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Binary.h"
+#include "ClassWrapper.h"
+#include "ImmutableDict.h"
+#include "ImmutableList.h"
+#include "KeyHashCache.h"
+#include "docstrings.autogen.h"
+#include "util.h"
+
+namespace pyimmutable {
+
+namespace {
+
+constexpr std::size_t kOffsetSize = sizeof(uint64_t);
+constexpr std::size_t kDictEntrySize = sizeof(Sha1Hash) + 2 * kOffsetSize;
+
+std::string snapshotHeader() {
+  std::string header(kSnapshotMagic, sizeof(kSnapshotMagic));
+  header += static_cast<char>(std::strlen(HashPolicy::name));
+  header += HashPolicy::name;
+  return header;
+}
+
+uint64_t loadFixed(char const* data) {
+  uint64_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return ::le64toh(value);
+}
+
+bool isContainer(PyObject* obj) {
+  return Py_TYPE(obj) == immutableDictTypeObject ||
+      Py_TYPE(obj) == immutableListTypeObject;
+}
+
+Sha1Hash const& containerDigest(PyObject* obj) {
+  return Py_TYPE(obj) == immutableDictTypeObject ? immutableDictSha1(obj)
+                                                 : immutableListSha1(obj);
+}
+
+// Reads a digest as returned by the `digest` property of ImmutableDict and
+// ImmutableList. Returns false, without raising, if `obj` is not one.
+bool parseDigest(PyObject* obj, Sha1Hash& digest) {
+  if (!PyBytes_Check(obj) ||
+      static_cast<std::size_t>(PyBytes_GET_SIZE(obj)) != digest.size()) {
+    return false;
+  }
+  std::memcpy(digest.data(), PyBytes_AS_STRING(obj), digest.size());
+  return true;
+}
+
+// The offsets of all containers in a snapshot store, by digest.
+struct SnapshotIndex {
+  using Wrapper = ClassWrapper<SnapshotIndex>;
+
+  std::unordered_map<Sha1Hash, uint64_t, Sha1HashHasher> offsets;
+
+  static PyObjectRef new_(PyTypeObject*, PyObject* args, PyObject* kwds) {
+    if (!noKeywords("SnapshotIndex", kwds) ||
+        !PyArg_UnpackTuple(args, "SnapshotIndex", 0, 0)) {
+      return nullptr;
+    }
+    return Wrapper::create();
+  }
+
+  Py_ssize_t len() const {
+    return offsets.size();
+  }
+
+  int contains(PyObject* digest) const {
+    Sha1Hash h;
+    return parseDigest(digest, h) && offsets.count(h);
+  }
+
+  PyObjectRef getItem(PyObject* digest) const {
+    Sha1Hash h;
+    auto const it = parseDigest(digest, h) ? offsets.find(h) : offsets.end();
+    if (it == offsets.end()) {
+      PyErr_SetObject(PyExc_KeyError, digest);
+      return nullptr;
+    }
+    return PyObjectRef{PyLong_FromUnsignedLongLong(it->second), false};
+  }
+
+  PyObjectRef update(PyObject* data);
+  PyObjectRef merge(PyObject* other);
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Writing
+
+class SnapshotWriter : private BinaryWriter {
+ public:
+  // Writes a snapshot of its own without `index`, or else the data to append
+  // to the snapshot store of size `size` that `index` describes.
+  explicit SnapshotWriter(SnapshotIndex* index = nullptr, uint64_t size = 0)
+      : BinaryWriter(size ? std::string{} : snapshotHeader()),
+        index_(index),
+        base_(size),
+        start_(position()) {}
+
+  PyObjectRef dumps(PyObject* root) {
+    uint64_t offset;
+    if (!writeRecord(root, offset)) {
+      return nullptr;
+    }
+    writeFixed(offset);
+    return bytes();
+  }
+
+  PyObjectRef commit(PyObject* root) {
+    uint64_t offset;
+    if (!writeRecord(root, offset)) {
+      return nullptr;
+    }
+    writeTag(snapshot_tag::kCommit);
+    for (auto const& [digest, record] : added_) {
+      writeBytes(digest.data(), digest.size());
+      writeFixed(record);
+    }
+    auto const& root_digest = containerDigest(root);
+    writeBytes(root_digest.data(), root_digest.size());
+    writeFixed(added_.size());
+    writeFixed(start_);
+    writeFixed(offset);
+
+    // the new containers go to an index of their own, since they may only be
+    // looked up once the data has been stored
+    PyObjectRef data = bytes();
+    if (!data) {
+      return nullptr;
+    }
+    auto added = SnapshotIndex::Wrapper::create();
+    if (!added) {
+      return nullptr;
+    }
+    added->offsets.insert(added_.begin(), added_.end());
+    return buildValue("NN", data.release(), added.release());
+  }
+
+  // Writes the record of the ImmutableDict or ImmutableList `obj`, unless that
+  // has been done before, and stores its offset in `offset`.
+  bool writeRecord(PyObject* obj, uint64_t& offset) {
+    auto const it = records_.find(obj);
+    if (it != records_.end()) {
+      offset = it->second;
+      return true;
+    }
+    if (index_) {
+      auto const known = index_->offsets.find(containerDigest(obj));
+      if (known != index_->offsets.end()) {
+        offset = known->second;
+        return true;
+      }
+    }
+
+    if (Py_EnterRecursiveCall(" while encoding a snapshot")) {
+      return false;
+    }
+    OnDestroy leave{[]() { Py_LeaveRecursiveCall(); }};
+
+    bool const ok = Py_TYPE(obj) == immutableDictTypeObject
+        ? writeDict(obj, offset)
+        : writeList(obj, offset);
+    if (ok) {
+      records_.emplace(obj, offset);
+      if (index_) {
+        added_.emplace_back(containerDigest(obj), offset);
+      }
+    }
+    return ok;
+  }
+
+ private:
+  struct DictEntry {
+    Sha1Hash keyHash;
+    uint64_t key;
+    uint64_t value;
+  };
+
+  uint64_t position() const {
+    return base_ + out_.size();
+  }
+
+  PyObjectRef bytes() const {
+    return PyObjectRef{PyBytes_FromStringAndSize(out_.data(), out_.size()),
+                       false};
+  }
+
+  bool writeValue(PyObject* obj, uint64_t& offset);
+
+  bool writeList(PyObject* list, uint64_t& offset) {
+    std::vector<uint64_t> values;
+    if (!forEachImmutableListItem(list, [&](PyObject* value) {
+          uint64_t value_offset;
+          if (!writeValue(value, value_offset)) {
+            return false;
+          }
+          values.push_back(value_offset);
+          return true;
+        })) {
+      return false;
+    }
+
+    offset = position();
+    writeTag(snapshot_tag::kList);
+    writeFixed(values.size());
+    for (uint64_t const value_offset : values) {
+      writeFixed(value_offset);
+    }
+    return true;
+  }
+
+  bool writeDict(PyObject* dict, uint64_t& offset) {
+    std::vector<DictEntry> entries;
+    if (!forEachImmutableDictItem(
+            dict,
+            [&](Sha1Hash const& key_hash, PyObject* key, PyObject* value) {
+              DictEntry entry{key_hash, 0, 0};
+              if (!writeValue(key, entry.key) ||
+                  !writeValue(value, entry.value)) {
+                return false;
+              }
+              entries.push_back(entry);
+              return true;
+            })) {
+      return false;
+    }
+    std::sort(
+        entries.begin(),
+        entries.end(),
+        [](DictEntry const& a, DictEntry const& b) {
+          return a.keyHash < b.keyHash;
+        });
+
+    offset = position();
+    writeTag(snapshot_tag::kDict);
+    writeFixed(entries.size());
+    for (auto const& entry : entries) {
+      writeBytes(entry.keyHash.data(), entry.keyHash.size());
+      writeFixed(entry.key);
+      writeFixed(entry.value);
+    }
+    return true;
+  }
+
+  // offsets of the records of all containers written so far, which are kept
+  // alive by the object being serialized
+  std::unordered_map<PyObject*, uint64_t> records_;
+  // offsets of all other values written so far, by their encoding
+  std::unordered_map<std::string, uint64_t> values_;
+  SnapshotIndex* const index_;
+  uint64_t const base_;
+  // the offset of the first record
+  uint64_t const start_;
+  // the containers written that are not in `index_` yet
+  std::vector<std::pair<Sha1Hash, uint64_t>> added_;
+};
+
+// Encodes a single value that is not a container, writing the records of all
+// containers within it to the snapshot first.
+class ValueWriter : public BinaryWriter {
+ public:
+  explicit ValueWriter(SnapshotWriter& snapshot)
+      : BinaryWriter(std::string{}), snapshot_(snapshot) {}
+
+ protected:
+  bool writeContainer(PyObject* obj) override {
+    uint64_t offset;
+    if (!snapshot_.writeRecord(obj, offset)) {
+      return false;
+    }
+    writeTag(snapshot_tag::kReference);
+    writeFixed(offset);
+    return true;
+  }
+
+ private:
+  SnapshotWriter& snapshot_;
+};
+
+bool SnapshotWriter::writeValue(PyObject* obj, uint64_t& offset) {
+  if (isContainer(obj)) {
+    return writeRecord(obj, offset);
+  }
+
+  ValueWriter writer{*this};
+  if (!writer.write(obj)) {
+    return false;
+  }
+  auto const [it, inserted] = values_.emplace(writer.out(), position());
+  if (inserted) {
+    writeBytes(writer.out().data(), writer.out().size());
+  }
+  offset = it->second;
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Reading
+
+// A snapshot in a buffer, which is released when the last object referring to
+// the snapshot is gone.
+struct SnapshotData {
+  Py_buffer view;
+  char const* begin;
+  // the end of the records, where the offset of the root record starts
+  char const* end;
+  std::size_t recordsBegin;
+
+  explicit SnapshotData(Py_buffer const& view) : view(view) {}
+  SnapshotData(SnapshotData const&) = delete;
+  SnapshotData& operator=(SnapshotData const&) = delete;
+
+  ~SnapshotData() {
+    PyBuffer_Release(&view);
+  }
+};
+
+// Decodes values from a snapshot. Containers are returned as SnapshotDict or
+// SnapshotList objects, or, if `materialize` is set, as ImmutableDict or
+// ImmutableList objects. Containers within tuples are always materialized.
+class SnapshotReader : public BinaryReader {
+ public:
+  SnapshotReader(std::shared_ptr<SnapshotData const> data, bool materialize)
+      : BinaryReader(data->begin, data->end),
+        data_(std::move(data)),
+        materialize_(materialize) {}
+
+  // Decodes the value at `offset`, which must come before `limit`.
+  PyObjectRef readAt(uint64_t offset, uint64_t limit) {
+    if (offset < data_->recordsBegin || offset >= limit) {
+      return invalidOffset(offset);
+    }
+    char const* const saved_pos = pos_;
+    char const* const saved_value = value_;
+    pos_ = value_ = begin_ + offset;
+    PyObjectRef value = readValue();
+    pos_ = saved_pos;
+    value_ = saved_value;
+    return value;
+  }
+
+  PyObjectRef openRecord(uint64_t offset);
+  PyObjectRef materialize(uint64_t offset);
+
+ protected:
+  PyObjectRef readContainer(char tag, char const* start) override {
+    uint64_t const offset = start - begin_;
+    switch (tag) {
+      case snapshot_tag::kList:
+      case snapshot_tag::kDict:
+        if (start != value_) {
+          // containers only occur within tuples as references
+          break;
+        }
+        return materialize_ ? materialize(offset) : openRecord(offset);
+      case snapshot_tag::kReference: {
+        uint64_t target;
+        if (!readFixed(target)) {
+          return nullptr;
+        }
+        // the whole tuple must come after the container
+        if (target >= static_cast<uint64_t>(value_ - begin_)) {
+          return error("Invalid reference", start);
+        }
+        return materialize_
+            ? materialize(target)
+            : SnapshotReader{data_, true}.materialize(target);
+      }
+    }
+    return error("Unknown tag", start);
+  }
+
+ private:
+  PyObjectRef invalidOffset(uint64_t offset) {
+    auto const size = static_cast<uint64_t>(end_ - begin_);
+    return error("Invalid offset", begin_ + std::min(offset, size));
+  }
+
+  // Checks the record at `offset`, and returns its tag, its number of entries
+  // and the start of its entries.
+  bool parseRecord(
+      uint64_t offset,
+      char& tag,
+      std::size_t& count,
+      char const*& entries) {
+    if (offset < data_->recordsBegin ||
+        offset >= static_cast<uint64_t>(end_ - begin_)) {
+      invalidOffset(offset);
+      return false;
+    }
+    char const* const start = begin_ + offset;
+    tag = *start;
+    if (tag != snapshot_tag::kList && tag != snapshot_tag::kDict) {
+      error("Expecting container", start);
+      return false;
+    }
+    std::size_t const available = end_ - start - 1;
+    std::size_t const entry_size =
+        tag == snapshot_tag::kList ? kOffsetSize : kDictEntrySize;
+    if (available < kOffsetSize ||
+        loadFixed(start + 1) > (available - kOffsetSize) / entry_size) {
+      error("Unexpected end of data", start);
+      return false;
+    }
+    count = loadFixed(start + 1);
+    entries = start + 1 + kOffsetSize;
+    return true;
+  }
+
+  std::shared_ptr<SnapshotData const> data_;
+  bool const materialize_;
+  // the start of the value being decoded by readAt
+  char const* value_{nullptr};
+  // containers materialized so far, by the offsets of their records
+  std::unordered_map<uint64_t, PyObjectRef> containers_;
+};
+
+// Common part of SnapshotDict and SnapshotList: the entries of a record.
+struct SnapshotNode {
+  std::shared_ptr<SnapshotData const> data;
+  uint64_t offset;
+  char const* entries;
+  std::size_t size;
+
+  SnapshotNode(
+      std::shared_ptr<SnapshotData const> data,
+      uint64_t offset,
+      char const* entries,
+      std::size_t size)
+      : data(std::move(data)), offset(offset), entries(entries), size(size) {}
+
+  Py_ssize_t len() const {
+    return size;
+  }
+
+  // Decodes the value at the offset stored at `ptr`.
+  PyObjectRef decodeAt(char const* ptr) const {
+    return SnapshotReader{data, false}.readAt(loadFixed(ptr), offset);
+  }
+
+  PyObjectRef materialize(PyObject* /* unused */) const {
+    return SnapshotReader{data, true}.materialize(offset);
+  }
+};
+
+struct SnapshotDict : SnapshotNode {
+  using Wrapper = ClassWrapper<SnapshotDict>;
+  using SnapshotNode::SnapshotNode;
+
+  char const* entry(std::size_t i) const {
+    return entries + i * kDictEntrySize;
+  }
+
+  PyObjectRef keyAt(std::size_t i) const {
+    return decodeAt(entry(i) + sizeof(Sha1Hash));
+  }
+
+  PyObjectRef valueAt(std::size_t i) const {
+    return decodeAt(entry(i) + sizeof(Sha1Hash) + kOffsetSize);
+  }
+
+  // Returns the index of the entry for `key`, or `size` if there is none.
+  std::size_t find(PyObject* key) const {
+    auto const h = keyHash(key);
+    std::size_t lo = 0;
+    std::size_t hi = size;
+    while (lo < hi) {
+      std::size_t const mid = lo + (hi - lo) / 2;
+      int const cmp = std::memcmp(entry(mid), h.data(), h.size());
+      if (cmp == 0) {
+        return mid;
+      } else if (cmp < 0) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return size;
+  }
+
+  PyObjectRef getItem(PyObject* key) const {
+    std::size_t const i = find(key);
+    if (i == size) {
+      PyErr_SetObject(PyExc_KeyError, key);
+      return nullptr;
+    }
+    return valueAt(i);
+  }
+
+  int contains(PyObject* key) const {
+    return find(key) != size;
+  }
+
+  PyObjectRef get(PyObject* args) const {
+    PyObject* key;
+    PyObject* default_value = Py_None;
+    if (!PyArg_UnpackTuple(args, "get", 1, 2, &key, &default_value)) {
+      return nullptr;
+    }
+    std::size_t const i = find(key);
+    return i == size ? PyObjectRef{default_value} : valueAt(i);
+  }
+
+  template <typename F>
+  PyObjectRef makeList(F&& f) const {
+    PyObjectRef list{PyList_New(size), false};
+    if (!list) {
+      return nullptr;
+    }
+    for (std::size_t i = 0; i < size; ++i) {
+      PyObjectRef item = f(i);
+      if (!item) {
+        return nullptr;
+      }
+      PyList_SET_ITEM(list.get(), i, item.release());
+    }
+    return list;
+  }
+
+  PyObjectRef keys(PyObject* /* unused */) const {
+    return makeList([this](std::size_t i) { return keyAt(i); });
+  }
+
+  PyObjectRef values(PyObject* /* unused */) const {
+    return makeList([this](std::size_t i) { return valueAt(i); });
+  }
+
+  PyObjectRef items(PyObject* /* unused */) const {
+    return makeList([this](std::size_t i) -> PyObjectRef {
+      PyObjectRef key = keyAt(i);
+      if (!key) {
+        return nullptr;
+      }
+      PyObjectRef value = valueAt(i);
+      if (!value) {
+        return nullptr;
+      }
+      return PyObjectRef{PyTuple_Pack(2, key.get(), value.get()), false};
+    });
+  }
+
+  PyObjectRef iter() const {
+    PyObjectRef list = keys(nullptr);
+    if (!list) {
+      return nullptr;
+    }
+    return PyObjectRef{PyObject_GetIter(list.get()), false};
+  }
+};
+
+struct SnapshotList : SnapshotNode {
+  using Wrapper = ClassWrapper<SnapshotList>;
+  using SnapshotNode::SnapshotNode;
+
+  PyObjectRef getItem(Py_ssize_t idx) const {
+    if (idx < 0 || static_cast<std::size_t>(idx) >= size) {
+      PyErr_SetString(PyExc_IndexError, "index out of range");
+      return nullptr;
+    }
+    return decodeAt(entries + idx * kOffsetSize);
+  }
+};
+
+PyObjectRef SnapshotReader::openRecord(uint64_t offset) {
+  char tag;
+  std::size_t count;
+  char const* entries;
+  if (!parseRecord(offset, tag, count, entries)) {
+    return nullptr;
+  }
+  if (tag == snapshot_tag::kDict) {
+    return SnapshotDict::Wrapper::create(data_, offset, entries, count);
+  }
+  return SnapshotList::Wrapper::create(data_, offset, entries, count);
+}
+
+PyObjectRef SnapshotReader::materialize(uint64_t offset) {
+  auto const it = containers_.find(offset);
+  if (it != containers_.end()) {
+    return it->second;
+  }
+
+  char tag;
+  std::size_t count;
+  char const* entries;
+  if (!parseRecord(offset, tag, count, entries)) {
+    return nullptr;
+  }
+  if (Py_EnterRecursiveCall(" while decoding a snapshot")) {
+    return nullptr;
+  }
+  OnDestroy leave{[]() { Py_LeaveRecursiveCall(); }};
+
+  PyObjectRef result;
+  if (tag == snapshot_tag::kDict) {
+    std::vector<std::pair<PyObjectRef, PyObjectRef>> items;
+    items.reserve(count);
+    for (char const* ptr = entries + sizeof(Sha1Hash); count--;
+         ptr += kDictEntrySize) {
+      PyObjectRef key = readAt(loadFixed(ptr), offset);
+      if (!key) {
+        return nullptr;
+      }
+      PyObjectRef value = readAt(loadFixed(ptr + kOffsetSize), offset);
+      if (!value) {
+        return nullptr;
+      }
+      items.emplace_back(std::move(key), std::move(value));
+    }
+    result = makeImmutableDict(items.data(), items.size());
+  } else {
+    std::vector<PyObjectRef> values;
+    values.reserve(count);
+    for (char const* ptr = entries; count--; ptr += kOffsetSize) {
+      PyObjectRef value = readAt(loadFixed(ptr), offset);
+      if (!value) {
+        return nullptr;
+      }
+      values.push_back(std::move(value));
+    }
+    result = makeImmutableList(values.data(), values.size());
+  }
+
+  if (result) {
+    containers_.emplace(offset, result);
+  }
+  return result;
+}
+
+bool checkContainer(PyObject* obj) {
+  if (!isContainer(obj)) {
+    PyErr_Format(
+        PyExc_TypeError,
+        "Expected ImmutableDict or ImmutableList, got %.200s",
+        Py_TYPE(obj)->tp_name);
+    return false;
+  }
+  return true;
+}
+
+// Checks the header of the snapshot in the bytes-like object `obj`.
+std::shared_ptr<SnapshotData const> openSnapshot(PyObject* obj) {
+  Py_buffer view;
+  if (PyObject_GetBuffer(obj, &view, PyBUF_SIMPLE) < 0) {
+    return nullptr;
+  }
+  auto data = std::make_shared<SnapshotData>(view);
+  data->begin = static_cast<char const*>(view.buf);
+
+  std::string const header = snapshotHeader();
+  auto const len = static_cast<std::size_t>(view.len);
+  if (len < header.size() + kOffsetSize ||
+      std::memcmp(data->begin, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0) {
+    PyErr_SetString(PyExc_ValueError, "Unknown format: offset 0");
+    return nullptr;
+  }
+  if (std::memcmp(data->begin, header.data(), header.size()) != 0) {
+    PyErr_Format(
+        PyExc_ValueError,
+        "Snapshot was not written with the %s hash policy",
+        HashPolicy::name);
+    return nullptr;
+  }
+  data->end = data->begin + len - kOffsetSize;
+  data->recordsBegin = header.size();
+  return data;
+}
+
+PyObjectRef SnapshotIndex::update(PyObject* obj) {
+  auto const data = openSnapshot(obj);
+  if (!data) {
+    return nullptr;
+  }
+
+  constexpr std::size_t kEntrySize = sizeof(Sha1Hash) + kOffsetSize;
+  constexpr std::size_t kTailSize = sizeof(Sha1Hash) + 3 * kOffsetSize;
+  std::vector<std::pair<Sha1Hash, uint64_t>> entries;
+  std::vector<PyObjectRef> roots;
+
+  // walk the commit blocks from the last one to the first
+  std::size_t const begin = data->recordsBegin;
+  std::size_t end = data->end - data->begin + kOffsetSize;
+  while (end > begin) {
+    char const* const tail = data->begin + end - 3 * kOffsetSize;
+    uint64_t const count =
+        end - begin > kTailSize ? loadFixed(tail) : uint64_t(-1);
+    if (count > (end - begin - kTailSize - 1) / kEntrySize) {
+      PyErr_Format(
+          PyExc_ValueError,
+          "Invalid commit: offset %zd",
+          static_cast<Py_ssize_t>(end));
+      return nullptr;
+    }
+    std::size_t const tag = end - kTailSize - count * kEntrySize - 1;
+    uint64_t const start = loadFixed(tail + kOffsetSize);
+    if (data->begin[tag] != snapshot_tag::kCommit || start < begin ||
+        start > tag) {
+      PyErr_Format(
+          PyExc_ValueError,
+          "Invalid commit: offset %zd",
+          static_cast<Py_ssize_t>(tag));
+      return nullptr;
+    }
+
+    char const* const root_digest = tail - sizeof(Sha1Hash);
+    for (char const* ptr = data->begin + tag + 1; ptr != root_digest;
+         ptr += kEntrySize) {
+      Sha1Hash digest;
+      std::memcpy(digest.data(), ptr, digest.size());
+      uint64_t const offset = loadFixed(ptr + digest.size());
+      if (offset < start || offset >= tag) {
+        PyErr_Format(
+            PyExc_ValueError,
+            "Invalid offset: offset %zd",
+            static_cast<Py_ssize_t>(ptr - data->begin));
+        return nullptr;
+      }
+      entries.emplace_back(digest, offset);
+    }
+    roots.emplace_back(
+        PyBytes_FromStringAndSize(root_digest, sizeof(Sha1Hash)), false);
+    if (!roots.back()) {
+      return nullptr;
+    }
+    end = start;
+  }
+
+  PyObjectRef result{PyList_New(roots.size()), false};
+  if (!result) {
+    return nullptr;
+  }
+  for (std::size_t i = 0; i < roots.size(); ++i) {
+    PyList_SET_ITEM(
+        result.get(), i, roots[roots.size() - 1 - i].release());
+  }
+  offsets.insert(entries.begin(), entries.end());
+  return result;
+}
+
+PyObjectRef SnapshotIndex::merge(PyObject* other) {
+  if (Py_TYPE(other) != &Wrapper::typeObject) {
+    PyErr_Format(
+        PyExc_TypeError,
+        "Expected SnapshotIndex, got %.200s",
+        Py_TYPE(other)->tp_name);
+    return nullptr;
+  }
+
+  // copied first, since `other` may be this index
+  auto const& other_offsets = Wrapper::cast(other)->offsets;
+  std::vector<std::pair<Sha1Hash, uint64_t>> const entries(
+      other_offsets.begin(), other_offsets.end());
+  offsets.insert(entries.begin(), entries.end());
+  return none();
+}
+
+// clang-format off
+PyMethodDef SnapshotDict_methods[] = {
+    {"get",
+     SnapshotDict::Wrapper::method<&SnapshotDict::get>(),
+     METH_VARARGS,
+     docstring_SnapshotDict_get
+   },
+    {"items",
+     SnapshotDict::Wrapper::method<&SnapshotDict::items>(),
+     METH_NOARGS,
+     docstring_SnapshotDict_items
+   },
+    {"keys",
+     SnapshotDict::Wrapper::method<&SnapshotDict::keys>(),
+     METH_NOARGS,
+     docstring_SnapshotDict_keys
+   },
+    {"materialize",
+     SnapshotDict::Wrapper::method<&SnapshotDict::materialize>(),
+     METH_NOARGS,
+     docstring_SnapshotDict_materialize
+   },
+    {"values",
+     SnapshotDict::Wrapper::method<&SnapshotDict::values>(),
+     METH_NOARGS,
+     docstring_SnapshotDict_values
+   },
+    {nullptr}};
+
+PyMethodDef SnapshotList_methods[] = {
+    {"materialize",
+     SnapshotList::Wrapper::method<&SnapshotList::materialize>(),
+     METH_NOARGS,
+     docstring_SnapshotList_materialize
+   },
+    {nullptr}};
+// clang-format on
+
+PySequenceMethods SnapshotDict_sequenceMethods = {
+    .sq_contains = SnapshotDict::Wrapper::method<&SnapshotDict::contains>(),
+};
+
+PyMappingMethods SnapshotDict_mappingMethods = {
+    .mp_length = SnapshotDict::Wrapper::method<&SnapshotDict::len>(),
+    .mp_subscript = SnapshotDict::Wrapper::method<&SnapshotDict::getItem>(),
+};
+
+// clang-format off
+PyMethodDef SnapshotIndex_methods[] = {
+    {"merge",
+     SnapshotIndex::Wrapper::method<&SnapshotIndex::merge>(),
+     METH_O,
+     docstring_SnapshotIndex_merge
+   },
+    {"update",
+     SnapshotIndex::Wrapper::method<&SnapshotIndex::update>(),
+     METH_O,
+     docstring_SnapshotIndex_update
+   },
+    {nullptr}};
+// clang-format on
+
+PySequenceMethods SnapshotIndex_sequenceMethods = {
+    .sq_contains = SnapshotIndex::Wrapper::method<&SnapshotIndex::contains>(),
+};
+
+PyMappingMethods SnapshotIndex_mappingMethods = {
+    .mp_length = SnapshotIndex::Wrapper::method<&SnapshotIndex::len>(),
+    .mp_subscript = SnapshotIndex::Wrapper::method<&SnapshotIndex::getItem>(),
+};
+
+PySequenceMethods SnapshotList_sequenceMethods = {
+    .sq_length = SnapshotList::Wrapper::method<&SnapshotList::len>(),
+    .sq_item = SnapshotList::Wrapper::method<&SnapshotList::getItem>(),
+};
+
+} // namespace
+
+template <>
+PyTypeObject SnapshotDict::Wrapper::typeObject = {
+    PyVarObject_HEAD_INIT(nullptr, 0) //
+        .tp_name = "SnapshotDict",
+    .tp_as_sequence = &SnapshotDict_sequenceMethods,
+    .tp_as_mapping = &SnapshotDict_mappingMethods,
+    .tp_doc = docstring_SnapshotDict,
+    .tp_iter = SnapshotDict::Wrapper::method<&SnapshotDict::iter>(),
+    .tp_methods = SnapshotDict_methods,
+    .tp_new = &disallow_construction,
+};
+PyTypeObject* getSnapshotDictTypeObject() {
+  return SnapshotDict::Wrapper::initType();
+}
+
+template <>
+PyTypeObject SnapshotList::Wrapper::typeObject = {
+    PyVarObject_HEAD_INIT(nullptr, 0) //
+        .tp_name = "SnapshotList",
+    .tp_as_sequence = &SnapshotList_sequenceMethods,
+    .tp_doc = docstring_SnapshotList,
+    .tp_methods = SnapshotList_methods,
+    .tp_new = &disallow_construction,
+};
+PyTypeObject* getSnapshotListTypeObject() {
+  return SnapshotList::Wrapper::initType();
+}
+
+template <>
+PyTypeObject SnapshotIndex::Wrapper::typeObject = {
+    PyVarObject_HEAD_INIT(nullptr, 0) //
+        .tp_name = "SnapshotIndex",
+    .tp_as_sequence = &SnapshotIndex_sequenceMethods,
+    .tp_as_mapping = &SnapshotIndex_mappingMethods,
+    .tp_doc = docstring_SnapshotIndex,
+    .tp_methods = SnapshotIndex_methods,
+    .tp_new = mangleReturnValue<&SnapshotIndex::new_>(),
+};
+PyTypeObject* getSnapshotIndexTypeObject() {
+  return SnapshotIndex::Wrapper::initType();
+}
+
+PyObjectRef dumpsSnapshot(PyObject* obj) {
+  if (!checkContainer(obj)) {
+    return nullptr;
+  }
+  return SnapshotWriter{}.dumps(obj);
+}
+
+PyObjectRef loadSnapshot(PyObject* obj, PyObject* offset) {
+  auto data = openSnapshot(obj);
+  if (!data) {
+    return nullptr;
+  }
+
+  uint64_t root = loadFixed(data->end);
+  if (offset && offset != Py_None) {
+    Py_ssize_t const value = PyNumber_AsSsize_t(offset, PyExc_OverflowError);
+    if (value == -1 && PyErr_Occurred()) {
+      return nullptr;
+    }
+    root = value;
+  }
+  return SnapshotReader{data, false}.openRecord(root);
+}
+
+PyObjectRef commitSnapshot(PyObject* obj, PyObject* index, PyObject* size) {
+  if (!checkContainer(obj)) {
+    return nullptr;
+  }
+  if (Py_TYPE(index) != &SnapshotIndex::Wrapper::typeObject) {
+    PyErr_Format(
+        PyExc_TypeError,
+        "Expected SnapshotIndex, got %.200s",
+        Py_TYPE(index)->tp_name);
+    return nullptr;
+  }
+  Py_ssize_t const value = PyNumber_AsSsize_t(size, PyExc_OverflowError);
+  if (value == -1 && PyErr_Occurred()) {
+    return nullptr;
+  }
+  if (value < 0) {
+    PyErr_SetString(PyExc_ValueError, "size must not be negative");
+    return nullptr;
+  }
+  return SnapshotWriter{SnapshotIndex::Wrapper::cast(index),
+                        static_cast<uint64_t>(value)}
+      .commit(obj);
+}
+
+} // namespace pyimmutable
@@ -0,0 +1,92 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <Python.h>
+
+#include "PyObjectRef.h"
+
+namespace pyimmutable {
+
+// Snapshots are an encoding of ImmutableDict/ImmutableList trees that can be
+// used in place, typically from a memory-mapped file: containers are decoded
+// only when they are accessed, and each container is stored only once.
+//
+// A snapshot consists of kSnapshotMagic, one byte giving the length of the
+// name of the hash policy, that name, a sequence of records, and finally the
+// offset of the root container. All offsets are counted from the start of the
+// snapshot, and stored as 8-byte little-endian integers. Each record is
+// either a value encoded as described in Binary.h, or one of
+//
+//   'L' <count> <count value offsets>
+//   'D' <count> <count (key hash, key offset, value offset)>
+//   'R' <container offset>
+//
+// Dictionary entries are sorted by the bytes of the key hash, which makes keys
+// hash policy dependent. 'L' and 'D' records are containers, which are
+// referred to by offset wherever they appear as a value, except within tuples,
+// which use 'R' instead. Records only refer to records that come before them.
+//
+// A snapshot store is a snapshot that further snapshots have been appended to,
+// each consisting of the records of the containers that were not in the store
+// yet, followed by a commit block
+//
+//   'C' <count (digest, offset)> <root digest> <count> <start> <root offset>
+//
+// which lists the new containers by digest, and gives the offset at which the
+// records of the commit start. The last eight bytes of a store are thus the
+// offset of the root container of the last commit, as in any snapshot.
+
+inline constexpr char kSnapshotMagic[] = {'P', 'Y', 'I', 'S', '\x01'};
+
+namespace snapshot_tag {
+inline constexpr char kList = 'L';
+inline constexpr char kDict = 'D';
+inline constexpr char kReference = 'R';
+inline constexpr char kCommit = 'C';
+} // namespace snapshot_tag
+
+PyTypeObject* getSnapshotDictTypeObject();
+PyTypeObject* getSnapshotListTypeObject();
+
+// Returns the snapshot of `obj`, which must be an ImmutableDict or an
+// ImmutableList, as a bytes object.
+PyObjectRef dumpsSnapshot(PyObject* obj);
+
+// Returns a SnapshotDict or SnapshotList for the container at `offset` in the
+// snapshot in the bytes-like object `data`, or for its root container if
+// `offset` is None. `data` is kept alive (and locked) as long as any objects
+// for its containers exist.
+PyObjectRef loadSnapshot(PyObject* data, PyObject* offset);
+
+PyTypeObject* getSnapshotIndexTypeObject();
+
+// Returns a tuple of the data to append to the snapshot store of size `size`
+// described by the SnapshotIndex `index` to commit `obj`, and a new
+// SnapshotIndex of the containers written. `index` itself is not changed. An
+// empty store starts with the snapshot header.
+PyObjectRef commitSnapshot(PyObject* obj, PyObject* index, PyObject* size);
+
+} // namespace pyimmutable
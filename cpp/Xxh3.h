@@ -0,0 +1,67 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) Sven Over <sp@cedenti.st>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+#define XXH_STATIC_LINKING_ONLY
+#include <xxhash.h>
+
+namespace xxh3 {
+
+using Hash = std::array<uint8_t, 16>;
+
+// Incremental XXH3-128 (from libxxhash) with the same interface as
+// sha1::Context.
+class Context {
+ public:
+  Context() {
+    XXH3_128bits_reset(&state_);
+  }
+
+  Context& operator()(void const* data, std::size_t len) {
+    XXH3_128bits_update(&state_, data, len);
+    return *this;
+  }
+
+  Hash final() const {
+    XXH128_canonical_t canonical;
+    XXH128_canonicalFromHash(&canonical, XXH3_128bits_digest(&state_));
+
+    Hash result;
+    std::copy(
+        std::begin(canonical.digest),
+        std::end(canonical.digest),
+        result.begin());
+    return result;
+  }
+
+ private:
+  XXH3_state_t state_;
+};
+
+} // namespace xxh3
@@ -22,6 +22,52 @@ _pyimmutable_ImmutableDict__get_instance_count(void *null, PyObject *Py_UNUSED(i
     return _pyimmutable_ImmutableDict__get_instance_count_impl();
 }
 
+PyDoc_STRVAR(_pyimmutable_ImmutableDict_apply_patch__doc__,
+"apply_patch($self, patch, /)\n"
+"--\n"
+"\n"
+"Return a copy with the changes of ``patch`` applied.\n"
+"\n"
+"``patch`` is an iterable of ``(path, op, value)`` tuples, as returned\n"
+"by ``diff`` and ``deep_diff``. ``\"add\"`` and ``\"change\"`` entries set\n"
+"the element at ``path`` to ``value``, like ``set_in``, with ``\"add\"``\n"
+"inserting into ``ImmutableList`` objects. ``\"remove\"`` entries discard\n"
+"the element at ``path``, like ``discard_in``.\n"
+"\n"
+"All entries are applied in one pass, creating only the final versions\n"
+"of the modified containers.");
+
+#define _PYIMMUTABLE_IMMUTABLEDICT_APPLY_PATCH_METHODDEF    \
+    {"apply_patch", (PyCFunction)_pyimmutable_ImmutableDict_apply_patch, METH_O, _pyimmutable_ImmutableDict_apply_patch__doc__},
+
+PyDoc_STRVAR(_pyimmutable_ImmutableDict_deep_diff__doc__,
+"deep_diff($self, other, /)\n"
+"--\n"
+"\n"
+"Return the differences to ``other``, comparing nested containers.\n"
+"\n"
+"Like ``diff``, but values that are both ``ImmutableDict`` or both\n"
+"``ImmutableList`` objects are compared recursively. Instead of such a\n"
+"value as a whole, the differences within it are reported, with paths\n"
+"leading through it.");
+
+#define _PYIMMUTABLE_IMMUTABLEDICT_DEEP_DIFF_METHODDEF    \
+    {"deep_diff", (PyCFunction)_pyimmutable_ImmutableDict_deep_diff, METH_O, _pyimmutable_ImmutableDict_deep_diff__doc__},
+
+PyDoc_STRVAR(_pyimmutable_ImmutableDict_diff__doc__,
+"diff($self, other, /)\n"
+"--\n"
+"\n"
+"Return the differences to ``other`` as ``(path, op, value)`` tuples.\n"
+"\n"
+"Each ``path`` is a tuple holding a single key. ``op`` is ``\"add\"``,\n"
+"``\"remove\"`` or ``\"change\"``, and ``value`` is the added, removed or\n"
+"new value. Subtrees shared by both dictionaries are skipped without\n"
+"being visited.");
+
+#define _PYIMMUTABLE_IMMUTABLEDICT_DIFF_METHODDEF    \
+    {"diff", (PyCFunction)_pyimmutable_ImmutableDict_diff, METH_O, _pyimmutable_ImmutableDict_diff__doc__},
+
 PyDoc_STRVAR(_pyimmutable_ImmutableDict_discard__doc__,
 "discard($self, key, /)\n"
 "--\n"
@@ -33,6 +79,35 @@ PyDoc_STRVAR(_pyimmutable_ImmutableDict_discard__doc__,
 #define _PYIMMUTABLE_IMMUTABLEDICT_DISCARD_METHODDEF    \
     {"discard", (PyCFunction)_pyimmutable_ImmutableDict_discard, METH_O, _pyimmutable_ImmutableDict_discard__doc__},
 
+PyDoc_STRVAR(_pyimmutable_ImmutableDict_discard_in__doc__,
+"discard_in($self, path, /)\n"
+"--\n"
+"\n"
+"Return a copy without the element at ``path``.\n"
+"\n"
+"Returns ``self`` if there is no such element.");
+
+#define _PYIMMUTABLE_IMMUTABLEDICT_DISCARD_IN_METHODDEF    \
+    {"discard_in", (PyCFunction)_pyimmutable_ImmutableDict_discard_in, METH_O, _pyimmutable_ImmutableDict_discard_in__doc__},
+
+PyDoc_STRVAR(_pyimmutable_ImmutableDict_evolver__doc__,
+"evolver($self, /)\n"
+"--\n"
+"\n"
+"Return an ``ImmutableDictEvolver`` for applying a batch of changes to a copy.");
+
+#define _PYIMMUTABLE_IMMUTABLEDICT_EVOLVER_METHODDEF    \
+    {"evolver", (PyCFunction)_pyimmutable_ImmutableDict_evolver, METH_NOARGS, _pyimmutable_ImmutableDict_evolver__doc__},
+
+static PyObject *
+_pyimmutable_ImmutableDict_evolver_impl(pyimmutable::ImmutableDict::Wrapper*self);
+
+static PyObject *
+_pyimmutable_ImmutableDict_evolver(pyimmutable::ImmutableDict::Wrapper*self, PyObject *Py_UNUSED(ignored))
+{
+    return _pyimmutable_ImmutableDict_evolver_impl(self);
+}
+
 PyDoc_STRVAR(_pyimmutable_ImmutableDict_get__doc__,
 "get($self, key, default=None, /)\n"
 "--\n"
@@ -40,20 +115,20 @@ PyDoc_STRVAR(_pyimmutable_ImmutableDict_get__doc__,
 "Return the value for ``key`` if ``key`` is in the dictionary, else ``default``.");
 
 #define _PYIMMUTABLE_IMMUTABLEDICT_GET_METHODDEF    \
-    {"get", (PyCFunction)_pyimmutable_ImmutableDict_get, METH_FASTCALL, _pyimmutable_ImmutableDict_get__doc__},
+    {"get", (PyCFunction)_pyimmutable_ImmutableDict_get, METH_VARARGS, _pyimmutable_ImmutableDict_get__doc__},
 
 static PyObject *
 _pyimmutable_ImmutableDict_get_impl(pyimmutable::ImmutableDict::Wrapper*self,
                                     PyObject *key, PyObject *default_value);
 
 static PyObject *
-_pyimmutable_ImmutableDict_get(pyimmutable::ImmutableDict::Wrapper*self, PyObject *const *args, Py_ssize_t nargs)
+_pyimmutable_ImmutableDict_get(pyimmutable::ImmutableDict::Wrapper*self, PyObject *args)
 {
     PyObject *return_value = NULL;
     PyObject *key;
     PyObject *default_value = Py_None;
 
-    if (!_PyArg_UnpackStack(args, nargs, "get",
+    if (!PyArg_UnpackTuple(args, "get",
         1, 2,
         &key, &default_value)) {
         goto exit;
@@ -64,6 +139,40 @@ exit:
     return return_value;
 }
 
+PyDoc_STRVAR(_pyimmutable_ImmutableDict_get_in__doc__,
+"get_in($self, path, default=None, /)\n"
+"--\n"
+"\n"
+"Return the element at ``path``, or ``default`` if there is none.\n"
+"\n"
+"``path`` is a sequence of keys and indices, leading through nested\n"
+"``ImmutableDict`` and ``ImmutableList`` objects.");
+
+#define _PYIMMUTABLE_IMMUTABLEDICT_GET_IN_METHODDEF    \
+    {"get_in", (PyCFunction)_pyimmutable_ImmutableDict_get_in, METH_VARARGS, _pyimmutable_ImmutableDict_get_in__doc__},
+
+static PyObject *
+_pyimmutable_ImmutableDict_get_in_impl(pyimmutable::ImmutableDict::Wrapper*self,
+                                       PyObject *path, PyObject *default_value);
+
+static PyObject *
+_pyimmutable_ImmutableDict_get_in(pyimmutable::ImmutableDict::Wrapper*self, PyObject *args)
+{
+    PyObject *return_value = NULL;
+    PyObject *path;
+    PyObject *default_value = Py_None;
+
+    if (!PyArg_UnpackTuple(args, "get_in",
+        1, 2,
+        &path, &default_value)) {
+        goto exit;
+    }
+    return_value = _pyimmutable_ImmutableDict_get_in_impl(self, path, default_value);
+
+exit:
+    return return_value;
+}
+
 PyDoc_STRVAR(_pyimmutable_ImmutableDict_items__doc__,
 "items($self, /)\n"
 "--\n"
@@ -118,20 +227,20 @@ PyDoc_STRVAR(_pyimmutable_ImmutableDict_set__doc__,
 "Return a copy with ``key`` set to ``value``.");
 
 #define _PYIMMUTABLE_IMMUTABLEDICT_SET_METHODDEF    \
-    {"set", (PyCFunction)_pyimmutable_ImmutableDict_set, METH_FASTCALL, _pyimmutable_ImmutableDict_set__doc__},
+    {"set", (PyCFunction)_pyimmutable_ImmutableDict_set, METH_VARARGS, _pyimmutable_ImmutableDict_set__doc__},
 
 static PyObject *
 _pyimmutable_ImmutableDict_set_impl(pyimmutable::ImmutableDict::Wrapper*self,
                                     PyObject *key, PyObject *value);
 
 static PyObject *
-_pyimmutable_ImmutableDict_set(pyimmutable::ImmutableDict::Wrapper*self, PyObject *const *args, Py_ssize_t nargs)
+_pyimmutable_ImmutableDict_set(pyimmutable::ImmutableDict::Wrapper*self, PyObject *args)
 {
     PyObject *return_value = NULL;
     PyObject *key;
     PyObject *value;
 
-    if (!_PyArg_UnpackStack(args, nargs, "set",
+    if (!PyArg_UnpackTuple(args, "set",
         2, 2,
         &key, &value)) {
         goto exit;
@@ -142,6 +251,73 @@ exit:
     return return_value;
 }
 
+PyDoc_STRVAR(_pyimmutable_ImmutableDict_set_in__doc__,
+"set_in($self, path, value, /)\n"
+"--\n"
+"\n"
+"Return a copy with the element at ``path`` set to ``value``.\n"
+"\n"
+"Keys missing along ``path`` are added, with empty ``ImmutableDict`` values.\n"
+"Raises ``IndexError`` if an index along ``path`` is out of range.");
+
+#define _PYIMMUTABLE_IMMUTABLEDICT_SET_IN_METHODDEF    \
+    {"set_in", (PyCFunction)_pyimmutable_ImmutableDict_set_in, METH_VARARGS, _pyimmutable_ImmutableDict_set_in__doc__},
+
+static PyObject *
+_pyimmutable_ImmutableDict_set_in_impl(pyimmutable::ImmutableDict::Wrapper*self,
+                                       PyObject *path, PyObject *value);
+
+static PyObject *
+_pyimmutable_ImmutableDict_set_in(pyimmutable::ImmutableDict::Wrapper*self, PyObject *args)
+{
+    PyObject *return_value = NULL;
+    PyObject *path;
+    PyObject *value;
+
+    if (!PyArg_UnpackTuple(args, "set_in",
+        2, 2,
+        &path, &value)) {
+        goto exit;
+    }
+    return_value = _pyimmutable_ImmutableDict_set_in_impl(self, path, value);
+
+exit:
+    return return_value;
+}
+
+PyDoc_STRVAR(_pyimmutable_ImmutableDict_update_in__doc__,
+"update_in($self, path, function, /)\n"
+"--\n"
+"\n"
+"Return a copy with the element at ``path`` replaced by ``function(element)``.\n"
+"\n"
+"Raises ``KeyError`` or ``IndexError`` if there is no such element.");
+
+#define _PYIMMUTABLE_IMMUTABLEDICT_UPDATE_IN_METHODDEF    \
+    {"update_in", (PyCFunction)_pyimmutable_ImmutableDict_update_in, METH_VARARGS, _pyimmutable_ImmutableDict_update_in__doc__},
+
+static PyObject *
+_pyimmutable_ImmutableDict_update_in_impl(pyimmutable::ImmutableDict::Wrapper*self,
+                                          PyObject *path, PyObject *function);
+
+static PyObject *
+_pyimmutable_ImmutableDict_update_in(pyimmutable::ImmutableDict::Wrapper*self, PyObject *args)
+{
+    PyObject *return_value = NULL;
+    PyObject *path;
+    PyObject *function;
+
+    if (!PyArg_UnpackTuple(args, "update_in",
+        2, 2,
+        &path, &function)) {
+        goto exit;
+    }
+    return_value = _pyimmutable_ImmutableDict_update_in_impl(self, path, function);
+
+exit:
+    return return_value;
+}
+
 PyDoc_STRVAR(_pyimmutable_ImmutableDict_values__doc__,
 "values($self, /)\n"
 "--\n"
@@ -159,4 +335,4 @@ _pyimmutable_ImmutableDict_values(pyimmutable::ImmutableDict::Wrapper*self, PyOb
 {
     return _pyimmutable_ImmutableDict_values_impl(self);
 }
-/*[clinic end generated code: output=1758767da8748747 input=a9049054013a1b77]*/
+/*[clinic end generated code: output=37a909a33401b2c6 input=a9049054013a1b77]*/
@@ -49,6 +49,24 @@ PyDoc_STRVAR(_pyimmutable_ImmutableList_append__doc__,
 #define _PYIMMUTABLE_IMMUTABLELIST_APPEND_METHODDEF    \
     {"append", (PyCFunction)_pyimmutable_ImmutableList_append, METH_O, _pyimmutable_ImmutableList_append__doc__},
 
+PyDoc_STRVAR(_pyimmutable_ImmutableList_apply_patch__doc__,
+"apply_patch($self, patch, /)\n"
+"--\n"
+"\n"
+"Return a copy with the changes of ``patch`` applied.\n"
+"\n"
+"``patch`` is an iterable of ``(path, op, value)`` tuples, as returned\n"
+"by ``diff`` and ``deep_diff``. ``\"add\"`` and ``\"change\"`` entries set\n"
+"the element at ``path`` to ``value``, like ``set_in``, with ``\"add\"``\n"
+"inserting into ``ImmutableList`` objects. ``\"remove\"`` entries discard\n"
+"the element at ``path``, like ``discard_in``.\n"
+"\n"
+"All entries are applied in one pass, creating only the final versions\n"
+"of the modified containers.");
+
+#define _PYIMMUTABLE_IMMUTABLELIST_APPLY_PATCH_METHODDEF    \
+    {"apply_patch", (PyCFunction)_pyimmutable_ImmutableList_apply_patch, METH_O, _pyimmutable_ImmutableList_apply_patch__doc__},
+
 PyDoc_STRVAR(_pyimmutable_ImmutableList_count__doc__,
 "count($self, value, /)\n"
 "--\n"
@@ -58,6 +76,126 @@ PyDoc_STRVAR(_pyimmutable_ImmutableList_count__doc__,
 #define _PYIMMUTABLE_IMMUTABLELIST_COUNT_METHODDEF    \
     {"count", (PyCFunction)_pyimmutable_ImmutableList_count, METH_O, _pyimmutable_ImmutableList_count__doc__},
 
+PyDoc_STRVAR(_pyimmutable_ImmutableList_deep_diff__doc__,
+"deep_diff($self, other, /)\n"
+"--\n"
+"\n"
+"Return the differences to ``other``, comparing nested containers.\n"
+"\n"
+"Like ``diff``, but values that are both ``ImmutableDict`` or both\n"
+"``ImmutableList`` objects are compared recursively. Instead of such a\n"
+"value as a whole, the differences within it are reported, with paths\n"
+"leading through it.");
+
+#define _PYIMMUTABLE_IMMUTABLELIST_DEEP_DIFF_METHODDEF    \
+    {"deep_diff", (PyCFunction)_pyimmutable_ImmutableList_deep_diff, METH_O, _pyimmutable_ImmutableList_deep_diff__doc__},
+
+PyDoc_STRVAR(_pyimmutable_ImmutableList_delete__doc__,
+"delete($self, index, /)\n"
+"--\n"
+"\n"
+"Return a copy with item ``index`` removed.\n"
+"\n"
+"Raises ``IndexError`` if ``index`` is outside the range of existing elements.");
+
+#define _PYIMMUTABLE_IMMUTABLELIST_DELETE_METHODDEF    \
+    {"delete", (PyCFunction)_pyimmutable_ImmutableList_delete, METH_O, _pyimmutable_ImmutableList_delete__doc__},
+
+static PyObject *
+_pyimmutable_ImmutableList_delete_impl(pyimmutable::ImmutableList::Wrapper*self,
+                                       Py_ssize_t index);
+
+static PyObject *
+_pyimmutable_ImmutableList_delete(pyimmutable::ImmutableList::Wrapper*self, PyObject *arg)
+{
+    PyObject *return_value = NULL;
+    Py_ssize_t index;
+
+    if (!PyArg_Parse(arg, "n:delete", &index)) {
+        goto exit;
+    }
+    return_value = _pyimmutable_ImmutableList_delete_impl(self, index);
+
+exit:
+    return return_value;
+}
+
+PyDoc_STRVAR(_pyimmutable_ImmutableList_diff__doc__,
+"diff($self, other, /)\n"
+"--\n"
+"\n"
+"Return the differences to ``other`` as ``(path, op, value)`` tuples.\n"
+"\n"
+"Each ``path`` is a tuple holding a single index. ``op`` is ``\"add\"``,\n"
+"``\"remove\"`` or ``\"change\"``, and ``value`` is the added, removed or\n"
+"new value. Elements added at the end are reported in ascending order,\n"
+"elements removed from the end in descending order after all other\n"
+"entries, so that the entries can be applied one after the other.\n"
+"\n"
+"Elements are compared by position. Parts of the tree that both lists\n"
+"share are skipped, but the cost still grows with the length of the\n"
+"lists, not only with the number of differences.");
+
+#define _PYIMMUTABLE_IMMUTABLELIST_DIFF_METHODDEF    \
+    {"diff", (PyCFunction)_pyimmutable_ImmutableList_diff, METH_O, _pyimmutable_ImmutableList_diff__doc__},
+
+PyDoc_STRVAR(_pyimmutable_ImmutableList_discard_in__doc__,
+"discard_in($self, path, /)\n"
+"--\n"
+"\n"
+"Return a copy without the element at ``path``.\n"
+"\n"
+"Returns ``self`` if there is no such element.");
+
+#define _PYIMMUTABLE_IMMUTABLELIST_DISCARD_IN_METHODDEF    \
+    {"discard_in", (PyCFunction)_pyimmutable_ImmutableList_discard_in, METH_O, _pyimmutable_ImmutableList_discard_in__doc__},
+
+PyDoc_STRVAR(_pyimmutable_ImmutableList_drop__doc__,
+"drop($self, count, /)\n"
+"--\n"
+"\n"
+"Return a copy without the first ``count`` elements.");
+
+#define _PYIMMUTABLE_IMMUTABLELIST_DROP_METHODDEF    \
+    {"drop", (PyCFunction)_pyimmutable_ImmutableList_drop, METH_O, _pyimmutable_ImmutableList_drop__doc__},
+
+static PyObject *
+_pyimmutable_ImmutableList_drop_impl(pyimmutable::ImmutableList::Wrapper*self,
+                                     Py_ssize_t count);
+
+static PyObject *
+_pyimmutable_ImmutableList_drop(pyimmutable::ImmutableList::Wrapper*self, PyObject *arg)
+{
+    PyObject *return_value = NULL;
+    Py_ssize_t count;
+
+    if (!PyArg_Parse(arg, "n:drop", &count)) {
+        goto exit;
+    }
+    return_value = _pyimmutable_ImmutableList_drop_impl(self, count);
+
+exit:
+    return return_value;
+}
+
+PyDoc_STRVAR(_pyimmutable_ImmutableList_evolver__doc__,
+"evolver($self, /)\n"
+"--\n"
+"\n"
+"Return an ``ImmutableListEvolver`` for applying a batch of changes to a copy.");
+
+#define _PYIMMUTABLE_IMMUTABLELIST_EVOLVER_METHODDEF    \
+    {"evolver", (PyCFunction)_pyimmutable_ImmutableList_evolver, METH_NOARGS, _pyimmutable_ImmutableList_evolver__doc__},
+
+static PyObject *
+_pyimmutable_ImmutableList_evolver_impl(pyimmutable::ImmutableList::Wrapper*self);
+
+static PyObject *
+_pyimmutable_ImmutableList_evolver(pyimmutable::ImmutableList::Wrapper*self, PyObject *Py_UNUSED(ignored))
+{
+    return _pyimmutable_ImmutableList_evolver_impl(self);
+}
+
 PyDoc_STRVAR(_pyimmutable_ImmutableList_extend__doc__,
 "extend($self, iterable, /)\n"
 "--\n"
@@ -67,6 +205,40 @@ PyDoc_STRVAR(_pyimmutable_ImmutableList_extend__doc__,
 #define _PYIMMUTABLE_IMMUTABLELIST_EXTEND_METHODDEF    \
     {"extend", (PyCFunction)_pyimmutable_ImmutableList_extend, METH_O, _pyimmutable_ImmutableList_extend__doc__},
 
+PyDoc_STRVAR(_pyimmutable_ImmutableList_get_in__doc__,
+"get_in($self, path, default=None, /)\n"
+"--\n"
+"\n"
+"Return the element at ``path``, or ``default`` if there is none.\n"
+"\n"
+"``path`` is a sequence of keys and indices, leading through nested\n"
+"``ImmutableDict`` and ``ImmutableList`` objects.");
+
+#define _PYIMMUTABLE_IMMUTABLELIST_GET_IN_METHODDEF    \
+    {"get_in", (PyCFunction)_pyimmutable_ImmutableList_get_in, METH_VARARGS, _pyimmutable_ImmutableList_get_in__doc__},
+
+static PyObject *
+_pyimmutable_ImmutableList_get_in_impl(pyimmutable::ImmutableList::Wrapper*self,
+                                       PyObject *path, PyObject *default_value);
+
+static PyObject *
+_pyimmutable_ImmutableList_get_in(pyimmutable::ImmutableList::Wrapper*self, PyObject *args)
+{
+    PyObject *return_value = NULL;
+    PyObject *path;
+    PyObject *default_value = Py_None;
+
+    if (!PyArg_UnpackTuple(args, "get_in",
+        1, 2,
+        &path, &default_value)) {
+        goto exit;
+    }
+    return_value = _pyimmutable_ImmutableList_get_in_impl(self, path, default_value);
+
+exit:
+    return return_value;
+}
+
 PyDoc_STRVAR(_pyimmutable_ImmutableList_index__doc__,
 "index($self, value, start=0, stop=sys.maxsize, /)\n"
 "--\n"
@@ -76,7 +248,7 @@ PyDoc_STRVAR(_pyimmutable_ImmutableList_index__doc__,
 "Raises ``ValueError`` if ``value`` is not present.");
 
 #define _PYIMMUTABLE_IMMUTABLELIST_INDEX_METHODDEF    \
-    {"index", (PyCFunction)_pyimmutable_ImmutableList_index, METH_FASTCALL, _pyimmutable_ImmutableList_index__doc__},
+    {"index", (PyCFunction)_pyimmutable_ImmutableList_index, METH_VARARGS, _pyimmutable_ImmutableList_index__doc__},
 
 static PyObject *
 _pyimmutable_ImmutableList_index_impl(pyimmutable::ImmutableList::Wrapper*self,
@@ -84,14 +256,14 @@ _pyimmutable_ImmutableList_index_impl(pyimmutable::ImmutableList::Wrapper*self,
                                       Py_ssize_t stop);
 
 static PyObject *
-_pyimmutable_ImmutableList_index(pyimmutable::ImmutableList::Wrapper*self, PyObject *const *args, Py_ssize_t nargs)
+_pyimmutable_ImmutableList_index(pyimmutable::ImmutableList::Wrapper*self, PyObject *args)
 {
     PyObject *return_value = NULL;
     PyObject *value;
     Py_ssize_t start = 0;
     Py_ssize_t stop = PY_SSIZE_T_MAX;
 
-    if (!_PyArg_ParseStack(args, nargs, "O|O&O&:index",
+    if (!PyArg_ParseTuple(args, "O|O&O&:index",
         &value, _PyEval_SliceIndexNotNone, &start, _PyEval_SliceIndexNotNone, &stop)) {
         goto exit;
     }
@@ -101,6 +273,36 @@ exit:
     return return_value;
 }
 
+PyDoc_STRVAR(_pyimmutable_ImmutableList_insert__doc__,
+"insert($self, index, value, /)\n"
+"--\n"
+"\n"
+"Return a copy with ``value`` inserted before item ``index``.");
+
+#define _PYIMMUTABLE_IMMUTABLELIST_INSERT_METHODDEF    \
+    {"insert", (PyCFunction)_pyimmutable_ImmutableList_insert, METH_VARARGS, _pyimmutable_ImmutableList_insert__doc__},
+
+static PyObject *
+_pyimmutable_ImmutableList_insert_impl(pyimmutable::ImmutableList::Wrapper*self,
+                                       Py_ssize_t index, PyObject *value);
+
+static PyObject *
+_pyimmutable_ImmutableList_insert(pyimmutable::ImmutableList::Wrapper*self, PyObject *args)
+{
+    PyObject *return_value = NULL;
+    Py_ssize_t index;
+    PyObject *value;
+
+    if (!PyArg_ParseTuple(args, "nO:insert",
+        &index, &value)) {
+        goto exit;
+    }
+    return_value = _pyimmutable_ImmutableList_insert_impl(self, index, value);
+
+exit:
+    return return_value;
+}
+
 PyDoc_STRVAR(_pyimmutable_ImmutableList_set__doc__,
 "set($self, index, value, /)\n"
 "--\n"
@@ -110,20 +312,20 @@ PyDoc_STRVAR(_pyimmutable_ImmutableList_set__doc__,
 "Raises ``IndexError`` if ``index`` is outside the range of existing elements.");
 
 #define _PYIMMUTABLE_IMMUTABLELIST_SET_METHODDEF    \
-    {"set", (PyCFunction)_pyimmutable_ImmutableList_set, METH_FASTCALL, _pyimmutable_ImmutableList_set__doc__},
+    {"set", (PyCFunction)_pyimmutable_ImmutableList_set, METH_VARARGS, _pyimmutable_ImmutableList_set__doc__},
 
 static PyObject *
 _pyimmutable_ImmutableList_set_impl(pyimmutable::ImmutableList::Wrapper*self,
                                     Py_ssize_t index, PyObject *value);
 
 static PyObject *
-_pyimmutable_ImmutableList_set(pyimmutable::ImmutableList::Wrapper*self, PyObject *const *args, Py_ssize_t nargs)
+_pyimmutable_ImmutableList_set(pyimmutable::ImmutableList::Wrapper*self, PyObject *args)
 {
     PyObject *return_value = NULL;
     Py_ssize_t index;
     PyObject *value;
 
-    if (!_PyArg_ParseStack(args, nargs, "nO:set",
+    if (!PyArg_ParseTuple(args, "nO:set",
         &index, &value)) {
         goto exit;
     }
@@ -132,4 +334,105 @@ _pyimmutable_ImmutableList_set(pyimmutable::ImmutableList::Wrapper*self, PyObjec
 exit:
     return return_value;
 }
-/*[clinic end generated code: output=318b40802275b56b input=a9049054013a1b77]*/
+
+PyDoc_STRVAR(_pyimmutable_ImmutableList_set_in__doc__,
+"set_in($self, path, value, /)\n"
+"--\n"
+"\n"
+"Return a copy with the element at ``path`` set to ``value``.\n"
+"\n"
+"Keys missing along ``path`` are added, with empty ``ImmutableDict`` values.\n"
+"Raises ``IndexError`` if an index along ``path`` is out of range.");
+
+#define _PYIMMUTABLE_IMMUTABLELIST_SET_IN_METHODDEF    \
+    {"set_in", (PyCFunction)_pyimmutable_ImmutableList_set_in, METH_VARARGS, _pyimmutable_ImmutableList_set_in__doc__},
+
+static PyObject *
+_pyimmutable_ImmutableList_set_in_impl(pyimmutable::ImmutableList::Wrapper*self,
+                                       PyObject *path, PyObject *value);
+
+static PyObject *
+_pyimmutable_ImmutableList_set_in(pyimmutable::ImmutableList::Wrapper*self, PyObject *args)
+{
+    PyObject *return_value = NULL;
+    PyObject *path;
+    PyObject *value;
+
+    if (!PyArg_UnpackTuple(args, "set_in",
+        2, 2,
+        &path, &value)) {
+        goto exit;
+    }
+    return_value = _pyimmutable_ImmutableList_set_in_impl(self, path, value);
+
+exit:
+    return return_value;
+}
+
+PyDoc_STRVAR(_pyimmutable_ImmutableList_splice__doc__,
+"splice($self, start, stop, iterable, /)\n"
+"--\n"
+"\n"
+"Return a copy with items ``start`` to ``stop`` replaced by ``iterable``.\n"
+"\n"
+"This is the equivalent of ``lst[start:stop] = iterable`` for ``list``.");
+
+#define _PYIMMUTABLE_IMMUTABLELIST_SPLICE_METHODDEF    \
+    {"splice", (PyCFunction)_pyimmutable_ImmutableList_splice, METH_VARARGS, _pyimmutable_ImmutableList_splice__doc__},
+
+static PyObject *
+_pyimmutable_ImmutableList_splice_impl(pyimmutable::ImmutableList::Wrapper*self,
+                                       Py_ssize_t start, Py_ssize_t stop,
+                                       PyObject *iterable);
+
+static PyObject *
+_pyimmutable_ImmutableList_splice(pyimmutable::ImmutableList::Wrapper*self, PyObject *args)
+{
+    PyObject *return_value = NULL;
+    Py_ssize_t start;
+    Py_ssize_t stop;
+    PyObject *iterable;
+
+    if (!PyArg_ParseTuple(args, "nnO:splice",
+        &start, &stop, &iterable)) {
+        goto exit;
+    }
+    return_value = _pyimmutable_ImmutableList_splice_impl(self, start, stop, iterable);
+
+exit:
+    return return_value;
+}
+
+PyDoc_STRVAR(_pyimmutable_ImmutableList_update_in__doc__,
+"update_in($self, path, function, /)\n"
+"--\n"
+"\n"
+"Return a copy with the element at ``path`` replaced by ``function(element)``.\n"
+"\n"
+"Raises ``KeyError`` or ``IndexError`` if there is no such element.");
+
+#define _PYIMMUTABLE_IMMUTABLELIST_UPDATE_IN_METHODDEF    \
+    {"update_in", (PyCFunction)_pyimmutable_ImmutableList_update_in, METH_VARARGS, _pyimmutable_ImmutableList_update_in__doc__},
+
+static PyObject *
+_pyimmutable_ImmutableList_update_in_impl(pyimmutable::ImmutableList::Wrapper*self,
+                                          PyObject *path, PyObject *function);
+
+static PyObject *
+_pyimmutable_ImmutableList_update_in(pyimmutable::ImmutableList::Wrapper*self, PyObject *args)
+{
+    PyObject *return_value = NULL;
+    PyObject *path;
+    PyObject *function;
+
+    if (!PyArg_UnpackTuple(args, "update_in",
+        2, 2,
+        &path, &function)) {
+        goto exit;
+    }
+    return_value = _pyimmutable_ImmutableList_update_in_impl(self, path, function);
+
+exit:
+    return return_value;
+}
+/*[clinic end generated code: output=41de0df7ea193f4a input=a9049054013a1b77]*/
@@ -24,13 +24,58 @@
 
 #include <Python.h>
 
+#include "Arena.h"
+#include "Binary.h"
 #include "ClassWrapper.h"
+#include "Conversion.h"
 #include "ImmutableDict.h"
 #include "ImmutableList.h"
+#include "Json.h"
+#include "KeyHashCache.h"
 #include "PyObjectRef.h"
+#include "Sha1Hasher.h"
+#include "Snapshot.h"
+#include "docstrings.autogen.h"
 #include "util.h"
 
 static PyMethodDef methods[] = {
+    {"commit_snapshot",
+     [](PyObject*, PyObject* args) -> PyObject* {
+       PyObject* obj;
+       PyObject* index;
+       PyObject* size;
+       if (!PyArg_ParseTuple(
+               args, "OOO:commit_snapshot", &obj, &index, &size)) {
+         return nullptr;
+       }
+       return pyimmutable::commitSnapshot(obj, index, size).release();
+     },
+     METH_VARARGS,
+     docstring_commit_snapshot},
+    {"dumps_binary",
+     [](PyObject*, PyObject* obj) {
+       return pyimmutable::dumpsBinary(obj).release();
+     },
+     METH_O,
+     docstring_dumps_binary},
+    {"dumps_snapshot",
+     [](PyObject*, PyObject* obj) {
+       return pyimmutable::dumpsSnapshot(obj).release();
+     },
+     METH_O,
+     docstring_dumps_snapshot},
+    {"freeze",
+     [](PyObject*, PyObject* obj) {
+       return pyimmutable::freeze(obj).release();
+     },
+     METH_O,
+     docstring_freeze},
+    {"free_list_info",
+     [](PyObject*, PyObject*) {
+       return pyimmutable::freeListInfo().release();
+     },
+     METH_NOARGS,
+     docstring_free_list_info},
     {"isImmutableJson",
      [](PyObject*, PyObject* obj) {
        bool value = pyimmutable::isImmutableJsonObject(obj);
@@ -38,6 +83,76 @@ static PyMethodDef methods[] = {
      },
      METH_O,
      nullptr},
+    {"loads_binary",
+     [](PyObject*, PyObject* obj) {
+       return pyimmutable::loadsBinary(obj).release();
+     },
+     METH_O,
+     docstring_loads_binary},
+    {"load_snapshot",
+     [](PyObject*, PyObject* args) -> PyObject* {
+       PyObject* obj;
+       PyObject* offset = Py_None;
+       if (!PyArg_ParseTuple(args, "O|O:load_snapshot", &obj, &offset)) {
+         return nullptr;
+       }
+       return pyimmutable::loadSnapshot(obj, offset).release();
+     },
+     METH_VARARGS,
+     docstring_load_snapshot},
+    {"make_immutable",
+     [](PyObject*, PyObject* obj) {
+       return pyimmutable::makeImmutable(obj).release();
+     },
+     METH_O,
+     docstring_make_immutable},
+    {"make_mutable",
+     [](PyObject*, PyObject* obj) {
+       return pyimmutable::makeMutable(obj).release();
+     },
+     METH_O,
+     docstring_make_mutable},
+    {"parse_json",
+     [](PyObject*, PyObject* obj) {
+       return pyimmutable::parseJson(obj).release();
+     },
+     METH_O,
+     docstring_parse_json},
+    {"serialize_json",
+     [](PyObject*, PyObject* args) -> PyObject* {
+       PyObject* obj;
+       int cache_fragments = 0;
+       if (!PyArg_ParseTuple(
+               args, "O|p:serialize_json", &obj, &cache_fragments)) {
+         return nullptr;
+       }
+       return pyimmutable::serializeJson(obj, cache_fragments).release();
+     },
+     METH_VARARGS,
+     docstring_serialize_json},
+    {"set_key_hash_cache_capacity",
+     [](PyObject*, PyObject* obj) -> PyObject* {
+       Py_ssize_t const capacity = PyNumber_AsSsize_t(obj, PyExc_OverflowError);
+       if (capacity == -1 && PyErr_Occurred()) {
+         return nullptr;
+       }
+       if (capacity < 0) {
+         PyErr_SetString(PyExc_ValueError, "capacity must not be negative");
+         return nullptr;
+       }
+       if (!pyimmutable::KeyHashCache::setCapacity(capacity)) {
+         return nullptr;
+       }
+       Py_RETURN_NONE;
+     },
+     METH_O,
+     docstring_set_key_hash_cache_capacity},
+    {"key_hash_cache_info",
+     [](PyObject*, PyObject*) {
+       return pyimmutable::KeyHashCache::info().release();
+     },
+     METH_NOARGS,
+     docstring_key_hash_cache_info},
     {nullptr, nullptr, 0, nullptr}};
 
 static struct PyModuleDef module = {PyModuleDef_HEAD_INIT,
@@ -53,6 +168,8 @@ extern "C" {
 PyMODINIT_FUNC PyInit__pyimmutable(void) {
   using namespace pyimmutable;
 
+  PrecomputedHashes::init();
+
   immutableDictTypeObject = getImmutableDictTypeObject();
   if (!immutableDictTypeObject) {
     return nullptr;
@@ -73,6 +190,36 @@ PyMODINIT_FUNC PyInit__pyimmutable(void) {
     return nullptr;
   }
 
+  auto* immutable_dict_evolver_type = getImmutableDictEvolverTypeObject();
+  if (!immutable_dict_evolver_type) {
+    return nullptr;
+  }
+
+  auto* immutable_list_evolver_type = getImmutableListEvolverTypeObject();
+  if (!immutable_list_evolver_type) {
+    return nullptr;
+  }
+
+  auto* snapshot_dict_type = getSnapshotDictTypeObject();
+  if (!snapshot_dict_type) {
+    return nullptr;
+  }
+
+  auto* snapshot_list_type = getSnapshotListTypeObject();
+  if (!snapshot_list_type) {
+    return nullptr;
+  }
+
+  auto* snapshot_index_type = getSnapshotIndexTypeObject();
+  if (!snapshot_index_type) {
+    return nullptr;
+  }
+
+  auto* arena_type = getArenaTypeObject();
+  if (!arena_type) {
+    return nullptr;
+  }
+
   PyObject* m = PyModule_Create(&module);
   if (!m) {
     return nullptr;
@@ -90,6 +237,38 @@ PyMODINIT_FUNC PyInit__pyimmutable(void) {
       PyObjectRef{reinterpret_cast<PyObject*>(immutableListTypeObject)}
           .release());
 
+  PyModule_AddObject(
+      m,
+      "ImmutableDictEvolver",
+      PyObjectRef{reinterpret_cast<PyObject*>(immutable_dict_evolver_type)}
+          .release());
+
+  PyModule_AddObject(
+      m,
+      "ImmutableListEvolver",
+      PyObjectRef{reinterpret_cast<PyObject*>(immutable_list_evolver_type)}
+          .release());
+
+  PyModule_AddObject(
+      m,
+      "SnapshotDict",
+      PyObjectRef{reinterpret_cast<PyObject*>(snapshot_dict_type)}.release());
+
+  PyModule_AddObject(
+      m,
+      "SnapshotList",
+      PyObjectRef{reinterpret_cast<PyObject*>(snapshot_list_type)}.release());
+
+  PyModule_AddObject(
+      m,
+      "SnapshotIndex",
+      PyObjectRef{reinterpret_cast<PyObject*>(snapshot_index_type)}.release());
+
+  PyModule_AddObject(
+      m,
+      "Arena",
+      PyObjectRef{reinterpret_cast<PyObject*>(arena_type)}.release());
+
   return m;
 }
 }
@@ -23,6 +23,11 @@
  */
 
 #include "util.h"
+
+#include <utility>
+#include <vector>
+
+#include "ClassWrapper.h"
 #include "ImmutableDict.h"
 #include "ImmutableList.h"
 
@@ -44,6 +49,67 @@ bool isImmutableJsonObject(PyObject* obj) {
   return false;
 }
 
+namespace {
+
+std::vector<std::pair<char const*, detail::FreeList const*>>& freeLists() {
+  static std::vector<std::pair<char const*, detail::FreeList const*>> lists;
+  return lists;
+}
+
+} // namespace
+
+void registerFreeList(char const* name, detail::FreeList const* free_list) {
+  freeLists().emplace_back(name, free_list);
+}
+
+PyObjectRef freeListInfo() {
+  PyObjectRef result{PyDict_New(), false};
+  if (!result) {
+    return nullptr;
+  }
+  for (auto const& [name, free_list] : freeLists()) {
+    PyObjectRef const info = buildValue(
+        "{snsnsnsn}",
+        "capacity",
+        static_cast<Py_ssize_t>(detail::FreeList::kCapacity),
+        "size",
+        static_cast<Py_ssize_t>(free_list->size()),
+        "hits",
+        static_cast<Py_ssize_t>(free_list->hits()),
+        "misses",
+        static_cast<Py_ssize_t>(free_list->misses()));
+    if (!info || PyDict_SetItemString(result.get(), name, info.get()) < 0) {
+      return nullptr;
+    }
+  }
+  return result;
+}
+
+bool noKeywords(char const* funcname, PyObject* kwds) {
+  if (!kwds || !PyDict_GET_SIZE(kwds)) {
+    return true;
+  }
+  PyErr_Format(
+      PyExc_TypeError, "%s() takes no keyword arguments", funcname);
+  return false;
+}
+
+int lookupAttr(PyObject* obj, char const* name, PyObject** result) {
+#if PY_VERSION_HEX >= 0x030D0000
+  return PyObject_GetOptionalAttrString(obj, name, result);
+#else
+  *result = PyObject_GetAttrString(obj, name);
+  if (*result) {
+    return 1;
+  }
+  if (!PyErr_ExceptionMatches(PyExc_AttributeError)) {
+    return -1;
+  }
+  PyErr_Clear();
+  return 0;
+#endif
+}
+
 PyObject* disallow_construction(
     PyTypeObject* /*type*/,
     PyObject* /*args*/,
@@ -67,6 +67,11 @@ OnDestroy(F &&)->OnDestroy<std::decay_t<F>>;
 
 bool isImmutableJsonObject(PyObject*);
 
+// Stand-ins for _PyArg_NoKeywords and _PyObject_LookupAttrId, which are no
+// longer exported from Python 3.13 on.
+bool noKeywords(char const* funcname, PyObject* kwds);
+int lookupAttr(PyObject* obj, char const* name, PyObject** result);
+
 PyObject* disallow_construction(
     PyTypeObject* /*type*/,
     PyObject* /*args*/,
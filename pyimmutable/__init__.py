@@ -1,23 +1,61 @@
 import collections.abc
 import functools
 import json
+import mmap
+import os
 
 from _pyimmutable import (  # noqa: F401
+    Arena,
     ImmutableDict,
+    ImmutableDictEvolver,
     ImmutableList,
+    ImmutableListEvolver,
+    SnapshotDict,
+    SnapshotIndex,
+    SnapshotList,
+    commit_snapshot,
+    dumps_binary,
+    dumps_snapshot,
+    free_list_info,
+    freeze,
     isImmutableJson,
+    key_hash_cache_info,
+    load_snapshot,
+    loads_binary,
+    make_immutable,
+    make_mutable,
+    parse_json,
+    serialize_json,
+    set_key_hash_cache_capacity,
 )
 
 
 __all__ = (
+    "Arena",
     "ImmutableDict",
+    "ImmutableDictEvolver",
     "ImmutableList",
+    "ImmutableListEvolver",
+    "SnapshotDict",
+    "SnapshotIndex",
+    "SnapshotList",
+    "SnapshotStore",
+    "commit_snapshot",
+    "dumps_binary",
+    "dumps_snapshot",
+    "free_list_info",
+    "freeze",
     "json_dump",
     "json_dumps",
     "json_load",
     "json_loads",
+    "key_hash_cache_info",
+    "load_snapshot",
+    "loads_binary",
     "make_immutable",
     "make_mutable",
+    "open_snapshot",
+    "set_key_hash_cache_capacity",
 )
 
 
@@ -25,98 +63,170 @@ collections.abc.Mapping.register(ImmutableDict)
 collections.abc.Sequence.register(ImmutableList)
 
 
-def make_immutable(object):
-    """\
-Make a deep copy of nested sequences/mappings using ``list`` and ``dict``.
-
-A nested structure using ``ImmutableDict``/``ImmutableList`` objects is turned
-into an equivalent structure using ``dict`` and ``list``, e.g. for passing
-to ``json.dump``."""
-    if isinstance(object, collections.abc.Mapping):
-        return ImmutableDict(
-            (make_immutable(k), make_immutable(v)) for k, v in object.items()
-        )
-    if isinstance(object, collections.abc.Sequence) and not isinstance(
-        object, str
-    ):
-        return ImmutableList(make_immutable(i) for i in object)
-    return object
-
-
-def make_mutable(object):
-    """\
-Make a deep copy using ``ImmutableList`` and ``ImmutableDict``.
-
-A nested structure using is turned into one using ``ImmutableList`` for every
-sequence and ``ImmutableDict`` for every mapping."""
-    if isinstance(object, collections.abc.Mapping):
-        return {make_mutable(k): make_mutable(v) for k, v in object.items()}
-    if isinstance(object, collections.abc.Sequence) and not isinstance(
-        object, str
-    ):
-        return [make_mutable(i) for i in object]
-    return object
-
-
 @functools.wraps(
     json.load, assigned=set(functools.WRAPPER_ASSIGNMENTS) - {"__doc__"}
 )
-def json_load(*args, **kwargs):
+def json_load(fp, *args, **kwargs):
     """Read JSON from ``fp`` and deserialize as immutable data.
 
-This function calls ``json.load`` and then builds a (potentially nested)
-structure of ``ImmutableDict``/``ImmutableList`` objects from the returned
-object.
+This function reads the whole of ``fp`` and passes it to ``json_loads``.
 
-All arguments are passed to ``json.load``. This function may be replaced by
-an efficient, native implementation in a later version of pyimmutable, which
-may not support the same keyword arguments."""
-    return make_immutable(json.load(*args, **kwargs))
+If no further arguments are given, the document is parsed natively, building
+a (potentially nested) structure of ``ImmutableDict``/``ImmutableList``
+objects directly. Otherwise, all arguments are passed to ``json.load`` and the
+result is converted using ``make_immutable``."""
+    if args or kwargs:
+        return make_immutable(json.load(fp, *args, **kwargs))
+    return json_loads(fp.read())
 
 
 @functools.wraps(
     json.loads, assigned=set(functools.WRAPPER_ASSIGNMENTS) - {"__doc__"}
 )
-def json_loads(*args, **kwargs):
+def json_loads(s, *args, **kwargs):
     """Deserialize JSON string as immutable data.
 
-This function calls ``json.loads`` and then builds a (potentially nested)
-structure of ``ImmutableDict``/``ImmutableList`` objects from the returned
-object.
-
-All arguments are passed to ``json.loads``. This function may be replaced by
-an efficient, native implementation in a later version of pyimmutable, which
-may not support the same keyword arguments."""
-    return make_immutable(json.loads(*args, **kwargs))
+If no further arguments are given, ``s`` is parsed natively, building a
+(potentially nested) structure of ``ImmutableDict``/``ImmutableList`` objects
+directly. ``s`` may be a ``str``, ``bytes`` or ``bytearray`` object, as with
+``json.loads``.
+
+Otherwise, all arguments are passed to ``json.loads`` and the result is
+converted using ``make_immutable``."""
+    if args or kwargs:
+        return make_immutable(json.loads(s, *args, **kwargs))
+    if isinstance(s, str):
+        if s.startswith("\ufeff"):
+            raise json.JSONDecodeError(
+                "Unexpected UTF-8 BOM (decode using utf-8-sig)", s, 0
+            )
+    elif isinstance(s, (bytes, bytearray)):
+        s = s.decode(json.detect_encoding(s), "surrogatepass")
+    else:
+        raise TypeError(
+            "the JSON object must be str, bytes or bytearray, "
+            f"not {s.__class__.__name__}"
+        )
+    return parse_json(s)
 
 
 @functools.wraps(
     json.dump, assigned=set(functools.WRAPPER_ASSIGNMENTS) - {"__doc__"}
 )
-def json_dump(object, *args, **kwargs):
+def json_dump(object, fp, *args, cache_fragments=False, **kwargs):
     """Serialize `obj`` as a JSON and write to ``fp``.
 
-This function makes a deep copy of the object, replacing all sequences
-(including ``ImmutableList``) with lists and all mappings (including
-``ImmutableDict``) with dicts. The result is passed to ``json.dump``.
-
-All arguments are passed to ``json.dump``. This function may be replaced by
-an efficient, native implementation in a later version of pyimmutable, which
-may not support the same keyword arguments."""
-    return json.dump(make_mutable(object), *args, **kwargs)
+This function writes the result of ``json_dumps`` to ``fp``. See there for the
+meaning of the arguments."""
+    fp.write(
+        json_dumps(object, *args, cache_fragments=cache_fragments, **kwargs)
+    )
 
 
 @functools.wraps(
     json.dumps, assigned=set(functools.WRAPPER_ASSIGNMENTS) - {"__doc__"}
 )
-def json_dumps(object, *args, **kwargs):
+def json_dumps(object, *args, cache_fragments=False, **kwargs):
     """Serialize ``obj`` to a JSON formatted ``str``.
 
-This function makes a deep copy of the object, replacing all sequences
-(including ``ImmutableList``) with lists and all mappings (including
-``ImmutableDict``) with dicts. The result is passed to ``json.dumps``.
-
-All arguments are passed to ``json.dumps``. This function may be replaced by
-an efficient, native implementation in a later version of pyimmutable, which
-may not support the same keyword arguments."""
+If no further arguments are given, ``ImmutableDict``/``ImmutableList`` objects
+(as well as ``dict``, ``list`` and ``tuple``) are serialized natively, without
+making a mutable copy first. With ``cache_fragments=True``, the encoding of
+each ``ImmutableDict``/``ImmutableList`` that has ``isImmutableJson`` set is
+kept in that object, so that serializing it again, or serializing another
+structure that contains it, reuses that encoding. This costs additional memory
+for as long as the objects live.
+
+Otherwise, and for objects which cannot be serialized natively (e.g. other
+implementations of ``Mapping`` or ``Sequence``), this function makes a deep
+copy of the object, replacing all sequences (including ``ImmutableList``) with
+lists and all mappings (including ``ImmutableDict``) with dicts. The result is
+passed to ``json.dumps``, along with all further arguments."""
+    if not args and not kwargs:
+        try:
+            return serialize_json(object, cache_fragments)
+        except TypeError:
+            pass
     return json.dumps(make_mutable(object), *args, **kwargs)
+
+
+def open_snapshot(path):
+    """Memory-map the snapshot file at ``path`` and return a view of its root.
+
+The file is mapped read-only and passed to ``load_snapshot``. It is read only
+as far as it is accessed, and processes opening the same file share its pages
+in memory. The mapping is closed when the last view is gone."""
+    with open(path, "rb") as f:
+        return load_snapshot(
+            mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        )
+
+
+class SnapshotStore:
+    """A content-addressed store of ``ImmutableDict``/``ImmutableList`` trees.
+
+The store is a single append-only file (created if it does not exist), in
+which every container is stored once, under its ``digest``. ``commit`` writes
+only the containers that are not in the store yet, so committing a tree that
+shares most of its subtrees with earlier commits is cheap. ``checkout`` returns
+a lazy ``SnapshotDict``/``SnapshotList`` view of any container committed
+before, reading from a memory-mapped copy of the file. The file is a snapshot
+itself, so ``open_snapshot`` returns a view of the last root committed.
+
+Only one ``SnapshotStore`` at a time may commit to a file."""
+
+    def __init__(self, path):
+        # unbuffered, so that no data of a failed commit is left behind in a
+        # buffer after the file has been truncated
+        self._file = open(path, "a+b", buffering=0)
+        self._index = SnapshotIndex()
+        self._map = None
+        self._size = self._file.seek(0, os.SEEK_END)
+        self.roots = []
+        if self._size:
+            self.roots = self._index.update(self._data())
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info):
+        self.close()
+
+    def __contains__(self, digest):
+        return digest in self._index
+
+    def close(self):
+        """Close the file. Views checked out before remain usable."""
+        self._file.close()
+        self._map = None
+
+    def commit(self, root):
+        """Write ``root`` to the store, and return its digest."""
+        data, added = commit_snapshot(root, self._index, self._size)
+        try:
+            view = memoryview(data)
+            while view:
+                view = view[self._file.write(view) :]
+            os.fsync(self._file.fileno())
+        except BaseException:
+            # the records of a failed commit must not be referred to later
+            os.ftruncate(self._file.fileno(), self._size)
+            raise
+        self._index.merge(added)
+        self._size += len(data)
+        self.roots.append(root.digest)
+        return root.digest
+
+    def checkout(self, digest):
+        """Return a view of the container with ``digest``.
+
+Raises ``KeyError`` if there is no such container in the store."""
+        return load_snapshot(self._data(), self._index[digest])
+
+    def _data(self):
+        if self._map is None or len(self._map) != self._size:
+            # views of an older mapping keep it alive
+            self._map = mmap.mmap(
+                self._file.fileno(), self._size, access=mmap.ACCESS_READ
+            )
+        return self._map
@@ -0,0 +1,80 @@
+import unittest
+
+from pyimmutable import (
+    Arena,
+    ImmutableDict,
+    ImmutableList,
+    json_loads,
+    make_immutable,
+)
+
+
+class TestArena(unittest.TestCase):
+    def test_tree(self):
+        arena = Arena()
+        with arena as a:
+            self.assertTrue(a is arena)
+            tree = make_immutable(
+                [{"id": i, "tags": ["a", str(i)]} for i in range(1000)]
+            )
+            doc = json_loads('{"x": [1, {"y": 2}]}')
+        info = arena.info()
+        self.assertGreaterEqual(info["chunks"], 1)
+        self.assertGreater(info["used"], 0)
+        self.assertGreaterEqual(info["live"], 2000)
+
+        # objects built later do not come from the arena
+        other = ImmutableDict(outside=True)
+        self.assertEqual(arena.info()["live"], info["live"])
+
+        self.assertEqual(tree[999]["tags"][1], "999")
+        self.assertTrue(
+            tree[5] is make_immutable({"id": 5, "tags": ["a", "5"]})
+        )
+        self.assertEqual(doc["x"][1]["y"], 2)
+
+        tree = None
+        self.assertLess(arena.info()["live"], 100)
+        self.assertEqual(type(doc["x"]), ImmutableList)
+        self.assertEqual(other["outside"], True)
+
+    def test_outlives_arena_object(self):
+        arena = Arena()
+        with arena:
+            data = make_immutable({"key": ["value", {"n": 1}]})
+        arena = None
+        self.assertEqual(data["key"][1]["n"], 1)
+        self.assertEqual(
+            data.set("more", 2), ImmutableDict(key=data["key"], more=2)
+        )
+        data = None
+        self.assertEqual(ImmutableDict._get_instance_count(), 0)
+        self.assertEqual(ImmutableList._get_instance_count(), 0)
+
+    def test_nesting(self):
+        outer = Arena()
+        inner = Arena()
+        with outer:
+            with inner:
+                a = ImmutableList(["inner"])
+            b = ImmutableList(["outer"])
+            with self.assertRaises(RuntimeError):
+                with outer:
+                    pass
+            with self.assertRaises(RuntimeError):
+                inner.__exit__(None, None, None)
+        self.assertEqual(inner.info()["live"], 1)
+        self.assertEqual(outer.info()["live"], 1)
+        a = b = None
+        self.assertEqual(inner.info()["live"], 0)
+        self.assertEqual(outer.info()["live"], 0)
+
+    def test_arguments(self):
+        with self.assertRaises(TypeError):
+            Arena(1)
+        with self.assertRaises(TypeError):
+            Arena(size=1)
+
+
+if __name__ == "__main__":
+    unittest.main()
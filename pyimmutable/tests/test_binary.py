@@ -0,0 +1,83 @@
+import unittest
+
+from pyimmutable import (
+    ImmutableDict,
+    ImmutableList,
+    dumps_binary,
+    loads_binary,
+    make_immutable,
+)
+
+
+class TestBinary(unittest.TestCase):
+    def test_roundtrip(self):
+        for value in (
+            None,
+            True,
+            False,
+            0,
+            -1,
+            2 ** 63 - 1,
+            -(2 ** 63),
+            2 ** 64,
+            -(10 ** 30),
+            1.5,
+            float("inf"),
+            "",
+            "ä\U0001f600",
+            b"\x00\xff",
+            (),
+            (1, ("x", None)),
+            ImmutableDict(),
+            ImmutableList(),
+            ImmutableDict({1: "a", (2, 3): ImmutableList([None])}),
+            make_immutable({"a": [1, {"b": [2.5, "c"]}], "d": {}}),
+        ):
+            result = loads_binary(dumps_binary(value))
+            self.assertEqual(result, value)
+            self.assertEqual(type(result), type(value))
+            if isinstance(value, (ImmutableDict, ImmutableList)):
+                self.assertTrue(result is value)
+        self.assertTrue(loads_binary(bytearray(dumps_binary(1))) == 1)
+        self.assertTrue(loads_binary(memoryview(dumps_binary(1))) == 1)
+
+    def test_shared_subtrees(self):
+        leaf = make_immutable({"k{}".format(i): [i] * 10 for i in range(100)})
+        tree = ImmutableList(ImmutableDict(id=i, x=leaf) for i in range(100))
+        data = dumps_binary(tree)
+        self.assertLess(len(data), 2 * len(dumps_binary(leaf)))
+        self.assertTrue(loads_binary(data) is tree)
+        # a repeated container takes a tag byte and a one-byte index
+        self.assertEqual(
+            len(dumps_binary(ImmutableList([leaf, leaf]))),
+            len(dumps_binary(ImmutableList([leaf]))) + 2,
+        )
+
+    def test_errors(self):
+        for value in ([], {}, object(), ImmutableList([set()])):
+            with self.assertRaises(TypeError):
+                dumps_binary(value)
+        with self.assertRaises(TypeError):
+            loads_binary("text")
+
+        data = dumps_binary(make_immutable({"a": [1, 2.5, "x", (None,)]}))
+        loads_binary(data)
+        for i in range(len(data)):
+            with self.assertRaises(ValueError):
+                loads_binary(data[:i])
+        for invalid in (
+            data + b"N",
+            data[:5] + b"?",
+            data[:5] + b"r\x00",
+            data[:5] + b"i\xff",
+            data[:5] + b"I\x01x",
+            data[:5] + b"s\x01\xff",
+            data[:5] + b"l\xff\xff\xff\xff\x0f",
+            b"PYIM\x02N",
+        ):
+            with self.assertRaises(ValueError):
+                loads_binary(invalid)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -1,3 +1,5 @@
+import struct
+import sys
 import unittest
 
 from pyimmutable import ImmutableDict
@@ -47,6 +49,38 @@ class TestImmutableDict(unittest.TestCase):
         d = ImmutableDict(pydict)
         self.assertEqual(set(d.items()), set(pydict.items()))
 
+    def test_evolver(self):
+        d = ImmutableDict(a=1, b=2, c=[])
+        count = ImmutableDict._get_instance_count()
+        e = d.evolver()
+        e["a"] = 3
+        e.set("d", 4).discard("b").discard("x").update({"e": 5}, f=6)
+        del e["c"]
+        with self.assertRaises(KeyError):
+            del e["c"]
+        with self.assertRaises(KeyError):
+            e["c"]
+        self.assertEqual(e["a"], 3)
+        self.assertEqual(len(e), 4)
+        self.assertEqual(ImmutableDict._get_instance_count(), count)
+
+        result = e.persistent()
+        self.assertTrue(result is ImmutableDict(a=3, d=4, e=5, f=6))
+        self.assertTrue(result.isImmutableJson)
+        self.assertTrue(e.persistent() is result)
+        e["c"] = []
+        self.assertFalse(e.persistent().isImmutableJson)
+        self.assertTrue(d.evolver().persistent() is d)
+        self.assertEqual(dict(d), {"a": 1, "b": 2, "c": []})
+
+    def test_sizeof(self):
+        d = ImmutableDict(a=1)
+        e = d.set("b", 2).set("c", 3)
+        # key digest, value digest, key and value, without padding
+        entry_size = 2 * len(d.digest) + 2 * struct.calcsize("P")
+        self.assertEqual(e.__sizeof__() - d.__sizeof__(), 2 * entry_size)
+        self.assertGreater(sys.getsizeof(d), entry_size)
+
 
 if __name__ == "__main__":
     unittest.main()
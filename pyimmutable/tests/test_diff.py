@@ -0,0 +1,212 @@
+import unittest
+
+from pyimmutable import (
+    ImmutableDict,
+    ImmutableList,
+    free_list_info,
+    make_immutable,
+)
+
+
+class TestDiff(unittest.TestCase):
+    def test_dict_diff(self):
+        old = ImmutableDict(a=1, b=2, c=ImmutableDict(x=1))
+        new = old.set("a", 10).discard("b").set("d", 4)
+        self.assertEqual(old.diff(old), [])
+        self.assertEqual(
+            sorted(old.diff(new)),
+            [
+                (("a",), "change", 10),
+                (("b",), "remove", 2),
+                (("d",), "add", 4),
+            ],
+        )
+        self.assertEqual(
+            sorted(new.diff(old)),
+            [(("a",), "change", 1), (("b",), "add", 2), (("d",), "remove", 4)],
+        )
+        self.assertEqual(ImmutableDict().diff(ImmutableDict(a=1)),
+                         [(("a",), "add", 1)])
+        with self.assertRaises(TypeError):
+            old.diff({})
+        with self.assertRaises(TypeError):
+            old.diff(ImmutableList())
+
+    def test_list_diff(self):
+        old = ImmutableList([1, 2, 3])
+        self.assertEqual(old.diff(old), [])
+        self.assertEqual(
+            old.diff(ImmutableList([1, 5, 3, 4, 6])),
+            [((1,), "change", 5), ((3,), "add", 4), ((4,), "add", 6)],
+        )
+        self.assertEqual(
+            old.diff(ImmutableList([0])),
+            [((0,), "change", 0), ((2,), "remove", 3), ((1,), "remove", 2)],
+        )
+        with self.assertRaises(TypeError):
+            old.diff([1, 2, 3])
+
+    def test_deep_diff(self):
+        old = make_immutable(
+            {"a": {"b": [1, {"c": 2}, 3]}, "d": [[4, 5]], "e": None}
+        )
+        new = old.set_in(("a", "b", 1, "c"), 20).set_in(("d", 0), [4])
+        new = new.set("e", ImmutableDict(f=1))
+        self.assertEqual(old.deep_diff(old), [])
+        self.assertEqual(
+            sorted(old.deep_diff(new), key=repr),
+            [
+                (("a", "b", 1, "c"), "change", 20),
+                (("d", 0), "change", [4]),
+                (("e",), "change", ImmutableDict(f=1)),
+            ],
+        )
+        new = old.set_in(("d", 0), ImmutableList([4]))
+        self.assertEqual(old.deep_diff(new), [(("d", 0, 1), "remove", 5)])
+        self.assertEqual(
+            sorted(old.diff(new), key=repr),
+            [(("d",), "change", ImmutableList([ImmutableList([4])]))],
+        )
+        self.assertEqual(
+            old["d"].deep_diff(ImmutableList([[4, 5, 6]])),
+            [((0,), "change", [4, 5, 6])],
+        )
+        self.assertEqual(
+            old["d"].deep_diff(make_immutable([[4, 5, 6]])),
+            [((0, 2), "add", 6)],
+        )
+
+    def test_apply_diff(self):
+        old = make_immutable({"a": [1, 2, {"b": 3}], "c": {"d": 4, "e": 5}})
+        for new in (
+            make_immutable({"a": [1, 2, {"b": 30}, 4], "c": {"d": 4}}),
+            make_immutable({"a": [1], "c": {"d": 4, "e": {"f": 6}}, "g": 7}),
+            make_immutable({}),
+        ):
+            self.assertTrue(old.apply_patch(old.deep_diff(new)) is new)
+            self.assertTrue(new.apply_patch(new.deep_diff(old)) is old)
+            self.assertTrue(old.apply_patch(old.diff(new)) is new)
+            new_a = new.get("a", ImmutableList())
+            self.assertTrue(
+                old["a"].apply_patch(old["a"].deep_diff(new_a)) is new_a
+            )
+
+    def test_apply_patch(self):
+        tree = make_immutable({"a": {"b": [1, {"c": 2}, 3]}, "d": [4, 5]})
+        self.assertTrue(tree.apply_patch([]) is tree)
+        self.assertTrue(tree.apply_patch([(("a", "b", 0), "change", 1)])
+                        is tree)
+        self.assertTrue(
+            tree.apply_patch(
+                [
+                    (("a", "b", 1, "c"), "change", 20),
+                    (("a", "b", 1, "x"), "add", 1),
+                    (["x", "y"], "add", 1),
+                    (("d", 0), "add", 3),
+                    (("d", -1), "remove", None),
+                    (("a", "b", 1, "c"), "change", 21),
+                    (("q", "r"), "remove", None),
+                    (("d", 5), "remove", None),
+                ]
+            )
+            is make_immutable(
+                {
+                    "a": {"b": [1, {"c": 21, "x": 1}, 3]},
+                    "d": [3, 4],
+                    "x": {"y": 1},
+                }
+            )
+        )
+        # open nested containers behind an insertion or removal are shifted
+        tree = make_immutable([[0], [1], [2]])
+        self.assertTrue(
+            tree.apply_patch(
+                [
+                    ((1, 0), "change", 10),
+                    ((2, 0), "change", 20),
+                    ((1,), "add", ImmutableList()),
+                    ((3, 1), "add", 21),
+                    ((0,), "remove", None),
+                    ((2, 0), "change", 22),
+                ]
+            )
+            is make_immutable([[], [10], [22, 21]])
+        )
+        self.assertTrue(
+            tree.apply_patch([((0, 0), "change", 5), ((0,), "change", 6)])
+            is make_immutable([6, [1], [2]])
+        )
+
+    def test_apply_patch_creates_final_list_only(self):
+        def list_allocations():
+            info = free_list_info()["ImmutableList"]
+            return info["hits"] + info["misses"]
+
+        old = ImmutableList(range(100))
+        patch = [
+            ((10,), "add", -1),
+            ((50,), "remove", None),
+            ((20,), "add", -2),
+            ((0,), "remove", None),
+        ]
+        expected = list(range(100))
+        expected.insert(10, -1)
+        del expected[50]
+        expected.insert(20, -2)
+        del expected[0]
+
+        before = list_allocations()
+        result = old.apply_patch(patch)
+        self.assertEqual(list_allocations() - before, 1)
+        self.assertTrue(result is ImmutableList(expected))
+
+    def test_apply_patch_errors(self):
+        tree = make_immutable({"a": [1, 2], "b": 1})
+        for patch, exc in (
+            (1, TypeError),
+            ([1], TypeError),
+            ([(("a",), "change")], TypeError),
+            ([((), "change", 1)], ValueError),
+            ([(("a",), "replace", 1)], ValueError),
+            ([(("a", 2), "change", 1)], IndexError),
+            ([(("a", 3), "add", 1)], IndexError),
+            ([(("a", 0, 0), "change", 1)], TypeError),
+            ([(("a", "x"), "change", 1)], TypeError),
+            ([(("b", "c"), "change", 1)], TypeError),
+            ([(("a", 5, 0), "change", 1)], IndexError),
+        ):
+            with self.assertRaises(exc):
+                tree.apply_patch(patch)
+
+    def test_large(self):
+        old = ImmutableDict((i, i) for i in range(10000))
+        new = old.set(5000, -1).discard(7)
+        self.assertEqual(
+            sorted(old.diff(new)),
+            [((7,), "remove", 7), ((5000,), "change", -1)],
+        )
+
+    def test_large_list(self):
+        old = ImmutableList(range(10000))
+        new = old.set(0, -1).set(5000, -1).append(-2)
+        self.assertEqual(
+            old.diff(new),
+            [
+                ((0,), "change", -1),
+                ((5000,), "change", -1),
+                ((10000,), "add", -2),
+            ],
+        )
+        self.assertEqual(
+            new.diff(old.set(9999, -3)),
+            [
+                ((0,), "change", 0),
+                ((5000,), "change", 5000),
+                ((9999,), "change", -3),
+                ((10000,), "remove", -2),
+            ],
+        )
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,36 @@
+import unittest
+
+from pyimmutable import ImmutableDict, ImmutableList, free_list_info
+
+
+class TestFreeList(unittest.TestCase):
+    def test_iterators(self):
+        d = ImmutableDict(a=1, b=2)
+        lst = ImmutableList([1, 2, 3])
+        before = free_list_info()
+        for _ in range(100):
+            self.assertEqual(sorted(d.keys()), ["a", "b"])
+            self.assertEqual(sum(lst), 6)
+        after = free_list_info()
+
+        for name in ("ImmutableDictIterator", "ImmutableListIterator"):
+            self.assertGreaterEqual(
+                after[name]["hits"] - before[name]["hits"], 99
+            )
+            self.assertLessEqual(after[name]["size"], 1)
+
+    def test_bounded(self):
+        info = free_list_info()["ImmutableList"]
+        lists = [ImmutableList([i]) for i in range(info["capacity"] + 50)]
+        lists = None
+        info = free_list_info()["ImmutableList"]
+        self.assertEqual(info["size"], info["capacity"])
+
+        # reused memory does not confuse interning
+        a = ImmutableList(["reused"])
+        self.assertTrue(a is ImmutableList(["reused"]))
+        self.assertEqual(ImmutableList._get_instance_count(), 1)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -1,6 +1,9 @@
+import os
+import subprocess
+import sys
 import unittest
 
-from pyimmutable import ImmutableList
+from pyimmutable import ImmutableDict, ImmutableList, make_immutable
 
 
 def make_test_data():
@@ -24,6 +27,43 @@ class TestHash(unittest.TestCase):
         l2 = ImmutableList(data2)
         self.assertTrue(l1 is l2)
 
+    def test_digest(self):
+        data = {"a": [1, None, {"b": 2.5}], "c": (1, "x"), "d": b"y"}
+        tree = make_immutable(data)
+        self.assertIsInstance(tree.digest, bytes)
+        self.assertEqual(tree.digest, make_immutable(data).digest)
+        self.assertNotEqual(tree.digest, tree["a"].digest)
+        self.assertNotEqual(
+            tree.digest, tree.set_in(("a", 2, "b"), 3.5).digest
+        )
+        self.assertNotEqual(
+            ImmutableDict(a=ImmutableList()).digest,
+            ImmutableDict(a=ImmutableDict()).digest,
+        )
+
+        # nested containers are hashed by content, not by address, so the
+        # digest is the same in another process
+        code = "from pyimmutable import make_immutable\n"
+        code += "print(make_immutable({!r}).digest.hex())".format(data)
+        output = subprocess.run(
+            [sys.executable, "-c", code],
+            env=dict(os.environ, PYTHONPATH=os.pathsep.join(sys.path)),
+            stdout=subprocess.PIPE,
+            check=True,
+        ).stdout
+        self.assertEqual(output.decode().strip(), tree.digest.hex())
+
+    def test_int_digest(self):
+        values = [0, 1, -1, 2**30, 2**63 - 1, -(2**63), 2**64, 2**100]
+        values += [-x for x in values[-2:]]
+        digests = set()
+        for value in values:
+            # int() of a string builds a new object for large values
+            lst = ImmutableList([value])
+            self.assertTrue(lst is ImmutableList([int(str(value))]))
+            digests.add(lst.digest)
+        self.assertEqual(len(digests), len(values))
+
 
 if __name__ == "__main__":
     unittest.main()
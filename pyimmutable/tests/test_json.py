@@ -9,6 +9,8 @@ from pyimmutable import (
     json_dumps,
     json_load,
     json_loads,
+    make_immutable,
+    make_mutable,
 )
 
 
@@ -33,10 +35,121 @@ class TestJson(unittest.TestCase):
         d_from_j = json_load(io.StringIO(self.example_json))
         self.assertTrue(d_from_j is example_immutable_data())
 
+    def test_loads_matches_json(self):
+        docs = [
+            self.example_json,
+            '["a\\u00e9\\ud83d\\ude00", "\\ud800"]',
+            '["\\"\\\\\\/\\b\\f\\n\\r\\t"]',
+            '["€", "\U0001f600", "", " "]',
+            "[0, -0, 1, -1, 256, 257, 123456789012345678901234567890]",
+            "[0.5, -1.5e10, 1E-3, 1e400, -0.0, NaN, Infinity, -Infinity]",
+            '{"a": 1, "b": {"a": 2}, "a": 3}',
+            " \t\r\n[ ] ",
+            "[[[]], {}, [{}]]",
+        ]
+        for doc in docs:
+            expected = make_immutable(json.loads(doc))
+            self.assertEqual(repr(json_loads(doc)), repr(expected))
+            self.assertEqual(
+                repr(json_loads(doc.encode("utf-8", "surrogatepass"))),
+                repr(expected),
+            )
+        self.assertEqual(json_loads("123"), 123)
+        self.assertEqual(json_loads('"x"'), "x")
+
+    def test_loads_errors(self):
+        for doc in [
+            "",
+            "[1,]",
+            "[1, \n]",
+            "[1,,]",
+            '{"a" 1}',
+            '{"a": 1,}',
+            '{"a": 1 , }',
+            '"abc',
+            '"\\x"',
+            '"\\u12g4"',
+            '"a\x01"',
+            "01",
+            "-",
+            "[1 2]",
+            "\ufeff[]",
+        ]:
+            with self.assertRaises(json.JSONDecodeError) as expected:
+                json.loads(doc)
+            with self.assertRaises(json.JSONDecodeError) as actual:
+                json_loads(doc)
+            self.assertEqual(actual.exception.msg, expected.exception.msg)
+            self.assertEqual(actual.exception.pos, expected.exception.pos)
+
+        with self.assertRaises(TypeError):
+            json_loads(1)
+        with self.assertRaises(RecursionError):
+            json_loads("[" * 100000 + "]" * 100000)
+
+    def test_loads_kwargs(self):
+        self.assertEqual(
+            json_loads('{"a": 1.5}', parse_float=str), ImmutableDict(a="1.5")
+        )
+        self.assertEqual(
+            json_load(io.StringIO("[1]"), parse_int=float),
+            ImmutableList([1.0]),
+        )
+
     def test_dumps(self):
         j_from_d = json_dumps(example_immutable_data())
         self.assertEqual(json.loads(j_from_d), self.example_mutable_data)
 
+    def test_dumps_matches_json(self):
+        data = [
+            None,
+            True,
+            False,
+            0,
+            -1,
+            2 ** 70,
+            1.5,
+            -0.0,
+            1e16,
+            float("nan"),
+            float("inf"),
+            -float("inf"),
+            "",
+            "a\u00e9\x7f\U0001f600\ud800",
+            '"\\/\b\f\n\r\t\x01\x1f',
+            {"a": 1, 2: [], 2.5: {}, None: (1, 2), False: "x"},
+            [[[]], {}, ()],
+        ]
+        immutable = make_immutable(data)
+        expected = json.dumps(make_mutable(immutable))
+        for cache_fragments in (False, True, True):
+            self.assertEqual(
+                json_dumps(immutable, cache_fragments=cache_fragments),
+                expected,
+            )
+        self.assertEqual(json_dumps(data), json.dumps(data))
+
+    def test_dumps_cached_fragments(self):
+        inner = ImmutableDict(a=ImmutableList([1, 2]))
+        outer = ImmutableList([inner, inner])
+        self.assertEqual(
+            json_dumps(outer, cache_fragments=True),
+            '[{"a": [1, 2]}, {"a": [1, 2]}]',
+        )
+        modified = outer.set(1, inner.set("b", None))
+        self.assertEqual(
+            json.loads(json_dumps(modified, cache_fragments=True)),
+            [{"a": [1, 2]}, {"a": [1, 2], "b": None}],
+        )
+        self.assertEqual(json_dumps(inner), '{"a": [1, 2]}')
+
+    def test_dumps_fallback(self):
+        self.assertEqual(
+            json_dumps(ImmutableList([1]), indent=1), "[\n 1\n]"
+        )
+        with self.assertRaises(TypeError):
+            json_dumps(ImmutableList([object()]))
+
     def test_dump(self):
         f = io.StringIO()
         json_dump(example_immutable_data(), f)
@@ -0,0 +1,87 @@
+import sys
+import unittest
+
+from pyimmutable import (
+    ImmutableDict,
+    key_hash_cache_info,
+    set_key_hash_cache_capacity,
+)
+
+
+class TestKeyHashCache(unittest.TestCase):
+    def tearDown(self):
+        set_key_hash_cache_capacity(0)
+
+    def test_disabled_by_default(self):
+        info = key_hash_cache_info()
+        self.assertEqual(info["capacity"], 0)
+        self.assertEqual(info["size"], 0)
+        d = ImmutableDict(foo=1)
+        self.assertEqual(d["foo"], 1)
+        self.assertEqual(key_hash_cache_info()["hits"], 0)
+
+    def test_capacity(self):
+        set_key_hash_cache_capacity(100)
+        self.assertEqual(key_hash_cache_info()["capacity"], 128)
+        with self.assertRaises(ValueError):
+            set_key_hash_cache_capacity(-1)
+        with self.assertRaises(ValueError):
+            set_key_hash_cache_capacity(2**60)
+        set_key_hash_cache_capacity(2**20)
+        self.assertEqual(key_hash_cache_info()["capacity"], 2**20)
+
+    def test_hits(self):
+        set_key_hash_cache_capacity(64)
+        d = ImmutableDict(foo=1, bar=2).set(7, "seven")
+        # Only one key is looked up, so no other key can evict it from its
+        # slot, whatever the addresses of the keys.
+        for _ in range(10):
+            self.assertEqual(d["foo"], 1)
+        info = key_hash_cache_info()
+        self.assertGreaterEqual(info["hits"], 9)
+        self.assertGreaterEqual(info["size"], 1)
+        self.assertEqual(
+            d.discard("foo"), ImmutableDict(bar=2).set(7, "seven")
+        )
+
+    def test_uncacheable_keys(self):
+        set_key_hash_cache_capacity(64)
+        key = "".join(["not", "interned"])
+        d = ImmutableDict().set(key, 1).set(1000, 2).set(-6, 3)
+        for _ in range(10):
+            self.assertEqual(d[key], 1)
+            self.assertEqual(d[1000], 2)
+            self.assertEqual(d[-6], 3)
+        info = key_hash_cache_info()
+        self.assertEqual(info["hits"] + info["misses"], 0)
+
+    def test_results_match_uncached(self):
+        keys = [sys.intern(f"key{i}") for i in range(50)]
+        keys.extend(range(-5, 257))
+        d = ImmutableDict((k, k) for k in keys)
+        set_key_hash_cache_capacity(16)
+        for _ in range(3):
+            for k in keys:
+                self.assertEqual(d[k], k)
+        set_key_hash_cache_capacity(0)
+        for k in keys:
+            self.assertEqual(d[k], k)
+
+    def test_releases_references(self):
+        key = sys.intern("key_hash_cache_refcount_test")
+        d = ImmutableDict().set(key, 1)
+        refcount = sys.getrefcount(key)
+        holder = [key]
+        if sys.getrefcount(key) == refcount:
+            # Python 3.12 makes interned strings immortal
+            raise unittest.SkipTest("Reference count of key does not change")
+        del holder
+        set_key_hash_cache_capacity(8)
+        d[key]
+        self.assertEqual(sys.getrefcount(key), refcount + 1)
+        set_key_hash_cache_capacity(0)
+        self.assertEqual(sys.getrefcount(key), refcount)
+
+
+if __name__ == "__main__":
+    unittest.main()
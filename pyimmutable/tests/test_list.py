@@ -1,3 +1,5 @@
+import struct
+import sys
 import unittest
 
 from pyimmutable import ImmutableList
@@ -34,6 +36,113 @@ class TestImmutableDict(unittest.TestCase):
                 self.assertTrue(ImmutableList(l1 + l2) is il1.extend(il2))
                 self.assertTrue(ImmutableList(l1 + l2) is il1.extend(l2))
 
+    def test_small_values(self):
+        values = [-6, -5, 0, 1, 256, 257, 2 ** 40, None, "", (), True, False]
+        il = ImmutableList()
+        for v in values:
+            il = il.append(v)
+        self.assertTrue(ImmutableList(values) is il)
+        self.assertTrue(ImmutableList().extend(values) is il)
+        self.assertTrue(ImmutableList([True, False]) is ImmutableList([1, 0]))
+
+    def test_slice_concat_repeat(self):
+        values = [None, 0, 1, "a", "b", 1.5, (1,), "", 2 ** 80, "a", 0]
+        il = ImmutableList(values)
+        for start in range(-12, 13):
+            for stop in range(-12, 13):
+                for step in (None, 1, 2, 3, -1, -2):
+                    self.assertTrue(
+                        il[start:stop:step]
+                        is ImmutableList(values[start:stop:step])
+                    )
+        for i in range(len(values) + 1):
+            self.assertTrue(il[:i] + il[i:] is il)
+            self.assertTrue(il[:i].extend(values[i:]) is il)
+        for count in range(5):
+            self.assertTrue(il * count is ImmutableList(values * count))
+        self.assertTrue(
+            il.set(3, "x").set(3, "a").set(-1, 1) is il[:-1].append(1)
+        )
+
+    def test_repeat_overflow(self):
+        il = ImmutableList(range(1000))
+        with self.assertRaises(MemoryError):
+            il * 2 ** 62
+        with self.assertRaises(MemoryError):
+            il * (sys.maxsize // len(il) + 1)
+        self.assertEqual(len(il * 3), 3000)
+
+    def test_insert_delete_splice_drop(self):
+        values = [None, 0, 1, "a", "b", 1.5, (1,), "", 2 ** 80, "a", 0]
+        il = ImmutableList(values)
+        for idx in range(-13, 14):
+            expected = list(values)
+            expected.insert(idx, "x")
+            self.assertTrue(il.insert(idx, "x") is ImmutableList(expected))
+        for idx in range(-11, 11):
+            expected = list(values)
+            del expected[idx]
+            self.assertTrue(il.delete(idx) is ImmutableList(expected))
+            self.assertTrue(il.delete(idx).insert(idx % 11, values[idx]) is il)
+        for idx in (-12, 11):
+            with self.assertRaises(IndexError):
+                il.delete(idx)
+        for start in range(-12, 13):
+            for stop in range(-12, 13):
+                for new in ([], ["x"], [1, 2, 3], ImmutableList([4, 5])):
+                    expected = list(values)
+                    expected[start:stop] = new
+                    self.assertTrue(
+                        il.splice(start, stop, new) is ImmutableList(expected)
+                    )
+        for count in range(13):
+            self.assertTrue(il.drop(count) is ImmutableList(values[count:]))
+        with self.assertRaises(ValueError):
+            il.drop(-1)
+        with self.assertRaises(TypeError):
+            il.splice(0, 1, None)
+
+        queue = ImmutableList(range(1000))
+        for i in range(1000):
+            self.assertEqual(queue[0], i)
+            queue = queue.drop(1)
+        self.assertTrue(queue is ImmutableList())
+
+    def test_evolver(self):
+        il = ImmutableList([1, 2, 3])
+        count = ImmutableList._get_instance_count()
+        e = il.evolver()
+        e[0] = 0
+        e[-1] = "x"
+        e.set(-2, "y").append(4).extend([5, 6]).extend(ImmutableList([7]))
+        with self.assertRaises(IndexError):
+            e[7] = 1
+        with self.assertRaises(IndexError):
+            e.set(-8, 1)
+        with self.assertRaises(TypeError):
+            del e[0]
+        self.assertEqual(e[-1], 7)
+        self.assertEqual(len(e), 7)
+        self.assertEqual(ImmutableList._get_instance_count(), count)
+
+        result = e.persistent()
+        self.assertTrue(result is ImmutableList([0, "y", "x", 4, 5, 6, 7]))
+        self.assertTrue(result.isImmutableJson)
+        self.assertTrue(e.persistent() is result)
+        e.append(set())
+        self.assertFalse(e.persistent().isImmutableJson)
+        self.assertTrue(il.evolver().persistent() is il)
+        self.assertEqual(list(il), [1, 2, 3])
+
+    def test_set_immutable_json(self):
+        il = ImmutableList([1, 2]).set(0, Exception())
+        self.assertFalse(il.isImmutableJson)
+        # set() must flag the new item by its own value, so that slices count
+        # the JSON items correctly
+        self.assertFalse(il[:1].isImmutableJson)
+        self.assertTrue(il[1:].isImmutableJson)
+        self.assertTrue(il.set(0, 0).isImmutableJson)
+
     def test_iter(self):
         il = ImmutableList([0, 1, 2, 3, 4, 5, 6, 7, 8, 9])
 
@@ -68,6 +177,14 @@ class TestImmutableDict(unittest.TestCase):
         with self.assertRaises(ValueError):
             ImmutableList([1, 2, 3, 4]).index(3.0)
 
+    def test_sizeof(self):
+        a = ImmutableList([1])
+        b = a.append(2).append(3)
+        # value digest and value, without padding
+        entry_size = len(a.digest) + struct.calcsize("P")
+        self.assertEqual(b.__sizeof__() - a.__sizeof__(), 2 * entry_size)
+        self.assertGreater(sys.getsizeof(a), entry_size)
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -1,8 +1,16 @@
+import ast
+import collections
+import os
+import subprocess
+import sys
+import sysconfig
+import types
 import unittest
 
 from pyimmutable import (
     ImmutableDict,
     ImmutableList,
+    freeze,
     make_immutable,
     make_mutable,
 )
@@ -29,6 +37,118 @@ class TestMakeImmutable(unittest.TestCase):
         m_from_m_from_i = make_mutable(m_from_i)
         self.assertEqual(m_from_m_from_i, m_from_i)
 
+    def test_nested_mutable_values(self):
+        il = ImmutableList([1, [2, {"a": (3,)}]])
+        self.assertFalse(il.isImmutableJson)
+        self.assertTrue(
+            make_immutable(il)
+            is ImmutableList(
+                [
+                    1,
+                    ImmutableList(
+                        [2, ImmutableDict(a=ImmutableList([3]))]
+                    ),
+                ]
+            )
+        )
+        self.assertEqual(make_mutable(il), [1, [2, {"a": [3]}]])
+
+    def test_other_mappings_and_sequences(self):
+        data = types.MappingProxyType(
+            {"a": collections.deque([1, 2]), 1: range(2), "s": "str"}
+        )
+        self.assertEqual(
+            make_mutable(data), {"a": [1, 2], 1: [0, 1], "s": "str"}
+        )
+        self.assertTrue(
+            make_immutable(data)
+            is ImmutableDict(a=ImmutableList([1, 2]), s="str").set(
+                1, ImmutableList([0, 1])
+            )
+        )
+        self.assertTrue(
+            make_immutable({(1, 2): None})
+            is ImmutableDict().set(ImmutableList([1, 2]), None)
+        )
+        obj = object()
+        self.assertTrue(make_immutable(obj) is obj)
+        self.assertTrue(make_mutable(obj) is obj)
+
+    def test_deep_nesting(self):
+        depth = 100000
+        data = []
+        for _ in range(depth):
+            data = [data]
+        immutable = make_immutable(data)
+        mutable = make_mutable(immutable)
+        for _ in range(depth):
+            self.assertEqual(len(immutable), 1)
+            self.assertEqual(len(mutable), 1)
+            immutable = immutable[0]
+            mutable = mutable[0]
+        self.assertTrue(immutable is ImmutableList())
+        self.assertEqual(mutable, [])
+
+    def test_circular_reference(self):
+        data = {"a": [1]}
+        data["a"].append(data)
+        with self.assertRaises(ValueError):
+            make_immutable(data)
+        with self.assertRaises(ValueError):
+            make_mutable(data)
+
+        shared = [1, 2]
+        self.assertEqual(make_mutable([shared, shared]), [[1, 2], [1, 2]])
+
+    def test_freeze(self):
+        # From Python 3.12 on, freeze makes objects immortal, and so would
+        # leave instances behind for the tests that count them. It is
+        # therefore run in a separate process.
+        output = subprocess.run(
+            [sys.executable, "-c", FREEZE_TEST_CODE],
+            env=dict(os.environ, PYTHONPATH=os.pathsep.join(sys.path)),
+            stdout=subprocess.PIPE,
+            check=True,
+        ).stdout
+        result = ast.literal_eval(output.decode())
+        self.assertTrue(result["leaf_tracked_before"])
+        self.assertTrue(result["returns_argument"])
+        self.assertFalse(result["leaf_tracked"])
+        self.assertFalse(result["nested_tracked"])
+        # a tuple containing a list can be part of a reference cycle
+        self.assertTrue(result["mutable_tracked"])
+        self.assertTrue(result["unchanged"])
+        self.assertEqual(
+            result["immortal"],
+            sys.version_info >= (3, 12)
+            and not sysconfig.get_config_var("Py_GIL_DISABLED"),
+        )
+
+
+FREEZE_TEST_CODE = """
+import gc
+import sys
+from pyimmutable import ImmutableDict, ImmutableList, freeze
+
+leaf = tuple(["x", 1])
+nested = tuple([leaf, ImmutableList([2])])
+mutable = tuple([[]])
+data = ImmutableDict(a=nested, b=ImmutableList([mutable, leaf]))
+result = {"leaf_tracked_before": gc.is_tracked(leaf)}
+result["returns_argument"] = freeze(data) is data
+result["leaf_tracked"] = gc.is_tracked(leaf)
+result["nested_tracked"] = gc.is_tracked(nested)
+result["mutable_tracked"] = gc.is_tracked(mutable)
+result["unchanged"] = (
+    data["a"] == (("x", 1), ImmutableList([2])) and freeze(1) == 1
+)
+refcounts = [sys.getrefcount(obj) for obj in (data, leaf, nested)]
+references = [data, leaf, nested]
+result["immortal"] = refcounts == [
+    sys.getrefcount(obj) for obj in (data, leaf, nested)
+]
+print(repr(result))
+"""
 
 def example_immutable_data():
     return ImmutableDict(
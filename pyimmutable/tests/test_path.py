@@ -0,0 +1,112 @@
+import unittest
+
+from pyimmutable import ImmutableDict, ImmutableList, make_immutable
+
+
+class TestPath(unittest.TestCase):
+    def setUp(self):
+        self.tree = make_immutable(
+            {"a": {"b": [1, {"c": 2}, 3]}, "d": [[4, 5]], "e": None}
+        )
+
+    def test_get_in(self):
+        tree = self.tree
+        self.assertTrue(tree.get_in(()) is tree)
+        self.assertEqual(tree.get_in(["a", "b", 1, "c"]), 2)
+        self.assertEqual(tree.get_in(("a", "b", -1)), 3)
+        self.assertEqual(tree.get_in(("d", 0, 1)), 5)
+        self.assertEqual(tree["d"].get_in([0, -2]), 4)
+        self.assertIsNone(tree.get_in(("e",), 0))
+        for path in (("x",), ("a", "x"), ("a", "b", 3), ("a", "b", "x"),
+                     ("e", "x"), ("a", "b", 0, 0), ("a", "b", 2 ** 100)):
+            self.assertIsNone(tree.get_in(path))
+            self.assertEqual(tree.get_in(path, "default"), "default")
+        with self.assertRaises(TypeError):
+            tree.get_in(1)
+
+    def test_set_in(self):
+        tree = self.tree
+        new = tree.set_in(("a", "b", 1, "c"), 20)
+        self.assertTrue(
+            new is make_immutable(
+                {"a": {"b": [1, {"c": 20}, 3]}, "d": [[4, 5]], "e": None}
+            )
+        )
+        self.assertTrue(new["d"] is tree["d"])
+        self.assertTrue(new["a"]["b"][1].set("c", 2) is tree["a"]["b"][1])
+        self.assertTrue(new.set_in(("a", "b", 1, "c"), 2) is tree)
+        self.assertTrue(tree.set_in(("a", "b", 1, "c"), 2) is tree)
+        self.assertTrue(tree.set_in(("d", -1, 0), 4) is tree)
+        self.assertTrue(
+            tree.set_in(("x", "y", "z"), 1)
+            is tree.set("x", ImmutableDict(y=ImmutableDict(z=1)))
+        )
+        self.assertTrue(
+            ImmutableList([1]).set_in([0], 2) is ImmutableList([2])
+        )
+        with self.assertRaises(IndexError):
+            tree.set_in(("a", "b", 3), 1)
+        with self.assertRaises(IndexError):
+            tree.set_in(("d", 1, 0), 1)
+        with self.assertRaises(TypeError):
+            tree.set_in(("e", "x"), 1)
+        with self.assertRaises(TypeError):
+            tree.set_in(("a", "b", "x"), 1)
+        with self.assertRaises(ValueError):
+            tree.set_in((), 1)
+
+    def test_discard_in(self):
+        tree = self.tree
+        self.assertTrue(
+            tree.discard_in(("a", "b", 1, "c"))
+            is tree.set_in(("a", "b", 1), ImmutableDict())
+        )
+        self.assertTrue(
+            tree.discard_in(["d", 0, 0])
+            is tree.set_in(("d", 0), ImmutableList([5]))
+        )
+        self.assertTrue(tree.discard_in(("e",)) is tree.discard("e"))
+        for path in (("x",), ("a", "x", "y"), ("a", "b", 3), ("d", 0, -3)):
+            self.assertTrue(tree.discard_in(path) is tree)
+        with self.assertRaises(TypeError):
+            tree.discard_in(("e", "x"))
+        with self.assertRaises(ValueError):
+            tree.discard_in(())
+
+    def test_update_in(self):
+        tree = self.tree
+        self.assertTrue(
+            tree.update_in(("a", "b", 0), lambda x: x + 10)
+            is tree.set_in(("a", "b", 0), 11)
+        )
+        self.assertTrue(tree.update_in(("d",), lambda x: x) is tree)
+        with self.assertRaises(KeyError):
+            tree.update_in(("a", "x"), lambda x: x)
+        with self.assertRaises(IndexError):
+            tree.update_in(("d", 2), lambda x: x)
+        with self.assertRaises(ZeroDivisionError):
+            tree.update_in(("a", "b", 0), lambda x: x / 0)
+        with self.assertRaises(ValueError):
+            tree.update_in((), lambda x: x)
+
+    def test_update_in_path_changed_by_function(self):
+        tree = ImmutableDict().set_in(("outer", "inner"), 1)
+        # keys that are only referenced by the path list
+        path = ["".join(["out", "er"]), "".join(["inn", "er"])]
+
+        garbage = []
+
+        def clear_path(x):
+            path.clear()
+            # reuse the memory of the keys
+            garbage.extend("".join(["x", str(i)]) for i in range(1000))
+            return x + 10
+
+        result = tree.update_in(path, clear_path)
+        self.assertTrue(result is tree.set_in(("outer", "inner"), 11))
+        self.assertEqual(list(result), ["outer"])
+        self.assertEqual(list(result["outer"]), ["inner"])
+
+
+if __name__ == "__main__":
+    unittest.main()
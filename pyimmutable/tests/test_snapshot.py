@@ -0,0 +1,207 @@
+import mmap
+import os
+import tempfile
+import unittest
+from unittest import mock
+
+from pyimmutable import (
+    ImmutableDict,
+    ImmutableList,
+    SnapshotDict,
+    SnapshotIndex,
+    SnapshotList,
+    SnapshotStore,
+    commit_snapshot,
+    dumps_snapshot,
+    load_snapshot,
+    make_immutable,
+    open_snapshot,
+)
+
+
+class TestSnapshot(unittest.TestCase):
+    def test_views(self):
+        inner = ImmutableList([1, "x", ImmutableDict(a=None)])
+        root = ImmutableDict(
+            {
+                "list": inner,
+                "tuple": (2.5, inner),
+                "big": 2 ** 70,
+                (1, b"k"): True,
+            }
+        )
+        view = load_snapshot(dumps_snapshot(root))
+        self.assertEqual(type(view), SnapshotDict)
+        self.assertEqual(len(view), 4)
+        self.assertEqual(sorted(map(repr, view)), sorted(map(repr, root)))
+        self.assertEqual(set(map(repr, view.keys())), set(map(repr, root)))
+        self.assertTrue("big" in view)
+        self.assertFalse("missing" in view)
+        self.assertEqual(view["big"], 2 ** 70)
+        self.assertTrue(view[(1, b"k")] is True)
+        self.assertEqual(view.get("missing"), None)
+        self.assertEqual(view.get("missing", 5), 5)
+        with self.assertRaises(KeyError):
+            view["missing"]
+
+        # containers within tuples are materialized
+        self.assertEqual(view["tuple"], (2.5, inner))
+        self.assertTrue(view["tuple"][1] is inner)
+
+        lst = view["list"]
+        self.assertEqual(type(lst), SnapshotList)
+        self.assertEqual(len(lst), 3)
+        self.assertEqual(lst[0], 1)
+        self.assertEqual(lst[-2], "x")
+        self.assertEqual(list(lst)[:2], [1, "x"])
+        self.assertEqual(type(lst[2]), SnapshotDict)
+        self.assertEqual(lst[2].items(), [("a", None)])
+        with self.assertRaises(IndexError):
+            lst[3]
+
+        self.assertTrue(lst.materialize() is inner)
+        self.assertTrue(view.materialize() is root)
+        self.assertEqual([key for key, _ in view.items()], view.keys())
+        self.assertEqual(len(view.values()), 4)
+
+    def test_sharing(self):
+        leaf = make_immutable({"k{}".format(i): [i] * 10 for i in range(100)})
+        tree = ImmutableList(ImmutableDict(id=i, x=leaf) for i in range(100))
+        data = dumps_snapshot(tree)
+        self.assertLess(len(data), 2 * len(dumps_snapshot(leaf)))
+        view = load_snapshot(data)
+        self.assertEqual(view[42]["id"], 42)
+        self.assertTrue(view[42]["x"].materialize() is leaf)
+        self.assertTrue(view.materialize() is tree)
+
+    def test_open_snapshot(self):
+        root = make_immutable({"a": [1, 2, {"b": "c"}]})
+        fd, path = tempfile.mkstemp()
+        try:
+            with os.fdopen(fd, "wb") as f:
+                f.write(dumps_snapshot(root))
+            view = open_snapshot(path)
+            self.assertEqual(view["a"][2]["b"], "c")
+            self.assertTrue(view.materialize() is root)
+        finally:
+            os.unlink(path)
+
+        # the buffer is locked while a view exists
+        m = mmap.mmap(-1, len(dumps_snapshot(root)))
+        m.write(dumps_snapshot(root))
+        view = load_snapshot(m)
+        with self.assertRaises(BufferError):
+            m.close()
+        del view
+        m.close()
+
+    def test_store(self):
+        state = make_immutable(
+            {"k{}".format(i): {"values": [i] * 20} for i in range(50)}
+        )
+        changed = state.set_in(("k7", "values", 3), None)
+        fd, path = tempfile.mkstemp()
+        os.close(fd)
+        try:
+            with SnapshotStore(path) as store:
+                first = store.commit(state)
+                size = os.path.getsize(path)
+                second = store.commit(changed)
+                # only the changed path is written again
+                self.assertLess(os.path.getsize(path) - size, size / 4)
+                self.assertEqual(store.roots, [first, second])
+                self.assertTrue(state["k8"].digest in store)
+                self.assertFalse(ImmutableList([8]).digest in store)
+                view = store.checkout(second)
+                self.assertEqual(view["k7"]["values"][3], None)
+                self.assertTrue(store.checkout(first).materialize() is state)
+                with self.assertRaises(KeyError):
+                    store.checkout(b"x")
+
+            with SnapshotStore(path) as store:
+                self.assertEqual(store.roots, [first, second])
+                self.assertTrue(view.materialize() is changed)
+                self.assertTrue(
+                    store.checkout(state["k1"].digest).materialize()
+                    is state["k1"]
+                )
+                store.commit(state)
+                self.assertEqual(store.roots, [first, second, first])
+            self.assertTrue(open_snapshot(path).materialize() is state)
+        finally:
+            os.unlink(path)
+
+    def test_store_failed_commit(self):
+        a = make_immutable({"a": [1, 2]})
+        b = make_immutable({"b": [3], "a": [1, 2]})
+        fd, path = tempfile.mkstemp()
+        os.close(fd)
+        try:
+            with SnapshotStore(path) as store:
+                first = store.commit(a)
+                size = os.path.getsize(path)
+                with mock.patch("os.fsync", side_effect=OSError("disk full")):
+                    with self.assertRaises(OSError):
+                        store.commit(b)
+                self.assertEqual(os.path.getsize(path), size)
+                self.assertFalse(b.digest in store)
+                self.assertFalse(b["b"].digest in store)
+                self.assertEqual(store.roots, [first])
+                second = store.commit(b)
+                self.assertTrue(store.checkout(second).materialize() is b)
+
+            with SnapshotStore(path) as store:
+                self.assertEqual(store.roots, [first, second])
+                self.assertTrue(store.checkout(second).materialize() is b)
+        finally:
+            os.unlink(path)
+
+    def test_index(self):
+        index = SnapshotIndex()
+        root = make_immutable({"a": [1], "b": [1]})
+        data, added = commit_snapshot(root, index, 0)
+        self.assertEqual(len(index), 0)
+        self.assertEqual(len(added), 2)
+        index.merge(added)
+        self.assertEqual(len(index), 2)
+        with self.assertRaises(TypeError):
+            index.merge({})
+        view = load_snapshot(data, index[root["a"].digest])
+        self.assertTrue(view.materialize() is root["a"])
+        self.assertTrue(load_snapshot(data).materialize() is root)
+
+        again = SnapshotIndex()
+        self.assertEqual(again.update(data), [root.digest])
+        self.assertEqual(again[root.digest], index[root.digest])
+        for invalid in (dumps_snapshot(root), data[:-16] + data[-8:]):
+            with self.assertRaises(ValueError):
+                SnapshotIndex().update(invalid)
+        with self.assertRaises(TypeError):
+            commit_snapshot(root, {}, 0)
+        with self.assertRaises(ValueError):
+            commit_snapshot(root, index, -1)
+
+    def test_errors(self):
+        for value in ({}, "x", (), ImmutableList([set()])):
+            with self.assertRaises(TypeError):
+                dumps_snapshot(value)
+        with self.assertRaises(TypeError):
+            load_snapshot("text")
+        with self.assertRaises(TypeError):
+            SnapshotDict()
+
+        data = dumps_snapshot(make_immutable({"a": [1, 2.5, ("x",)]}))
+        load_snapshot(data).materialize()
+        for invalid in (
+            data[:13],
+            data[:-1],
+            data[:-8] + b"\x00" * 8,
+            data[:-8] + b"\xff" * 8,
+            data[:5] + b"\x03md5" + data[10:],
+        ):
+            with self.assertRaises(ValueError):
+                load_snapshot(invalid).materialize()
+
+
+if __name__ == "__main__":
+    unittest.main()
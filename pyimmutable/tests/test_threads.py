@@ -0,0 +1,67 @@
+import sys
+import threading
+import unittest
+
+from pyimmutable import ImmutableDict, ImmutableList
+
+
+class TestThreads(unittest.TestCase):
+    def setUp(self):
+        interval = sys.getswitchinterval()
+        sys.setswitchinterval(1e-6)
+        self.addCleanup(sys.setswitchinterval, interval)
+
+    def run_threads(self, func, count=8):
+        barrier = threading.Barrier(count)
+        results = [None] * count
+        errors = []
+
+        def run(i):
+            try:
+                barrier.wait()
+                results[i] = func(i)
+            except BaseException as ex:
+                errors.append(ex)
+
+        threads = [
+            threading.Thread(target=run, args=(i,)) for i in range(count)
+        ]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        if errors:
+            raise errors[0]
+        return results
+
+    def test_interning(self):
+        self.assertEqual(ImmutableDict._get_instance_count(), 0)
+        self.assertEqual(ImmutableList._get_instance_count(), 0)
+
+        def build(i):
+            kept = []
+            for n in range(2000):
+                d = ImmutableDict(n=n % 50).set("list", ImmutableList([n]))
+                if n % 7 == i:
+                    kept.append(d)
+            return kept
+
+        results = self.run_threads(build)
+        # every thread got the same object for equal contents
+        by_value = {}
+        for kept in results:
+            for d in kept:
+                self.assertTrue(by_value.setdefault(repr(d), d) is d)
+
+        results = by_value = d = None
+        self.assertEqual(ImmutableDict._get_instance_count(), 0)
+        self.assertEqual(ImmutableList._get_instance_count(), 0)
+
+    def test_meta(self):
+        data = ImmutableList(["threads"])
+        metas = self.run_threads(lambda i: data.meta)
+        self.assertTrue(all(meta is metas[0] for meta in metas))
+
+
+if __name__ == "__main__":
+    unittest.main()
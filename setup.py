@@ -1,3 +1,5 @@
+import os
+
 from setuptools import setup, Extension
 import setuptools.command.build_ext
 
@@ -38,6 +40,13 @@ def compile_docstrings():
         write()
 
 
+# The hash function used for content hashes is chosen at build time.
+# Supported values are "sha1" (default), "blake3" and "xxh3" (which requires
+# libxxhash 0.8 or later).
+hash_policy = os.environ.get("PYIMMUTABLE_HASH", "sha1")
+if hash_policy not in ("sha1", "blake3", "xxh3"):
+    raise SystemExit(f"Unsupported PYIMMUTABLE_HASH: { hash_policy }")
+
 with open("README.rst", "r") as fh:
     long_description = fh.read()
 
@@ -64,21 +73,49 @@ setup(
         Extension(
             "_pyimmutable",
             sources=[
+                "cpp/Arena.cpp",
+                "cpp/BinaryParser.cpp",
+                "cpp/BinarySerializer.cpp",
+                "cpp/Conversion.cpp",
+                "cpp/Diff.cpp",
                 "cpp/ImmutableDict.cpp",
                 "cpp/ImmutableList.cpp",
+                "cpp/JsonParser.cpp",
+                "cpp/JsonSerializer.cpp",
+                "cpp/KeyHashCache.cpp",
+                "cpp/Path.cpp",
+                "cpp/Snapshot.cpp",
                 "cpp/main.cpp",
                 "cpp/util.cpp",
             ],
             depends=[
+                "cpp/Arena.h",
+                "cpp/Binary.h",
+                "cpp/Blake3.h",
+                "cpp/Conversion.h",
+                "cpp/Diff.h",
                 "cpp/Hash.h",
                 "cpp/ImmutableDict.h",
                 "cpp/ImmutableList.h",
+                "cpp/InternTable.h",
+                "cpp/Json.h",
+                "cpp/KeyHashCache.h",
+                "cpp/ListDigest.h",
+                "cpp/MemoryPolicy.h",
+                "cpp/Path.h",
                 "cpp/PyObjectRef.h",
+                "cpp/Sha1.h",
+                "cpp/Sha1Hash.h",
+                "cpp/Sha1Hasher.h",
+                "cpp/Snapshot.h",
+                "cpp/Xxh3.h",
                 "cpp/util.h",
                 "cpp/docstrings.txt",
             ],
             language="c++",
             include_dirs=["lib/immer"],
+            define_macros=[(f"PYIMMUTABLE_HASH_{ hash_policy.upper() }", "1")],
+            libraries=["xxhash"] if hash_policy == "xxh3" else [],
             extra_compile_args=["-std=c++17"],
             extra_link_args=[
                 "-static-libgcc",
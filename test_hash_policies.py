@@ -0,0 +1,135 @@
+"""
+This is a simple stand-alone script to test the BLAKE3 implementation in
+cpp/Blake3.h and to benchmark all hash policies in cpp/Sha1Hash.h
+
+The XXH3 policy is included if libxxhash is installed.
+"""
+
+import subprocess
+
+# Official BLAKE3 test vectors: input byte i is i % 251, truncated to the
+# first 32 bytes of output.
+BLAKE3_VECTORS = {
+    0: "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262",
+    1: "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213",
+    1024: "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7",
+    1025: "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444",
+}
+
+
+def main():
+    with open("HashPoliciesTest.cpp", "w") as f:
+        f.write(header)
+        for length, digest in BLAKE3_VECTORS.items():
+            f.write(
+                f"if (!checkBlake3({ length }, "
+                f"Blake3{{{ ','.join(format_digest(digest)) }}})) "
+                "{ return 1; }\n"
+            )
+        f.write(footer)
+
+    compile_command = [
+        "g++",
+        "-O2",
+        "HashPoliciesTest.cpp",
+        "-o",
+        "HashPoliciesTest",
+        "-Wall",
+        "-Wextra",
+        "-std=c++17",
+    ]
+    try:
+        subprocess.check_call(
+            compile_command + ["-DPYIMMUTABLE_HASH_XXH3", "-lxxhash"],
+            stderr=subprocess.DEVNULL,
+        )
+    except subprocess.CalledProcessError:
+        print("libxxhash not found, skipping XXH3")
+        subprocess.check_call(compile_command)
+    subprocess.check_call(["./HashPoliciesTest"])
+
+
+def format_digest(hexdigest):
+    return [str(int(hexdigest[i : i + 2], 16)) for i in range(0, 64, 2)]
+
+
+header = """\
+#include "cpp/Sha1Hash.h"
+#include <chrono>
+#include <iostream>
+
+using namespace pyimmutable;
+using Blake3 = blake3::Context<32>::Hash;
+
+static uint8_t data[10000];
+static volatile uint8_t sink;
+
+static bool checkBlake3(std::size_t len, Blake3 const& expected)
+{
+    for (std::size_t piece : {len + 1, std::size_t(1), std::size_t(63)}) {
+        blake3::Context<32> ctx;
+        for (std::size_t i = 0; i < len; i += piece) {
+            ctx(data + i, std::min(piece, len - i));
+        }
+        if (ctx.final() != expected) {
+            std::cerr << "BLAKE3 test vector of length " << len
+                      << " failed!" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Policy>
+static double benchmark(std::size_t len, int repeat)
+{
+    typename Policy::Context contexts[64];
+    typename Policy::Hash results[64];
+    auto const start = std::chrono::steady_clock::now();
+    for (int X=0; X<repeat; ++X) {
+        for (int i=0; i<64; ++i) {
+            contexts[i] = typename Policy::Context();
+            contexts[i](data + i, len);
+        }
+        Policy::finalMany(contexts, 64, results);
+        sink = results[X % 64][0];
+    }
+    std::chrono::duration<double> const elapsed =
+        std::chrono::steady_clock::now() - start;
+    return double(len) * 64 * repeat / elapsed.count();
+}
+
+template <typename Policy>
+static void report()
+{
+    std::cerr << "Policy " << Policy::name << " ("
+              << sizeof(typename Policy::Hash) << " byte digest): "
+              << benchmark<Policy>(9000, 1000) << " bytes/s (long), "
+              << benchmark<Policy>(40, 200000) << " bytes/s (40 bytes)"
+              << std::endl;
+}
+
+int main()
+{
+    for (int i=0; i<10000; ++i) {
+        data[i] = i % 251;
+    }
+
+"""
+
+footer = """
+    report<Sha1Policy>();
+    report<Blake3Policy>();
+#ifdef PYIMMUTABLE_HASH_XXH3
+    report<Xxh3Policy>();
+#endif
+
+    std::cerr << "Finished successfully." << std::endl;
+
+    return 0;
+}
+"""
+
+
+if __name__ == "__main__":
+    main()